@@ -1,213 +1,236 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "ast.h"
-
-static ASTNode* create_ast_node(ASTNodeType type){
-    ASTNode* node = (ASTNode*)malloc(sizeof(ASTNode));
-    if (!node){
-        fprintf(stderr,"Memory allocation failed for ASTNode \n");
-        exit(1);
-    }
-    node->type=type;
-    return node;
-};
-ASTNodeList* ast_new_node_list(){
-    ASTNodeList* list = (ASTNodeList*)malloc(sizeof(ASTNodeList));
-    if (!list)(fprintf(stderr,"Memory allocation failed for ASTNodelist"));
-    list->nodes=NULL;
-    list->count=0;
-    list->capacity=0;
-    return list;
-}
-void ast_node_list_add(ASTNodeList* list, ASTNode* node){
-    if (list->count>=list->capacity){
-        list->capacity=list->capacity==0? 4:list->capacity*2;
-        list->nodes=(ASTNode**)realloc(list->nodes,list->capacity*sizeof(ASTNode*));
-        if(!list->nodes){(fprintf(stderr,"memory reallocation failed ASTNodelist nodes.\n")); exit(1);}
-    }
-    list->nodes[list->count++]=node;
-}
-// AST Node creation functions
-ASTNode* ast_new_program(ASTNodeList* functions) {
-    ASTNode* node = create_ast_node(AST_PROGRAM);
-    node->data.node_list.list = functions;
-    return node;
-}
-
-ASTNode* ast_new_function_def(char* name, ASTNode* params, ASTNode* body) {
-    ASTNode* node = create_ast_node(AST_FUNCTION_DEF);
-    node->data.function_def.name = strdup(name);
-    node->data.function_def.params = params;
-    node->data.function_def.body = body;
-    return node;
-}
-
-ASTNode* ast_new_param_list(ASTNodeList* params) {
-    ASTNode* node = create_ast_node(AST_PARAM_LIST);
-    node->data.node_list.list = params;
-    return node;
-}
-
-ASTNode* ast_new_block(ASTNodeList* statements) {
-    ASTNode* node = create_ast_node(AST_BLOCK);
-    node->data.node_list.list = statements;
-    return node;
-}
-
-ASTNode* ast_new_return_stmt(ASTNode* expr) {
-    ASTNode* node = create_ast_node(AST_RETURN_STMT);
-    node->data.return_stmt.expr = expr;
-    return node;
-}
-
-ASTNode* ast_new_expression_stmt(ASTNode* expr) {
-    ASTNode* node = create_ast_node(AST_EXPRESSION_STMT);
-    node->data.expression_stmt.expr = expr;
-    return node;
-}
-
-ASTNode* ast_new_number(int value) {
-    ASTNode* node = create_ast_node(AST_NUMBER);
-    node->data.number.value = value;
-    return node;
-}
-
-ASTNode* ast_new_binary_op(TokenType op, ASTNode* left, ASTNode* right) {
-    ASTNode* node = create_ast_node(AST_BINARY_OP);
-    node->data.binary_op.op = op;
-    node->data.binary_op.left = left;
-    node->data.binary_op.right = right;
-    return node;
-}
-
-ASTNode* ast_new_identifier(char* name) {
-    ASTNode* node = create_ast_node(AST_IDENTIFIER);
-    node->data.identifier.name = strdup(name);
-    return node;
-}
-
-ASTNode* ast_new_function_call(char* name, ASTNode* args) {
-    ASTNode* node = create_ast_node(AST_FUNCTION_CALL);
-    node->data.function_call.name = strdup(name);
-    node->data.function_call.args = args;
-    return node;
-}
-
-ASTNode* ast_new_arg_list(ASTNodeList* args) {
-    ASTNode* node = create_ast_node(AST_ARG_LIST);
-    node->data.node_list.list = args;
-    return node;
-}
-// Basic AST printing (for debugging)
-void ast_print_indent(int indent) {
-    for (int i = 0; i < indent; ++i) {
-        printf("  ");
-    }
-}
-void ast_print(ASTNode* node, int indent) {
-    if (!node) return;
-
-    ast_print_indent(indent);
-    switch (node->type) {
-        case AST_PROGRAM:
-            printf("PROGRAM:\n");
-            for (size_t i = 0; i < node->data.node_list.list->count; ++i) {
-                ast_print(node->data.node_list.list->nodes[i], indent + 1);
-            }
-            break;
-        case AST_FUNCTION_DEF:
-            printf("FUNCTION_DEF: %s\n", node->data.function_def.name);
-            ast_print_indent(indent + 1); printf("Parameters:\n");
-            ast_print(node->data.function_def.params, indent + 2);
-            ast_print_indent(indent + 1); printf("Body:\n");
-            ast_print(node->data.function_def.body, indent + 2);
-            break;
-        case AST_PARAM_LIST:
-        case AST_ARG_LIST:
-        case AST_BLOCK:
-            printf("%s_LIST (count: %zu):\n", node->type == AST_PARAM_LIST? "PARAM" : (node->type == AST_ARG_LIST? "ARG" : "BLOCK"), node->data.node_list.list->count);
-            for (size_t i = 0; i < node->data.node_list.list->count; ++i) {
-                ast_print(node->data.node_list.list->nodes[i], indent + 1);
-            }
-            break;
-        case AST_RETURN_STMT:
-            printf("RETURN_STMT:\n");
-            ast_print(node->data.return_stmt.expr, indent + 1);
-            break;
-        case AST_EXPRESSION_STMT:
-            printf("EXPRESSION_STMT:\n");
-            ast_print(node->data.expression_stmt.expr, indent + 1);
-            break;
-        case AST_NUMBER:
-            printf("NUMBER: %d\n", node->data.number.value);
-            break;
-        case AST_BINARY_OP:
-            printf("BINARY_OP: %c\n",
-                   node->data.binary_op.op == TOKEN_PLUS? '+' :
-                   node->data.binary_op.op == TOKEN_MINUS? '-' :
-                   node->data.binary_op.op == TOKEN_MULTIPLY? '*' : '/');
-            ast_print(node->data.binary_op.left, indent + 1);
-            ast_print(node->data.binary_op.right, indent + 1);
-            break;
-        case AST_IDENTIFIER:
-            printf("IDENTIFIER: %s\n", node->data.identifier.name);
-            break;
-        case AST_FUNCTION_CALL:
-            printf("FUNCTION_CALL: %s\n", node->data.function_call.name);
-            ast_print_indent(indent + 1); printf("Arguments:\n");
-            ast_print(node->data.function_call.args, indent + 2);
-            break;
-        default:
-            printf("UNKNOWN_AST_NODE_TYPE: %d\n", node->type);
-            break;
-    }
-}
-
-// Basic AST freeing
-void ast_free(ASTNode* node) {
-    if (!node) return;
-
-    switch (node->type) {
-        case AST_PROGRAM:
-        case AST_PARAM_LIST:
-        case AST_ARG_LIST:
-        case AST_BLOCK:
-            if (node->data.node_list.list) {
-                for (size_t i = 0; i < node->data.node_list.list->count; ++i) {
-                    ast_free(node->data.node_list.list->nodes[i]);
-                }
-                free(node->data.node_list.list->nodes);
-                free(node->data.node_list.list);
-            }
-            break;
-        case AST_FUNCTION_DEF:
-            free(node->data.function_def.name);
-            ast_free(node->data.function_def.params);
-            ast_free(node->data.function_def.body);
-            break;
-        case AST_RETURN_STMT:
-            ast_free(node->data.return_stmt.expr);
-            break;
-        case AST_EXPRESSION_STMT:
-            ast_free(node->data.expression_stmt.expr);
-            break;
-        case AST_BINARY_OP:
-            ast_free(node->data.binary_op.left);
-            ast_free(node->data.binary_op.right);
-            break;
-        case AST_IDENTIFIER:
-            free(node->data.identifier.name);
-            break;
-        case AST_FUNCTION_CALL:
-            free(node->data.function_call.name);
-            ast_free(node->data.function_call.args);
-            break;
-        case AST_NUMBER:
-            // No dynamic memory to free for numbers
-            break;
-        default:
-            break;
-    }
-    free(node);
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ast.h"
+
+static const char* const node_type_names[AST_NODE_TYPE_COUNT] = {
+    "program", "function_def", "param_list", "block", "return_stmt", "expression_stmt",
+    "number", "binary_op", "identifier", "function_call", "arg_list",
+};
+
+const char* ast_node_type_name(ASTNodeType type){
+    return node_type_names[type];
+}
+
+void ast_init(AST* ast){
+    ast->kinds = NULL;
+    ast->ops = NULL;
+    ast->data = NULL;
+    ast->node_count = 0;
+    ast->node_capacity = 0;
+    ast->extra = NULL;
+    ast->extra_count = 0;
+    ast->extra_capacity = 0;
+    ast->scratch = NULL;
+    ast->scratch_count = 0;
+    ast->scratch_capacity = 0;
+    memset(ast->nodes_by_type, 0, sizeof(ast->nodes_by_type));
+    ast->grow_count = 0;
+}
+void ast_release(AST* ast){
+    free(ast->kinds);
+    free(ast->ops);
+    free(ast->data);
+    free(ast->extra);
+    free(ast->scratch);
+    ast_init(ast);
+}
+
+size_t ast_bytes(const AST* ast){
+    return (size_t)ast->node_capacity * (sizeof(*ast->kinds) + sizeof(*ast->ops) + sizeof(*ast->data)) +
+           (size_t)ast->extra_capacity * sizeof(*ast->extra) +
+           (size_t)ast->scratch_capacity * sizeof(*ast->scratch);
+}
+
+static void* grow_array(AST* ast, void* items, uint32_t capacity, size_t item_size){
+    void* grown = realloc(items, (size_t)capacity * item_size);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed for %u AST entries.\n", capacity);
+        exit(1);
+    }
+    ast->grow_count++;
+    return grown;
+}
+
+// Doubles an id array such as extra or scratch when it is full
+static NodeId* reserve_ids(AST* ast, NodeId* ids, uint32_t count, uint32_t needed, uint32_t* capacity){
+    if (count + needed <= *capacity) return ids;
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 256;
+    while (new_capacity < count + needed) new_capacity *= 2;
+    *capacity = new_capacity;
+    return grow_array(ast, ids, new_capacity, sizeof(NodeId));
+}
+
+static NodeId create_ast_node(AST* ast, ASTNodeType type, uint32_t lhs, uint32_t rhs){
+    NodeId node = ++ast->node_count; // id 0 stays unused
+    if (node >= ast->node_capacity) {
+        uint32_t capacity = ast->node_capacity ? ast->node_capacity * 2 : 1024;
+        ast->kinds = grow_array(ast, ast->kinds, capacity, sizeof(*ast->kinds));
+        ast->ops = grow_array(ast, ast->ops, capacity, sizeof(*ast->ops));
+        ast->data = grow_array(ast, ast->data, capacity, sizeof(*ast->data));
+        ast->node_capacity = capacity;
+    }
+    ast->kinds[node] = (uint8_t)type;
+    ast->ops[node] = 0;
+    ast->data[node].lhs = lhs;
+    ast->data[node].rhs = rhs;
+    ast->nodes_by_type[type]++;
+    return node;
+};
+ASTNodeList ast_new_node_list(AST* ast){
+    ASTNodeList list = {ast->scratch_count, 0};
+    return list;
+}
+void ast_node_list_add(AST* ast, ASTNodeList* list, NodeId node){
+    if (list->start + list->count != ast->scratch_count) {
+        fprintf(stderr, "AST Error: Node list grown while an inner list was still open.\n");
+        exit(1);
+    }
+    ast->scratch = reserve_ids(ast, ast->scratch, ast->scratch_count, 1, &ast->scratch_capacity);
+    ast->scratch[ast->scratch_count++] = node;
+    list->count++;
+}
+// Moves a finished list from scratch to extra; returns where it starts
+static uint32_t close_node_list(AST* ast, ASTNodeList* list){
+    if (list->start + list->count != ast->scratch_count) {
+        fprintf(stderr, "AST Error: Node list closed while an inner list was still open.\n");
+        exit(1);
+    }
+    ast->extra = reserve_ids(ast, ast->extra, ast->extra_count, list->count, &ast->extra_capacity);
+    uint32_t start = ast->extra_count;
+    if (list->count) memcpy(ast->extra + start, ast->scratch + list->start, list->count * sizeof(NodeId));
+    ast->extra_count += list->count;
+    ast->scratch_count = list->start;
+    return start;
+}
+static NodeId create_list_node(AST* ast, ASTNodeType type, ASTNodeList* list){
+    uint32_t start = close_node_list(ast, list);
+    return create_ast_node(ast, type, start, list->count);
+}
+// AST Node creation functions
+NodeId ast_new_program(AST* ast, ASTNodeList* functions) {
+    return create_list_node(ast, AST_PROGRAM, functions);
+}
+
+NodeId ast_new_function_def(AST* ast, SymbolId name, NodeId params, NodeId body) {
+    ast->extra = reserve_ids(ast, ast->extra, ast->extra_count, 2, &ast->extra_capacity);
+    uint32_t at = ast->extra_count;
+    ast->extra[ast->extra_count++] = params;
+    ast->extra[ast->extra_count++] = body;
+    return create_ast_node(ast, AST_FUNCTION_DEF, name, at);
+}
+
+NodeId ast_new_param_list(AST* ast, ASTNodeList* params) {
+    return create_list_node(ast, AST_PARAM_LIST, params);
+}
+
+NodeId ast_new_block(AST* ast, ASTNodeList* statements) {
+    return create_list_node(ast, AST_BLOCK, statements);
+}
+
+NodeId ast_new_return_stmt(AST* ast, NodeId expr) {
+    return create_ast_node(ast, AST_RETURN_STMT, expr, 0);
+}
+
+NodeId ast_new_expression_stmt(AST* ast, NodeId expr) {
+    return create_ast_node(ast, AST_EXPRESSION_STMT, expr, 0);
+}
+
+NodeId ast_new_number(AST* ast, int value) {
+    return create_ast_node(ast, AST_NUMBER, (uint32_t)value, 0);
+}
+
+NodeId ast_new_binary_op(AST* ast, TokenType op, NodeId left, NodeId right) {
+    NodeId node = create_ast_node(ast, AST_BINARY_OP, left, right);
+    ast->ops[node] = (uint8_t)op;
+    return node;
+}
+
+NodeId ast_new_identifier(AST* ast, SymbolId name) {
+    return create_ast_node(ast, AST_IDENTIFIER, name, 0);
+}
+
+NodeId ast_new_function_call(AST* ast, SymbolId name, NodeId args) {
+    return create_ast_node(ast, AST_FUNCTION_CALL, name, args);
+}
+
+NodeId ast_new_arg_list(AST* ast, ASTNodeList* args) {
+    return create_list_node(ast, AST_ARG_LIST, args);
+}
+
+void ast_set_number(AST* ast, NodeId node, int value) {
+    ast->kinds[node] = AST_NUMBER;
+    ast->ops[node] = 0;
+    ast->data[node].lhs = (uint32_t)value;
+    ast->data[node].rhs = 0;
+}
+// Basic AST printing (for debugging)
+void ast_print_indent(FILE* out, int indent) {
+    for (int i = 0; i < indent; ++i) {
+        fprintf(out, "  ");
+    }
+}
+static void print_name(FILE* out, const Interner* names, const char* label, SymbolId name) {
+    fprintf(out, "%s: %.*s\n", label, (int)symbol_length(names, name), symbol_text(names, name));
+}
+void ast_print(FILE* out, const AST* ast, const Interner* names, NodeId node, int indent) {
+    if (node == NODE_NONE) return;
+
+    ast_print_indent(out, indent);
+    ASTNodeType type = ast_kind(ast, node);
+    switch (type) {
+        case AST_PROGRAM:
+            fprintf(out, "PROGRAM:\n");
+            for (uint32_t i = 0; i < ast_list_count(ast, node); ++i) {
+                ast_print(out, ast, names, ast_list_item(ast, node, i), indent + 1);
+            }
+            break;
+        case AST_FUNCTION_DEF:
+            print_name(out, names, "FUNCTION_DEF", ast_name(ast, node));
+            ast_print_indent(out, indent + 1); fprintf(out, "Parameters:\n");
+            ast_print(out, ast, names, ast_params(ast, node), indent + 2);
+            ast_print_indent(out, indent + 1); fprintf(out, "Body:\n");
+            ast_print(out, ast, names, ast_body(ast, node), indent + 2);
+            break;
+        case AST_PARAM_LIST:
+        case AST_ARG_LIST:
+        case AST_BLOCK:
+            fprintf(out, "%s_LIST (count: %u):\n", type == AST_PARAM_LIST? "PARAM" : (type == AST_ARG_LIST? "ARG" : "BLOCK"), ast_list_count(ast, node));
+            for (uint32_t i = 0; i < ast_list_count(ast, node); ++i) {
+                ast_print(out, ast, names, ast_list_item(ast, node, i), indent + 1);
+            }
+            break;
+        case AST_RETURN_STMT:
+            fprintf(out, "RETURN_STMT:\n");
+            ast_print(out, ast, names, ast_expr(ast, node), indent + 1);
+            break;
+        case AST_EXPRESSION_STMT:
+            fprintf(out, "EXPRESSION_STMT:\n");
+            ast_print(out, ast, names, ast_expr(ast, node), indent + 1);
+            break;
+        case AST_NUMBER:
+            fprintf(out, "NUMBER: %d\n", ast_number_value(ast, node));
+            break;
+        case AST_BINARY_OP: {
+            TokenType op = ast_binary_op(ast, node);
+            fprintf(out, "BINARY_OP: %c\n",
+                   op == TOKEN_PLUS? '+' :
+                   op == TOKEN_MINUS? '-' :
+                   op == TOKEN_MULTIPLY? '*' : '/');
+            ast_print(out, ast, names, ast_left(ast, node), indent + 1);
+            ast_print(out, ast, names, ast_right(ast, node), indent + 1);
+            break;
+        }
+        case AST_IDENTIFIER:
+            print_name(out, names, "IDENTIFIER", ast_name(ast, node));
+            break;
+        case AST_FUNCTION_CALL:
+            print_name(out, names, "FUNCTION_CALL", ast_name(ast, node));
+            ast_print_indent(out, indent + 1); fprintf(out, "Arguments:\n");
+            ast_print(out, ast, names, ast_call_args(ast, node), indent + 2);
+            break;
+        default:
+            fprintf(out, "UNKNOWN_AST_NODE_TYPE: %d\n", type);
+            break;
+    }
+}
@@ -1,68 +1,122 @@
-#ifndef AST_H
-#define AST_H
-
-#include "token.h"
-#include <stdlib.h>
-
-// FORWARD DECLARING for recursive types
-typedef struct ASTNode ASTNode;
-
-//A generic list of ASTNodes, useful for blocks, argument lists, etc.
-typedef struct ASTNodeList {
-    ASTNode** nodes;
-    size_t count;
-    size_t capacity;
-}ASTNodeList;
-
-// Main AST Node structure (tagged union)
-typedef enum{
-    AST_PROGRAM,
-    AST_FUNCTION_DEF,
-    AST_PARAM_LIST,
-    AST_BLOCK,
-    AST_RETURN_STMT,
-    AST_EXPRESSION_STMT,
-    AST_NUMBER,
-    AST_BINARY_OP,
-    AST_IDENTIFIER,
-    AST_FUNCTION_CALL,
-    AST_ARG_LIST,
-    // Add more node types as needed
-}ASTNodeType;
-
-struct ASTNode {
-    ASTNodeType type; // Using the enum directly
-    union {
-        struct { int value; } number;
-        struct { char* name; } identifier;
-        struct { TokenType op; ASTNode* left; ASTNode* right; } binary_op;
-        struct { char* name; ASTNode* params; ASTNode* body; } function_def; // params is AST_PARAM_LIST
-        struct { char* name; ASTNode* args; } function_call; // args is AST_ARG_LIST
-        struct { ASTNode* expr; } return_stmt;
-        struct { ASTNode* expr; } expression_stmt;
-        struct { ASTNodeList* list; } node_list; // For AST_PROGRAM, AST_PARAM_LIST, AST_BLOCK, AST_ARG_LIST
-    } data;
-};
-
-// AST Node creation functions
-ASTNode* ast_new_program(ASTNodeList* functions);
-ASTNode* ast_new_function_def(char* name, ASTNode* params, ASTNode* body);
-ASTNode* ast_new_param_list(ASTNodeList* params);
-ASTNode* ast_new_block(ASTNodeList* statements);
-ASTNode* ast_new_return_stmt(ASTNode* expr);
-ASTNode* ast_new_expression_stmt(ASTNode* expr);
-ASTNode* ast_new_number(int value);
-ASTNode* ast_new_binary_op(TokenType op, ASTNode* left, ASTNode* right);
-ASTNode* ast_new_identifier(char* name);
-ASTNode* ast_new_function_call(char* name, ASTNode* args);
-ASTNode* ast_new_arg_list(ASTNodeList* args);
-
-// Helper for ASTNodeList
-ASTNodeList* ast_new_node_list();
-void ast_node_list_add(ASTNodeList* list, ASTNode* node);
-
-// AST utility functions (e.g., printing, freeing)
-void ast_print(ASTNode* node, int indent);
-void ast_free(ASTNode* node);
-
-#endif
\ No newline at end of file
+#ifndef AST_H
+#define AST_H
+
+#include "token.h"
+#include "intern.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+// Index of a node in its AST. Equal to the order of creation, so the parser's
+// children always have smaller ids than their parent; subtrees the inliner
+// copies in come later. Id 0 is never handed out.
+typedef uint32_t NodeId;
+#define NODE_NONE 0
+
+// Node kinds
+typedef enum{
+    AST_PROGRAM,
+    AST_FUNCTION_DEF,
+    AST_PARAM_LIST,
+    AST_BLOCK,
+    AST_RETURN_STMT,
+    AST_EXPRESSION_STMT,
+    AST_NUMBER,
+    AST_BINARY_OP,
+    AST_IDENTIFIER,
+    AST_FUNCTION_CALL,
+    AST_ARG_LIST,
+    // Add more node types as needed
+    AST_NODE_TYPE_COUNT
+}ASTNodeType;
+
+// Two 32-bit fields per node, by kind:
+//   AST_NUMBER           lhs = value
+//   AST_IDENTIFIER       lhs = name
+//   AST_BINARY_OP        lhs = left, rhs = right (the operator is in ops)
+//   AST_FUNCTION_DEF     lhs = name, rhs = extra index of {params, body}
+//   AST_FUNCTION_CALL    lhs = name, rhs = args (an AST_ARG_LIST)
+//   AST_RETURN_STMT,
+//   AST_EXPRESSION_STMT  lhs = expr
+//   AST_PROGRAM, AST_PARAM_LIST,
+//   AST_BLOCK, AST_ARG_LIST  lhs = first child in extra, rhs = child count
+typedef struct ASTNodeData {
+    uint32_t lhs;
+    uint32_t rhs;
+} ASTNodeData;
+
+// A list of children being built. Items go onto a scratch stack and move to
+// extra, contiguously, when the list node is made, so lists may nest but an
+// inner list must be finished before its outer list grows again.
+typedef struct ASTNodeList {
+    uint32_t start; // in the AST's scratch stack
+    uint32_t count;
+} ASTNodeList;
+
+// One translation unit's tree as parallel arrays indexed by NodeId, plus one
+// array of child ranges shared by every list node. ast_release frees it all;
+// there is no per-node free.
+typedef struct AST {
+    uint8_t* kinds;     // ASTNodeType
+    uint8_t* ops;       // TokenType of an AST_BINARY_OP, 0 for other kinds
+    ASTNodeData* data;
+    uint32_t node_count; // nodes created so far; ids run from 1 to node_count
+    uint32_t node_capacity;
+    NodeId* extra;
+    uint32_t extra_count;
+    uint32_t extra_capacity;
+    NodeId* scratch;
+    uint32_t scratch_count;
+    uint32_t scratch_capacity;
+    size_t nodes_by_type[AST_NODE_TYPE_COUNT];
+    size_t grow_count; // times one of the arrays above was reallocated
+} AST;
+
+void ast_init(AST* ast);
+void ast_release(AST* ast);
+const char* ast_node_type_name(ASTNodeType type);
+size_t ast_bytes(const AST* ast); // heap held by the arrays
+
+// AST Node creation functions
+NodeId ast_new_program(AST* ast, ASTNodeList* functions);
+NodeId ast_new_function_def(AST* ast, SymbolId name, NodeId params, NodeId body);
+NodeId ast_new_param_list(AST* ast, ASTNodeList* params);
+NodeId ast_new_block(AST* ast, ASTNodeList* statements);
+NodeId ast_new_return_stmt(AST* ast, NodeId expr);
+NodeId ast_new_expression_stmt(AST* ast, NodeId expr);
+NodeId ast_new_number(AST* ast, int value);
+NodeId ast_new_binary_op(AST* ast, TokenType op, NodeId left, NodeId right);
+NodeId ast_new_identifier(AST* ast, SymbolId name);
+NodeId ast_new_function_call(AST* ast, SymbolId name, NodeId args);
+NodeId ast_new_arg_list(AST* ast, ASTNodeList* args);
+
+// Helper for ASTNodeList
+ASTNodeList ast_new_node_list(AST* ast);
+void ast_node_list_add(AST* ast, ASTNodeList* list, NodeId node);
+
+// Field access by kind, see ASTNodeData
+static inline ASTNodeType ast_kind(const AST* ast, NodeId node) { return (ASTNodeType)ast->kinds[node]; }
+static inline int ast_number_value(const AST* ast, NodeId node) { return (int)ast->data[node].lhs; }
+static inline SymbolId ast_name(const AST* ast, NodeId node) { return ast->data[node].lhs; } // identifier, function def or call
+static inline TokenType ast_binary_op(const AST* ast, NodeId node) { return (TokenType)ast->ops[node]; }
+static inline NodeId ast_left(const AST* ast, NodeId node) { return ast->data[node].lhs; }
+static inline NodeId ast_right(const AST* ast, NodeId node) { return ast->data[node].rhs; }
+static inline NodeId ast_params(const AST* ast, NodeId node) { return ast->extra[ast->data[node].rhs]; }
+static inline NodeId ast_body(const AST* ast, NodeId node) { return ast->extra[ast->data[node].rhs + 1]; }
+static inline NodeId ast_call_args(const AST* ast, NodeId node) { return ast->data[node].rhs; }
+static inline NodeId ast_expr(const AST* ast, NodeId node) { return ast->data[node].lhs; } // return or expression statement
+static inline uint32_t ast_list_count(const AST* ast, NodeId node) { return ast->data[node].rhs; }
+static inline NodeId ast_list_item(const AST* ast, NodeId node, uint32_t i) { return ast->extra[ast->data[node].lhs + i]; }
+
+// In-place rewrites for the optimizer
+void ast_set_number(AST* ast, NodeId node, int value); // turns any node into a constant
+static inline void ast_set_left(AST* ast, NodeId node, NodeId left) { ast->data[node].lhs = left; }
+static inline void ast_set_right(AST* ast, NodeId node, NodeId right) { ast->data[node].rhs = right; }
+static inline void ast_set_expr(AST* ast, NodeId node, NodeId expr) { ast->data[node].lhs = expr; }
+static inline void ast_set_list_item(AST* ast, NodeId node, uint32_t i, NodeId item) { ast->extra[ast->data[node].lhs + i] = item; }
+static inline void ast_set_list_count(AST* ast, NodeId node, uint32_t count) { ast->data[node].rhs = count; } // shrinks only
+
+// AST utility functions (e.g., printing)
+void ast_print(FILE* out, const AST* ast, const Interner* names, NodeId node, int indent);
+
+#endif
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include "cache.h"
+#include "emit.h"
+
+#ifdef _WIN32
+#define make_dir(path) mkdir(path)
+#else
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+static void count(size_t* counter) {
+    __atomic_fetch_add(counter, 1, __ATOMIC_RELAXED);
+}
+
+int cache_open(Cache* cache, const char* dir, unsigned long long max_bytes) {
+    cache->dir = dir;
+    cache->max_bytes = max_bytes;
+    cache->hits = cache->misses = cache->stores = cache->evictions = 0;
+
+    // mkdir -p
+    size_t length = strlen(dir);
+    char* path = (char*)malloc(length + 1);
+    if (!path) {
+        fprintf(stderr, "Memory allocation failed for cache path.\n");
+        exit(1);
+    }
+    memcpy(path, dir, length + 1);
+    for (size_t i = 1; i <= length; ++i) {
+        if (path[i] != '/' && path[i] != '\0') continue;
+        char saved = path[i];
+        path[i] = '\0';
+        if (make_dir(path) != 0 && errno != EEXIST) {
+            fprintf(stderr, "Error: Could not create cache directory '%s': %s\n", path, strerror(errno));
+            free(path);
+            return -1;
+        }
+        path[i] = saved;
+    }
+    free(path);
+    return 0;
+}
+
+// MurmurHash3 x64 128-bit (Austin Appleby, public domain). Not cryptographic:
+// the cache directory is trusted, the hash only has to tell inputs apart.
+static uint64_t rotl64(uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t fmix64(uint64_t k) {
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+static void murmur3_128(const void* key, size_t length, uint64_t seed, uint64_t out[2]) {
+    const uint8_t* data = (const uint8_t*)key;
+    const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+    uint64_t h1 = seed, h2 = seed;
+    size_t blocks = length / 16;
+    for (size_t i = 0; i < blocks; ++i) {
+        uint64_t k1, k2;
+        memcpy(&k1, data + i * 16, 8);
+        memcpy(&k2, data + i * 16 + 8, 8);
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1 * 5 + 0x52dce729;
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2 * 5 + 0x38495ab5;
+    }
+    const uint8_t* tail = data + blocks * 16;
+    uint64_t k1 = 0, k2 = 0;
+    switch (length & 15) {
+        case 15: k2 ^= (uint64_t)tail[14] << 48; /* fall through */
+        case 14: k2 ^= (uint64_t)tail[13] << 40; /* fall through */
+        case 13: k2 ^= (uint64_t)tail[12] << 32; /* fall through */
+        case 12: k2 ^= (uint64_t)tail[11] << 24; /* fall through */
+        case 11: k2 ^= (uint64_t)tail[10] << 16; /* fall through */
+        case 10: k2 ^= (uint64_t)tail[9] << 8;   /* fall through */
+        case 9:  k2 ^= (uint64_t)tail[8];
+                 k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+                 /* fall through */
+        case 8:  k1 ^= (uint64_t)tail[7] << 56;  /* fall through */
+        case 7:  k1 ^= (uint64_t)tail[6] << 48;  /* fall through */
+        case 6:  k1 ^= (uint64_t)tail[5] << 40;  /* fall through */
+        case 5:  k1 ^= (uint64_t)tail[4] << 32;  /* fall through */
+        case 4:  k1 ^= (uint64_t)tail[3] << 24;  /* fall through */
+        case 3:  k1 ^= (uint64_t)tail[2] << 16;  /* fall through */
+        case 2:  k1 ^= (uint64_t)tail[1] << 8;   /* fall through */
+        case 1:  k1 ^= (uint64_t)tail[0];
+                 k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+    h1 ^= (uint64_t)length;
+    h2 ^= (uint64_t)length;
+    h1 += h2;
+    h2 += h1;
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+    h1 += h2;
+    h2 += h1;
+    out[0] = h1;
+    out[1] = h2;
+}
+
+void cache_key(CacheKey* key, const char* salt, const void* data, size_t length) {
+    uint64_t salt_hash[2], hash[2];
+    murmur3_128(salt, strlen(salt), 0, salt_hash);
+    murmur3_128(data, length, salt_hash[0] ^ salt_hash[1], hash);
+    hash[0] ^= salt_hash[0]; // a salt collision alone cannot collide keys
+    snprintf(key->hex, sizeof(key->hex), "%016llx%016llx",
+             (unsigned long long)hash[0], (unsigned long long)hash[1]);
+}
+
+static void entry_path(const Cache* cache, const CacheKey* key, const char* extension, char* path, size_t size) {
+    snprintf(path, size, "%s/%s%s", cache->dir, key->hex, extension);
+}
+
+char* cache_lookup(Cache* cache, const CacheKey* key, const char* extension, size_t* size) {
+    char path[4096];
+    entry_path(cache, key, extension, path, sizeof(path));
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) close(fd);
+        count(&cache->misses);
+        return NULL;
+    }
+    char* data = (char*)malloc(st.st_size ? (size_t)st.st_size : 1);
+    size_t got = 0;
+    while (data && got < (size_t)st.st_size) {
+        ssize_t n = read(fd, data + got, (size_t)st.st_size - got);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        got += (size_t)n;
+    }
+    close(fd);
+    if (!data || got != (size_t)st.st_size) { // evicted or truncated under us: treat as a miss
+        free(data);
+        count(&cache->misses);
+        return NULL;
+    }
+    utimes(path, NULL); // most recently used now
+    count(&cache->hits);
+    *size = got;
+    return data;
+}
+
+void cache_store(Cache* cache, const CacheKey* key, const char* extension, const char* data, size_t size) {
+    static unsigned long sequence = 0;
+    char path[4096], temp[4096];
+    entry_path(cache, key, extension, path, sizeof(path));
+    snprintf(temp, sizeof(temp), "%s/.tmp.%ld.%lu", cache->dir, (long)getpid(),
+             __atomic_fetch_add(&sequence, 1, __ATOMIC_RELAXED));
+    int fd = open(temp, O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) return;
+    int ok = write_fully(fd, data, size) == 0;
+    ok = close(fd) == 0 && ok;
+    if (ok && rename(temp, path) == 0) {
+        count(&cache->stores);
+    } else {
+        unlink(temp);
+    }
+}
+
+typedef struct CacheEntry {
+    char* name;
+    time_t used;
+    unsigned long long bytes;
+} CacheEntry;
+
+static int by_oldest(const void* a, const void* b) {
+    time_t x = ((const CacheEntry*)a)->used, y = ((const CacheEntry*)b)->used;
+    return (x > y) - (x < y);
+}
+
+// Temporaries left this long are from stores that never finished
+#define STALE_TEMP_SECONDS (10 * 60)
+
+// Whether name is one of our entries: 32 hex digits and .s, .o or .ir,
+// so files the cache did not write are never counted or evicted
+static int is_entry_name(const char* name) {
+    for (int i = 0; i < 32; ++i) {
+        char c = name[i];
+        if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f'))) return 0;
+    }
+    return strcmp(name + 32, ".s") == 0 || strcmp(name + 32, ".o") == 0 || strcmp(name + 32, ".ir") == 0;
+}
+
+void cache_trim(Cache* cache) {
+    DIR* dir = opendir(cache->dir);
+    if (!dir) return;
+    CacheEntry* entries = NULL;
+    size_t count_entries = 0, capacity = 0;
+    unsigned long long total = 0;
+    char path[4096];
+    time_t now = time(NULL);
+    struct dirent* ent;
+    while ((ent = readdir(dir)) != NULL) {
+        int temp = strncmp(ent->d_name, ".tmp.", 5) == 0;
+        if (!temp && !is_entry_name(ent->d_name)) continue;
+        struct stat st;
+        snprintf(path, sizeof(path), "%s/%s", cache->dir, ent->d_name);
+        if (stat(path, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        if (temp) {
+            // In flight unless it is old, when an interrupted store left it behind
+            if (now - st.st_mtime > STALE_TEMP_SECONDS) unlink(path);
+            continue;
+        }
+        if (count_entries == capacity) {
+            capacity = capacity ? capacity * 2 : 256;
+            CacheEntry* grown = (CacheEntry*)realloc(entries, capacity * sizeof(CacheEntry));
+            if (!grown) break;
+            entries = grown;
+        }
+        entries[count_entries].name = strdup(ent->d_name);
+        if (!entries[count_entries].name) break; // trim what was listed so far
+        entries[count_entries].used = st.st_mtime;
+        entries[count_entries].bytes = (unsigned long long)st.st_size;
+        total += (unsigned long long)st.st_size;
+        count_entries++;
+    }
+    closedir(dir);
+
+    if (total > cache->max_bytes) {
+        qsort(entries, count_entries, sizeof(CacheEntry), by_oldest);
+        // Evict down to 90% of the cap so the next few stores do not trim again
+        unsigned long long target = cache->max_bytes / 10 * 9;
+        for (size_t i = 0; i < count_entries && total > target; ++i) {
+            snprintf(path, sizeof(path), "%s/%s", cache->dir, entries[i].name);
+            if (unlink(path) == 0) count(&cache->evictions);
+            total -= entries[i].bytes; // gone either way, maybe trimmed by another process
+        }
+    }
+    for (size_t i = 0; i < count_entries; ++i) free(entries[i].name);
+    free(entries);
+}
@@ -0,0 +1,49 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Content-addressed cache of compiler outputs in a directory on disk. An
+// entry is named after the hash of everything that determines the output
+// (source bytes, compiler version, options), so unchanged inputs are served
+// without lexing, parsing or generating anything.
+//
+// Entries are written to a temporary file and renamed into place, so
+// concurrent compilers (threads or processes) only ever see whole entries.
+// A hit refreshes the entry's modification time; cache_trim evicts the
+// least recently used entries once the directory exceeds its size cap.
+
+#define CACHE_DEFAULT_MAX_BYTES (256ull * 1024 * 1024)
+
+typedef struct CacheKey {
+    char hex[33]; // 128-bit hash as lowercase hex
+} CacheKey;
+
+typedef struct Cache {
+    const char* dir;
+    unsigned long long max_bytes;
+    // Counters for this run, updated atomically from any thread
+    size_t hits;
+    size_t misses;
+    size_t stores;
+    size_t evictions;
+} Cache;
+
+// Creates dir (and its parents) if needed. Returns 0, or -1 after a diagnostic.
+int cache_open(Cache* cache, const char* dir, unsigned long long max_bytes);
+
+// Hash of salt (version and options) followed by the source bytes
+void cache_key(CacheKey* key, const char* salt, const void* data, size_t length);
+
+// Hit: returns a malloc'ed copy of the entry and its size. Miss: NULL.
+char* cache_lookup(Cache* cache, const CacheKey* key, const char* extension, size_t* size);
+
+// Best effort: a failed store only costs a future miss
+void cache_store(Cache* cache, const CacheKey* key, const char* extension, const char* data, size_t size);
+
+// Deletes least recently used entries until the cache fits in max_bytes, and
+// temporaries that interrupted stores left behind. Other files are left alone.
+void cache_trim(Cache* cache);
+
+#endif
@@ -1,210 +1,925 @@
-// codegen.c (simplified snippet)
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include "codegen.h"
-#include "token.h" // For TokenType
-
-// Helper function to emit assembly (e.g., print to stdout or file)
-#define emitf printf
-
-// Current stack offset for local variables (simple approach)
-// Note: For a real compiler, this would be managed per function via a symbol table.
-static int current_stack_offset = 0; // Tracks stack usage for push/pop for expressions
-
-// Function to generate code for expressions
-void generate_expression_code(ASTNode* node) {
-    if (!node) return;
-
-    switch (node->type) {
-        case AST_NUMBER:
-            emitf("  mov rax, %d\n", node->data.number.value);
-            break;
-        case AST_IDENTIFIER:
-            // For this simple compiler, identifiers in expressions are not directly supported
-            // as variables, only as part of function calls.
-            // A symbol table would be needed to lookup variable offsets/registers.
-            fprintf(stderr, "Code Generation Error: Identifiers in expressions (as variables) not yet supported.\n");
-            exit(1);
-            break;
-        case AST_BINARY_OP:
-            generate_expression_code(node->data.binary_op.left);
-            emitf("  push rax\n"); // Save left operand on stack
-            current_stack_offset += 8; // Adjust simulated stack offset
-            generate_expression_code(node->data.binary_op.right);
-            emitf("  pop rbx\n"); // Load left operand into rbx
-            current_stack_offset -= 8; // Adjust simulated stack offset
-
-            switch (node->data.binary_op.op) {
-                case TOKEN_PLUS:
-                    emitf("  add rax, rbx\n");
-                    break;
-                case TOKEN_MINUS:
-                    emitf("  sub rbx, rax\n"); // rbx - rax
-                    emitf("  mov rax, rbx\n"); // Result into rax
-                    break;
-                case TOKEN_MULTIPLY:
-                    emitf("  imul rax, rbx\n"); // rax = rax * rbx
-                    break;
-                case TOKEN_DIVIDE:
-                    emitf("  mov rdx, 0\n"); // Clear rdx for division (rdx:rax is dividend)
-                    emitf("  idiv rbx\n"); // rax = (rdx:rax) / rbx
-                    break;
-                default:
-                    fprintf(stderr, "Code Generation Error: Unknown binary operator.\n");
-                    exit(1);
-            }
-            break;
-        case AST_FUNCTION_CALL: {
-            // Push arguments onto stack (right-to-left for cdecl-like behavior, or use registers for x64 ABI)
-            // For simplicity, we'll use registers for first few args, then stack.
-            // This example assumes System V AMD64 ABI (Linux/macOS)
-            ASTNodeList* args_list = node->data.function_call.args->data.node_list.list;
-            
-            // Evaluate arguments and push them onto the stack in reverse order
-            // Or, for x86-64 System V ABI, use registers for first 6 args.
-            // This simplified example will push all args to stack for now for simplicity,
-            // then move to registers if within first 6.
-            // A more robust implementation would manage register allocation.
-            
-            // Save caller-saved registers if needed before function call (e.g., RAX, RCX, RDX, RSI, RDI, R8-R11)
-            // For this simple example, we assume no complex register usage conflicts.
-
-            int num_args = args_list->count;
-            // Arguments beyond 6 are pushed onto the stack in reverse order.
-            // Arguments 1-6 are passed in RDI, RSI, RDX, RCX, R8, R9.
-            // We'll generate code that puts results into RAX and then moves them to appropriate regs.
-
-            // Evaluate arguments and store them in temporary stack space or registers
-            // For simplicity, let's assume max 6 arguments and place them directly into registers.
-            // This is a very simplified approach for a beginner compiler.
-            // A real compiler would manage stack frame and register allocation.
-            
-            // Push arguments onto stack for evaluation, then move to registers
-            // This is a common pattern for handling expressions as arguments.
-            for (int i = num_args - 1; i >= 0; --i) {
-                generate_expression_code(args_list->nodes[i]); // Result in RAX
-                emitf("  push rax\n"); // Push argument value
-                current_stack_offset += 8;
-            }
-
-            // Pop arguments into registers in correct order (RDI, RSI, RDX, RCX, R8, R9)
-            // This assumes integer arguments.
-            const char* arg_regs[] = {"rdi", "rsi", "rdx", "rcx", "r8", "r9"};
-            for (int i = 0; i < num_args && i < 6; ++i) {
-                emitf("  pop %s\n", arg_regs[i]);
-                current_stack_offset -= 8;
-            }
-
-            // Align stack to 16-byte boundary before call if needed (System V ABI)
-            // This is crucial for many C functions.
-            int stack_adjustment = (current_stack_offset % 16!= 0)? (16 - (current_stack_offset % 16)) : 0;
-            if (stack_adjustment > 0) {
-                emitf("  sub rsp, %d\n", stack_adjustment);
-                current_stack_offset += stack_adjustment;
-            }
-
-            emitf("  call %s\n", node->data.function_call.name); // Call the function
-
-            // Clean up stack after call (if arguments were pushed beyond 6 registers)
-            // For System V ABI, caller cleans up stack for arguments passed on stack.
-            // Here, we pushed all args, so we pop them.
-            // The `pop` operations above handle the cleanup for up to 6 args.
-            // If more than 6 args were passed, they would be popped here.
-            
-            if (stack_adjustment > 0) {
-                emitf("  add rsp, %d\n", stack_adjustment);
-                current_stack_offset -= stack_adjustment;
-            }
-
-            // Return value is in RAX, as per convention
-            break;
-        }
-        default:
-            fprintf(stderr, "Code Generation Error: Unexpected AST node type in expression: %d\n", node->type);
-            exit(1);
-    }
-}
-
-// Function to generate code for statements
-void generate_statement_code(ASTNode* node) {
-    if (!node) return;
-
-    switch (node->type) {
-        case AST_RETURN_STMT:
-            generate_expression_code(node->data.return_stmt.expr);
-            // The return value is already in rax, which is the convention
-            // Function epilogue will handle `ret` instruction
-            break;
-        case AST_EXPRESSION_STMT:
-            generate_expression_code(node->data.expression_stmt.expr);
-            // If it's just an expression statement, its result might be discarded
-            break;
-        case AST_BLOCK:
-            for (size_t i = 0; i < node->data.node_list.list->count; ++i) {
-                generate_statement_code(node->data.node_list.list->nodes[i]);
-            }
-            break;
-        default:
-            fprintf(stderr, "Code Generation Error: Unexpected AST node type in statement: %d\n", node->type);
-            exit(1);
-    }
-}
-
-// Main code generation function
-void generate_code(ASTNode* ast) {
-    if (!ast || ast->type!= AST_PROGRAM) {
-        fprintf(stderr, "Code Generation Error: Invalid AST root node.\n");
-        exit(1);
-    }
-
-    emitf(".intel_syntax noprefix\n"); // Use Intel syntax, no % prefix
-    emitf(".data\n"); // Data section (if needed for global variables, not used here)
-    emitf(".text\n"); // Code section
-
-    // Iterate through function definitions
-    for (size_t i = 0; i < ast->data.node_list.list->count; ++i) {
-        ASTNode* func_def = ast->data.node_list.list->nodes[i];
-        if (func_def->type!= AST_FUNCTION_DEF) {
-            fprintf(stderr, "Code Generation Error: Expected function definition.\n");
-            exit(1);
-        }
-
-        emitf(".global %s\n", func_def->data.function_def.name); // Declare global function
-        emitf("%s:\n", func_def->data.function_def.name); // Function label
-
-        // Function Prologue
-        emitf("  push rbp\n"); // Save old base pointer [38, 39, 40]
-        emitf("  mov rbp, rsp\n"); // Set new base pointer [38, 39, 40]
-        
-        // Allocate space for local variables (if any)
-        // For this simple compiler, we assume no explicit local variable declarations yet.
-        // If there were local variables, space would be allocated here: sub rsp, <size_of_locals>
-        
-        // Handle parameters: For System V ABI, first 6 integer parameters are in registers.
-        // We need to store them on the stack if they are used as local variables.
-        // For this simple compiler, we'll assume parameters are not directly used as local variables
-        // and only function calls are handled, where arguments are passed via registers/stack.
-        // A more complete compiler would iterate through func_def->data.function_def.params
-        // and store them at specific offsets from RBP.
-        
-        // Example for storing parameters on stack (simplified, assuming all are 8-byte ints):
-        // int param_offset = 16; // Start after RBP and return address
-        // for (size_t p_idx = 0; p_idx < func_def->data.function_def.params->data.node_list.list->count; ++p_idx) {
-        //     // This mapping needs to be consistent with calling convention
-        //     // For System V ABI, RDI, RSI, RDX, RCX, R8, R9 are used for first 6.
-        //     // Beyond that, parameters are on the stack.
-        //     // This requires a symbol table to map parameter names to their stack/register locations.
-        //     // For simplicity, this is omitted.
-        // }
-
-        // Generate code for function body
-        generate_statement_code(func_def->data.function_def.body);
-
-        // Function Epilogue
-        emitf("  mov rsp, rbp\n"); // Restore stack pointer [38, 39, 40]
-        emitf("  pop rbp\n"); // Restore old base pointer [38, 39, 40]
-        emitf("  ret\n"); // Return from function [38, 40]
-        emitf("\n");
-    }
-}
\ No newline at end of file
+// codegen.c (simplified snippet)
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "codegen.h"
+#include "lower.h"
+#include "emit.h"
+
+// Instruction selection and register allocation from the IR (ir.h), one
+// function at a time: lower_function builds it, the verifier checks it, a
+// linear scan over value lifetimes picks registers, and each IR instruction
+// becomes a few x86-64 ones.
+//
+// Values live in caller-saved registers unless a call happens during their
+// lifetime, in which case they take a callee-saved one (saved in the
+// prologue). When neither is free the value that lives longest is spilled to
+// a stack slot below the saved registers. A parameter keeps the register it
+// came in while that register is free for it, so leaf functions leave their
+// arguments where the caller put them; one passed on the stack stays there
+// when spilled. A value whose last use is as a call's argument likewise
+// prefers that argument's register, so it is computed where the call wants
+// it. Constants get no location: they are folded into the instructions that
+// use them. rax, rdx and r11 are never allocated, since idiv and calls pin
+// the first two and r11 is the temporary for spilled values and constants.
+static const Reg caller_saved_regs[] = {REG_RCX, REG_RSI, REG_RDI, REG_R8, REG_R9, REG_R10};
+static const Reg callee_saved_regs[] = {REG_RBX, REG_R12, REG_R13, REG_R14, REG_R15};
+#define CALLER_SAVED_COUNT ((int)(sizeof(caller_saved_regs) / sizeof(caller_saved_regs[0])))
+#define CALLEE_SAVED_COUNT ((int)(sizeof(callee_saved_regs) / sizeof(callee_saved_regs[0])))
+#define TEMP_REG REG_R11
+
+static const Reg arg_regs[] = {REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9};
+
+// An int is the low 32 bits of its register or stack slot. The System V ABI
+// leaves the upper half of int arguments and results undefined, and add, sub,
+// imul and lea carry whatever is there along, so nothing may read it:
+// division, the only operation whose low half depends on the upper one, works
+// on 32-bit or sign-extended operands (emit_divide_by_constant,
+// generate_division). Parameters and call results are therefore used as they
+// come in, without a movsxd each.
+
+// Where a value lives from its definition to its last use
+typedef enum {
+    LOC_UNUSED, // nothing reads it
+    LOC_CONST,  // an IR_CONST, rematerialized at each use
+    LOC_REG,
+    LOC_SLOT,   // spilled to a stack slot
+    LOC_INCOMING, // a parameter past the sixth, left where the caller pushed it
+} LocationKind;
+
+typedef struct Location {
+    uint8_t kind; // LocationKind
+    uint8_t reg;  // LOC_REG
+    int value;    // LOC_CONST: the constant; LOC_SLOT: the slot index; LOC_INCOMING: the parameter number
+} Location;
+
+// Per-call code generation state, so several programs can be compiled at once.
+// Assembly goes into the emitter passed to generate_code. Hot instruction
+// shapes use the emit_* fast paths; emitf is for everything else. The arrays
+// are indexed by value or instruction and kept for the next function.
+typedef struct CodeGen {
+    Emitter* out;
+    const AST* ast;
+    const Interner* names;
+    const OptimizeOptions* options;
+    Lowerer lowerer;
+    IrFunction ir;
+    uint8_t* defined; // by SymbolId: a function of that name came earlier in the program
+
+    Location* where;
+    uint32_t* defined_at; // instruction index of each value's definition
+    uint32_t* last_use;   // instruction index of its last use; defined_at if unused
+    uint8_t* hint;        // the Reg its last use wants it in, REG_COUNT for none
+    uint32_t value_capacity;
+    uint32_t* calls_before; // calls among the instructions before each index
+    uint32_t instr_capacity;
+
+    IrValue active[REG_COUNT]; // values in registers, at the current instruction
+    int active_count;
+    uint32_t* slot_end; // last use of anything in each slot so far
+    uint32_t slot_count;
+    uint32_t slot_capacity;
+    int saved_regs[CALLEE_SAVED_COUNT]; // callee-saved registers in use, in push order
+    int saved_count;
+    uint32_t outgoing_count; // stack arguments of the call that passes the most, stored at rsp
+    int frame_size; // bytes reserved below the saved registers, for slots and outgoing arguments
+    char* loop_label; // ".L<function>.loop", where self tail calls jump back to
+    size_t loop_label_length;
+    size_t loop_label_capacity;
+} CodeGen;
+#define emitf(...) emit_fmt(cg->out, __VA_ARGS__)
+
+static void* grow_array(void* items, size_t count, size_t item_size) {
+    void* grown = realloc(items, count * item_size);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed for code generation.\n");
+        exit(1);
+    }
+    return grown;
+}
+
+// dst = dst * c using at most two shl/lea instructions (a neg counts as one),
+// for c = +-2^k * m with m a product of at most two of 3, 5 and 9. Each of
+// those takes a cycle where imul takes three. Returns 0, emitting nothing,
+// when c has no such form.
+static int emit_multiply_by_shifts(CodeGen* cg, Reg dst, long long c) {
+    static const int lea_scales[] = {8, 4, 2}; // x + x*scale = 9x, 5x, 3x; 9 before 3*3
+    unsigned long long magnitude = c < 0 ? 0ULL - (unsigned long long)c : (unsigned long long)c;
+    int shift = 0;
+    while (!(magnitude & 1)) {
+        magnitude >>= 1;
+        ++shift;
+    }
+    int leas[2], lea_count = 0;
+    for (int i = 0; i < 3 && magnitude > 1; ++i) {
+        while (magnitude % (unsigned long long)(lea_scales[i] + 1) == 0 && lea_count < 2) {
+            leas[lea_count++] = lea_scales[i];
+            magnitude /= (unsigned long long)(lea_scales[i] + 1);
+        }
+    }
+    if (magnitude != 1 || lea_count + (shift > 0) + (c < 0) > 2) return 0;
+    for (int i = 0; i < lea_count; ++i) emit_lea(cg->out, dst, dst, leas[i]);
+    if (shift) emit_reg_imm(cg->out, OP_SHL, dst, shift);
+    if (c < 0) emit_reg(cg->out, OP_NEG, dst);
+    return 1;
+}
+
+// Multiplier and shift for signed 32-bit division by d (|d| >= 2, not a power
+// of two): q = (mulhs(n, multiplier) +- n) >> shift, plus one if negative.
+// Hacker's Delight, figure 10-1.
+typedef struct DivisionMagic {
+    int multiplier;
+    int shift;
+} DivisionMagic;
+
+static DivisionMagic signed_division_magic(int d) {
+    const uint32_t two31 = 1u << 31;
+    uint32_t ad = d < 0 ? 0u - (uint32_t)d : (uint32_t)d;
+    uint32_t t = two31 + ((uint32_t)d >> 31);
+    uint32_t anc = t - 1 - t % ad; // absolute value of nc
+    uint32_t q1 = two31 / anc, r1 = two31 - q1 * anc;
+    uint32_t q2 = two31 / ad, r2 = two31 - q2 * ad;
+    uint32_t delta;
+    int p = 31;
+    do {
+        ++p;
+        q1 *= 2;
+        r1 *= 2;
+        if (r1 >= anc) {
+            ++q1;
+            r1 -= anc;
+        }
+        q2 *= 2;
+        r2 *= 2;
+        if (r2 >= ad) {
+            ++q2;
+            r2 -= ad;
+        }
+        delta = ad - r2;
+    } while (q1 < delta || (q1 == delta && r1 == 0));
+    DivisionMagic magic;
+    magic.multiplier = (int)(d < 0 ? 0u - (q2 + 1) : q2 + 1);
+    magic.shift = p - 32;
+    return magic;
+}
+
+// dst = dst / d, truncating toward zero like idiv, without idiv. d is nonzero.
+// Everything runs on the low 32 bits, the int, so the upper half of dst does
+// not matter and INT_MIN / -1 wraps as the folder has it. Multiplying high
+// clobbers rax and rdx as idiv would; powers of two take r11 as a temporary
+// instead.
+static void emit_divide_by_constant(CodeGen* cg, Reg dst, int d) {
+    uint32_t magnitude = d < 0 ? 0u - (uint32_t)d : (uint32_t)d;
+    if (magnitude == 1) {
+        if (d < 0) emit_reg32(cg->out, OP_NEG, dst);
+        return;
+    }
+    if ((magnitude & (magnitude - 1)) == 0) {
+        // Arithmetic shifts round toward minus infinity, so negative
+        // dividends get 2^k - 1 added first: r11 = dst < 0 ? 2^k - 1 : 0
+        int k = 0;
+        while ((1u << k) != magnitude) ++k;
+        emit_reg_reg(cg->out, OP_MOV, TEMP_REG, dst);
+        if (k > 1) emit_reg_imm32(cg->out, OP_SAR, TEMP_REG, 31);
+        emit_reg_imm32(cg->out, OP_SHR, TEMP_REG, 32 - k);
+        emit_reg_reg32(cg->out, OP_ADD, dst, TEMP_REG);
+        emit_reg_imm32(cg->out, OP_SAR, dst, k);
+        if (d < 0) emit_reg32(cg->out, OP_NEG, dst);
+        return;
+    }
+    DivisionMagic magic = signed_division_magic(d);
+    emit_reg_imm32(cg->out, OP_MOV, REG_RAX, magic.multiplier);
+    emit_reg32(cg->out, OP_IMUL, dst); // edx = high half of dst * multiplier
+    if (d > 0 && magic.multiplier < 0) emit_reg_reg32(cg->out, OP_ADD, REG_RDX, dst);
+    if (d < 0 && magic.multiplier > 0) emit_reg_reg32(cg->out, OP_SUB, REG_RDX, dst);
+    if (magic.shift > 0) emit_reg_imm32(cg->out, OP_SAR, REG_RDX, magic.shift);
+    emit_reg_reg(cg->out, OP_MOV, dst, REG_RDX);
+    emit_reg_imm32(cg->out, OP_SHR, REG_RDX, 31); // add one to a negative quotient
+    emit_reg_reg32(cg->out, OP_ADD, dst, REG_RDX);
+}
+
+// dst = dst <op> value; a divisor is nonzero
+static void emit_binary_op_constant(CodeGen* cg, IrOp op, Reg dst, int value) {
+    switch (op) {
+        case IR_ADD:
+            emit_reg_imm(cg->out, OP_ADD, dst, value);
+            break;
+        case IR_SUB:
+            emit_reg_imm(cg->out, OP_SUB, dst, value);
+            break;
+        case IR_MUL:
+            if (cg->options->strength_reduce) {
+                if (value == 0) {
+                    emit_reg_imm(cg->out, OP_MOV, dst, 0);
+                    break;
+                }
+                if (emit_multiply_by_shifts(cg, dst, value)) break;
+            }
+            emit_reg_imm(cg->out, OP_IMUL, dst, value);
+            break;
+        default: // IR_DIV
+            emit_divide_by_constant(cg, dst, value);
+            break;
+    }
+}
+
+// Register allocation
+
+// Makes room for the current function's values and instructions
+static void reserve_function(CodeGen* cg) {
+    const IrFunction* f = &cg->ir;
+    if (f->value_count + 1 > cg->value_capacity) {
+        uint32_t capacity = cg->value_capacity ? cg->value_capacity : 256;
+        while (capacity < f->value_count + 1) capacity *= 2;
+        cg->where = (Location*)grow_array(cg->where, capacity, sizeof(Location));
+        cg->defined_at = (uint32_t*)grow_array(cg->defined_at, capacity, sizeof(uint32_t));
+        cg->last_use = (uint32_t*)grow_array(cg->last_use, capacity, sizeof(uint32_t));
+        cg->hint = (uint8_t*)grow_array(cg->hint, capacity, sizeof(uint8_t));
+        cg->value_capacity = capacity;
+    }
+    if (f->instr_count + 1 > cg->instr_capacity) {
+        uint32_t capacity = cg->instr_capacity ? cg->instr_capacity : 256;
+        while (capacity < f->instr_count + 1) capacity *= 2;
+        cg->calls_before = (uint32_t*)grow_array(cg->calls_before, capacity, sizeof(uint32_t));
+        cg->instr_capacity = capacity;
+    }
+}
+
+static void note_use(CodeGen* cg, IrValue value, uint32_t at) {
+    cg->last_use[value] = at;
+    cg->hint[value] = REG_COUNT;
+}
+
+static void note_arguments(CodeGen* cg, const IrInstr* instr, uint32_t at) {
+    const IrFunction* f = &cg->ir;
+    for (uint32_t j = 0; j < instr->c; ++j) note_use(cg, f->operands[instr->b + j], at);
+    for (uint32_t j = 0; j < instr->c && j < 6; ++j) cg->hint[f->operands[instr->b + j]] = (uint8_t)arg_regs[j];
+}
+
+// Whether a tail call's stack arguments fit where this function's own came in
+static int reuses_incoming_arguments(const CodeGen* cg, const IrInstr* instr) {
+    return instr->c <= 6 || instr->c <= cg->ir.param_count;
+}
+
+// Lifetimes as instruction index ranges, and the register each value's last
+// use would like it in. Parameters aside, every value is used in the block
+// that defines it, so one walk in order finds them.
+static void compute_lifetimes(CodeGen* cg) {
+    const IrFunction* f = &cg->ir;
+    uint32_t calls = 0;
+    cg->outgoing_count = 0;
+    for (uint32_t i = 0; i < f->instr_count; ++i) {
+        const IrInstr* instr = &f->instrs[i];
+        cg->calls_before[i] = calls;
+        switch (instr->op) {
+            case IR_ADD:
+            case IR_SUB:
+            case IR_MUL:
+            case IR_DIV:
+                note_use(cg, instr->a, i);
+                note_use(cg, instr->b, i);
+                break;
+            case IR_CALL:
+                note_arguments(cg, instr, i);
+                if (instr->c > 6 + cg->outgoing_count) cg->outgoing_count = instr->c - 6;
+                ++calls;
+                break;
+            case IR_TAIL_CALL: // ends the function, so nothing lives across it
+                note_arguments(cg, instr, i);
+                if (!reuses_incoming_arguments(cg, instr) && instr->c > 6 + cg->outgoing_count) {
+                    cg->outgoing_count = instr->c - 6;
+                }
+                break;
+            case IR_RET:
+                note_use(cg, instr->a, i);
+                break;
+        }
+        if (instr->dst != IR_NONE) {
+            cg->defined_at[instr->dst] = i;
+            cg->last_use[instr->dst] = i;
+            cg->hint[instr->dst] = REG_COUNT;
+        }
+    }
+    cg->calls_before[f->instr_count] = calls;
+}
+
+// Whether a call happens after value is defined and before its last use
+static int crosses_call(const CodeGen* cg, IrValue value) {
+    return cg->calls_before[cg->last_use[value]] > cg->calls_before[cg->defined_at[value] + 1];
+}
+
+// The parameter value is, or -1 if it is none
+static int parameter_number(const CodeGen* cg, IrValue value) {
+    const IrInstr* def = &cg->ir.instrs[cg->defined_at[value]];
+    return def->op == IR_PARAM ? (int)def->a : -1;
+}
+
+// Gives value a stack slot nothing else uses during its lifetime. Parameters
+// the caller pushed need none.
+static void spill(CodeGen* cg, IrValue value) {
+    int param = parameter_number(cg, value);
+    if (param >= 6) {
+        cg->where[value].kind = LOC_INCOMING;
+        cg->where[value].value = param;
+        return;
+    }
+    uint32_t slot = 0;
+    while (slot < cg->slot_count && cg->slot_end[slot] > cg->defined_at[value]) ++slot;
+    if (slot == cg->slot_count) {
+        if (cg->slot_count == cg->slot_capacity) {
+            cg->slot_capacity = cg->slot_capacity ? cg->slot_capacity * 2 : 16;
+            cg->slot_end = (uint32_t*)grow_array(cg->slot_end, cg->slot_capacity, sizeof(uint32_t));
+        }
+        cg->slot_count++;
+        cg->slot_end[slot] = 0;
+    }
+    if (cg->last_use[value] > cg->slot_end[slot]) cg->slot_end[slot] = cg->last_use[value];
+    cg->where[value].kind = LOC_SLOT;
+    cg->where[value].value = (int)slot;
+}
+
+static int register_taken(const CodeGen* cg, Reg reg) {
+    for (int i = 0; i < cg->active_count; ++i) {
+        if (cg->where[cg->active[i]].reg == reg) return 1;
+    }
+    return 0;
+}
+
+static void note_callee_saved(CodeGen* cg, Reg reg) {
+    for (int i = 0; i < cg->saved_count; ++i) {
+        if (cg->saved_regs[i] == (int)reg) return;
+    }
+    cg->saved_regs[cg->saved_count++] = (int)reg;
+}
+
+// A free register for a value, or REG_COUNT when there is none. Values that
+// live across a call may only have a callee-saved one. Registers in avoid (a
+// mask of 1 << Reg) are taken only when no other is free.
+static Reg free_register(const CodeGen* cg, int across_call, uint32_t avoid) {
+    for (int pass = 0; pass < 2; ++pass, avoid = 0) {
+        if (!across_call) {
+            for (int i = 0; i < CALLER_SAVED_COUNT; ++i) {
+                Reg reg = caller_saved_regs[i];
+                if (!(avoid >> reg & 1) && !register_taken(cg, reg)) return reg;
+            }
+        }
+        for (int i = 0; i < CALLEE_SAVED_COUNT; ++i) {
+            if (!register_taken(cg, callee_saved_regs[i])) return callee_saved_regs[i];
+        }
+    }
+    return REG_COUNT;
+}
+
+// The register a parameter comes in, if one we allocate, or REG_COUNT
+static Reg incoming_register(int param) {
+    if (param < 0 || param >= 6 || arg_regs[param] == REG_RDX) return REG_COUNT;
+    return arg_regs[param];
+}
+
+// Incoming registers of the parameters after param that are still to be
+// allocated, which param should leave to them
+static uint32_t later_parameter_registers(const CodeGen* cg, int param) {
+    uint32_t mask = 0;
+    for (int i = param + 1; i < 6 && i < (int)cg->ir.param_count; ++i) {
+        Reg reg = incoming_register(i);
+        if (reg != REG_COUNT) mask |= 1u << reg;
+    }
+    return mask;
+}
+
+static int is_callee_saved(Reg reg) {
+    for (int i = 0; i < CALLEE_SAVED_COUNT; ++i) {
+        if (callee_saved_regs[i] == reg) return 1;
+    }
+    return 0;
+}
+
+static void assign_register(CodeGen* cg, IrValue value, Reg reg) {
+    cg->where[value].kind = LOC_REG;
+    cg->where[value].reg = (uint8_t)reg;
+    if (is_callee_saved(reg)) note_callee_saved(cg, reg);
+}
+
+// Linear scan. A value whose last use is the instruction defining another
+// frees its register for it, so the instruction selection below copes with a
+// result in the same register as an operand.
+static void allocate_registers(CodeGen* cg) {
+    const IrFunction* f = &cg->ir;
+    cg->active_count = 0;
+    cg->slot_count = 0;
+    cg->saved_count = 0;
+    for (uint32_t i = 0; i < f->instr_count; ++i) {
+        const IrInstr* instr = &f->instrs[i];
+        IrValue value = instr->dst;
+        if (value == IR_NONE) continue;
+        Location* loc = &cg->where[value];
+        if (instr->op == IR_CONST) {
+            loc->kind = LOC_CONST;
+            loc->value = (int)instr->a;
+            continue;
+        }
+        if (cg->last_use[value] == i) {
+            loc->kind = LOC_UNUSED;
+            continue;
+        }
+
+        int kept = 0;
+        for (int j = 0; j < cg->active_count; ++j) {
+            if (cg->last_use[cg->active[j]] > i) cg->active[kept++] = cg->active[j];
+        }
+        cg->active_count = kept;
+
+        int across_call = crosses_call(cg, value);
+        Reg reg = REG_COUNT;
+        uint32_t avoid = 0;
+        if (instr->op == IR_PARAM) {
+            Reg incoming = incoming_register((int)instr->a);
+            if (incoming != REG_COUNT && !across_call && !register_taken(cg, incoming)) reg = incoming;
+            avoid = later_parameter_registers(cg, (int)instr->a);
+        } else if (cg->hint[value] != REG_COUNT && cg->hint[value] != REG_RDX && !across_call &&
+                   !register_taken(cg, (Reg)cg->hint[value])) {
+            reg = (Reg)cg->hint[value];
+        }
+        if (reg == REG_COUNT) reg = free_register(cg, across_call, avoid);
+        if (instr->op == IR_PARAM && instr->a >= 6 && (reg == REG_COUNT || is_callee_saved(reg))) {
+            // Reloading it from the caller's frame beats saving a register for it
+            spill(cg, value);
+            continue;
+        }
+        if (reg != REG_COUNT) {
+            assign_register(cg, value, reg);
+            cg->active[cg->active_count++] = value;
+            continue;
+        }
+        // Spill whichever of this value and those in suitable registers lives longest
+        int victim = -1;
+        for (int j = 0; j < cg->active_count; ++j) {
+            IrValue other = cg->active[j];
+            if (across_call && !is_callee_saved((Reg)cg->where[other].reg)) continue;
+            if (victim < 0 || cg->last_use[other] > cg->last_use[cg->active[victim]]) victim = j;
+        }
+        if (victim >= 0 && cg->last_use[cg->active[victim]] > cg->last_use[value]) {
+            IrValue other = cg->active[victim];
+            assign_register(cg, value, (Reg)cg->where[other].reg);
+            spill(cg, other);
+            cg->active[victim] = value;
+        } else {
+            spill(cg, value);
+        }
+    }
+    // The frame keeps rsp 16-byte aligned: the return address and rbp make 16.
+    // Outgoing arguments go at the bottom, where rsp points during calls.
+    int below = 8 * (cg->saved_count + (int)cg->slot_count + (int)cg->outgoing_count);
+    cg->frame_size = 8 * (int)(cg->slot_count + cg->outgoing_count) + (below % 16 ? 8 : 0);
+}
+
+// Instruction selection
+
+static int slot_offset(const CodeGen* cg, int slot) {
+    return -8 * (cg->saved_count + slot + 1);
+}
+
+// Where the caller put parameter param (past the sixth), above the return address
+static int incoming_offset(int param) {
+    return 16 + 8 * (param - 6);
+}
+
+// The register holding what is at loc: its own, or temp once it has been put there
+static Reg use_location(CodeGen* cg, const Location* loc, Reg temp) {
+    switch (loc->kind) {
+        case LOC_REG:
+            return (Reg)loc->reg;
+        case LOC_CONST:
+            emit_reg_imm(cg->out, OP_MOV, temp, loc->value);
+            return temp;
+        case LOC_INCOMING:
+            emit_load(cg->out, temp, REG_RBP, incoming_offset(loc->value));
+            return temp;
+        default: // LOC_SLOT
+            emit_load(cg->out, temp, REG_RBP, slot_offset(cg, loc->value));
+            return temp;
+    }
+}
+
+// The register holding value: its own, or temp once it has been put there
+static Reg use_value(CodeGen* cg, IrValue value, Reg temp) {
+    return use_location(cg, &cg->where[value], temp);
+}
+
+// dst = value
+static void move_value(CodeGen* cg, Reg dst, IrValue value) {
+    Reg reg = use_value(cg, value, dst);
+    if (reg != dst) emit_reg_reg(cg->out, OP_MOV, dst, reg);
+}
+
+// The register a result is computed in: its own, or temp if it is spilled
+static Reg result_register(const CodeGen* cg, IrValue value, Reg temp) {
+    const Location* loc = &cg->where[value];
+    return loc->kind == LOC_REG ? (Reg)loc->reg : temp;
+}
+
+// Stores a result computed in reg to its slot, if it has one
+static void store_result(CodeGen* cg, IrValue value, Reg reg) {
+    const Location* loc = &cg->where[value];
+    if (loc->kind == LOC_SLOT) emit_store(cg->out, REG_RBP, slot_offset(cg, loc->value), reg);
+    else if (loc->kind == LOC_REG && loc->reg != reg) emit_reg_reg(cg->out, OP_MOV, (Reg)loc->reg, reg);
+}
+
+static Opcode arithmetic_opcode(IrOp op) {
+    return op == IR_ADD ? OP_ADD : op == IR_SUB ? OP_SUB : OP_IMUL;
+}
+
+// dst = dst <op> value, for an operand that is not a constant
+static void emit_operand_op(CodeGen* cg, Opcode op, Reg dst, IrValue value) {
+    emit_reg_reg(cg->out, op, dst, use_value(cg, value, REG_RAX));
+}
+
+// add, sub and mul. Without a use they do nothing worth keeping.
+static void generate_arithmetic(CodeGen* cg, const IrInstr* instr) {
+    if (cg->where[instr->dst].kind == LOC_UNUSED) return;
+    Opcode op = arithmetic_opcode((IrOp)instr->op);
+    const Location* left = &cg->where[instr->a];
+    const Location* right = &cg->where[instr->b];
+    Reg dst = result_register(cg, instr->dst, TEMP_REG);
+    if (right->kind == LOC_CONST) {
+        move_value(cg, dst, instr->a);
+        emit_binary_op_constant(cg, (IrOp)instr->op, dst, right->value);
+    } else if (right->kind == LOC_REG && right->reg == dst) {
+        // The right operand dies here and the result took its register
+        if (instr->a == instr->b) {
+            if (instr->op == IR_SUB) emit_reg_imm(cg->out, OP_MOV, dst, 0);
+            else emit_reg_reg(cg->out, op, dst, dst);
+        } else if (instr->op == IR_SUB) {
+            emit_reg(cg->out, OP_NEG, dst); // a - b = -b + a
+            if (left->kind == LOC_CONST) emit_reg_imm(cg->out, OP_ADD, dst, left->value);
+            else emit_operand_op(cg, OP_ADD, dst, instr->a);
+        } else if (left->kind == LOC_CONST) {
+            emit_binary_op_constant(cg, (IrOp)instr->op, dst, left->value);
+        } else {
+            emit_operand_op(cg, op, dst, instr->a);
+        }
+    } else {
+        Reg src = use_value(cg, instr->b, REG_RAX);
+        move_value(cg, dst, instr->a);
+        emit_reg_reg(cg->out, op, dst, src);
+    }
+    store_result(cg, instr->dst, dst);
+}
+
+// Whether dividing by d takes the multiply-high sequence, which needs rax and rdx
+static int divides_by_multiplying(int d) {
+    uint32_t magnitude = d < 0 ? 0u - (uint32_t)d : (uint32_t)d;
+    return magnitude != 1 && (magnitude & (magnitude - 1)) != 0;
+}
+
+static void generate_division(CodeGen* cg, const IrInstr* instr) {
+    const Location* right = &cg->where[instr->b];
+    int unused = cg->where[instr->dst].kind == LOC_UNUSED;
+    if (right->kind == LOC_CONST && right->value != 0 && cg->options->strength_reduce) {
+        if (unused) return; // cannot trap
+        Reg dst = result_register(cg, instr->dst, divides_by_multiplying(right->value) ? TEMP_REG : REG_RAX);
+        move_value(cg, dst, instr->a);
+        emit_divide_by_constant(cg, dst, right->value);
+        store_result(cg, instr->dst, dst);
+        return;
+    }
+    // Kept even when unused, so division by zero still traps. Only the low 32
+    // bits of an int are defined (the caller of an exported function leaves
+    // garbage above them), so both operands are sign-extended first; the
+    // 64-bit quotient's low half then wraps INT_MIN / -1 as fold_binary does,
+    // where idiv on 32-bit operands would trap.
+    // A constant dividend is loaded into rax already sign-extended
+    Reg dividend = use_value(cg, instr->a, REG_RAX);
+    if (cg->where[instr->a].kind != LOC_CONST) emit_reg_reg(cg->out, OP_MOVSXD, REG_RAX, dividend);
+    Reg src = use_value(cg, instr->b, TEMP_REG);
+    if (right->kind != LOC_CONST) {
+        emit_reg_reg(cg->out, OP_MOVSXD, TEMP_REG, src);
+        src = TEMP_REG;
+    }
+    emit_op(cg->out, OP_CQO); // Sign-extend rax into rdx (rdx:rax is the dividend)
+    emit_reg(cg->out, OP_IDIV, src); // rax = (rdx:rax) / src
+    if (!unused) store_result(cg, instr->dst, REG_RAX);
+}
+
+// One register of a parallel move: dst = what is at src
+typedef struct Move {
+    Reg dst;
+    Location src;
+} Move;
+
+// Whether a pending move other than moves[except] reads reg
+static int move_reads(const Move* moves, int count, int except, Reg reg) {
+    for (int i = 0; i < count; ++i) {
+        if (i != except && moves[i].src.kind == LOC_REG && moves[i].src.reg == reg) return 1;
+    }
+    return 0;
+}
+
+// Performs the moves as if all at once; destinations are distinct registers.
+// A move goes once nothing else still reads its destination; when every
+// one left is waiting, the rest are register cycles, and copying one
+// destination to the temporary register frees it to break its cycle.
+// Constants and memory are loaded straight into their destinations.
+static void emit_parallel_move(CodeGen* cg, Move* moves, int count) {
+    for (int i = 0; i < count;) {
+        if (moves[i].src.kind == LOC_REG && moves[i].src.reg == moves[i].dst) moves[i] = moves[--count];
+        else ++i;
+    }
+    while (count > 0) {
+        int moved = 0;
+        for (int i = 0; i < count;) {
+            if (move_reads(moves, count, i, moves[i].dst)) {
+                ++i;
+                continue;
+            }
+            Reg reg = use_location(cg, &moves[i].src, moves[i].dst);
+            if (reg != moves[i].dst) emit_reg_reg(cg->out, OP_MOV, moves[i].dst, reg);
+            moves[i] = moves[--count];
+            moved = 1;
+        }
+        if (moved) continue;
+        Reg blocked = moves[0].dst;
+        emit_reg_reg(cg->out, OP_MOV, TEMP_REG, blocked);
+        for (int i = 0; i < count; ++i) {
+            if (moves[i].src.kind == LOC_REG && moves[i].src.reg == blocked) moves[i].src.reg = (uint8_t)TEMP_REG;
+        }
+    }
+}
+
+// Moves the first six arguments of a call into rdi, rsi, rdx, rcx, r8 and r9
+// as per the System V AMD64 ABI
+static void move_register_arguments(CodeGen* cg, const IrInstr* instr) {
+    const IrFunction* f = &cg->ir;
+    Move moves[6];
+    int count = 0;
+    for (uint32_t i = 0; i < instr->c && i < 6; ++i) {
+        moves[count].dst = arg_regs[i];
+        moves[count].src = cg->where[f->operands[instr->b + i]];
+        ++count;
+    }
+    emit_parallel_move(cg, moves, count);
+}
+
+// Arguments past the sixth are stored in order into the outgoing area at the
+// bottom of the frame, then the first six moved into their registers. Values
+// live across the call are in callee-saved registers or slots, so nothing
+// has to be saved around it, and the frame keeps rsp aligned for it. Leaves
+// the result in rax.
+static void emit_call_sequence(CodeGen* cg, const IrInstr* instr) {
+    const IrFunction* f = &cg->ir;
+    uint32_t count = instr->c;
+    for (uint32_t i = 6; i < count; ++i) {
+        Reg reg = use_value(cg, f->operands[instr->b + i], TEMP_REG);
+        emit_store(cg->out, REG_RSP, 8 * (int)(i - 6), reg);
+    }
+    move_register_arguments(cg, instr);
+
+    SymbolId callee = instr->a;
+    emit_call(cg->out, symbol_text(cg->names, callee), symbol_length(cg->names, callee), count < 6 ? (int)count : 6);
+}
+
+static void generate_call(CodeGen* cg, const IrInstr* instr) {
+    emit_call_sequence(cg, instr);
+    // Return value is in RAX, as per convention (only eax is defined)
+    if (cg->where[instr->dst].kind != LOC_UNUSED) store_result(cg, instr->dst, REG_RAX);
+}
+
+static void generate_prologue(CodeGen* cg) {
+    emit_reg(cg->out, OP_PUSH, REG_RBP);
+    emit_reg_reg(cg->out, OP_MOV, REG_RBP, REG_RSP);
+    for (int i = 0; i < cg->saved_count; ++i) emit_reg(cg->out, OP_PUSH, (Reg)cg->saved_regs[i]);
+    if (cg->frame_size) emit_reg_imm(cg->out, OP_SUB, REG_RSP, cg->frame_size);
+}
+
+// Undoes the prologue, leaving rsp at the return address
+static void generate_teardown(CodeGen* cg) {
+    if (cg->saved_count == 0) {
+        emit_reg_reg(cg->out, OP_MOV, REG_RSP, REG_RBP);
+    } else {
+        if (cg->frame_size) emit_reg_imm(cg->out, OP_ADD, REG_RSP, cg->frame_size);
+        for (int i = cg->saved_count; i-- > 0;) emit_reg(cg->out, OP_POP, (Reg)cg->saved_regs[i]);
+    }
+    emit_reg(cg->out, OP_POP, REG_RBP);
+}
+
+static void generate_return(CodeGen* cg, const IrInstr* instr) {
+    move_value(cg, REG_RAX, instr->a);
+    generate_teardown(cg);
+    emit_op(cg->out, OP_RET);
+}
+
+// A tail call of the function itself, which becomes a jump back to the loop label
+static int loops_back(const CodeGen* cg, const IrInstr* instr) {
+    return instr->op == IR_TAIL_CALL && instr->a == cg->ir.name && reuses_incoming_arguments(cg, instr);
+}
+
+// return callee(args) without a call of our own. The arguments go into place
+// as for a call, except that those past the sixth overwrite this function's
+// incoming ones. Other arguments may still read those, so they are pushed
+// first and stored only once the registers are set. A callee that takes more
+// of them than we did gets an ordinary call and return instead. A self tail
+// call then jumps back to just after the prologue, which makes the recursion
+// a loop; any other tears the frame down first, so the callee returns
+// straight to our caller.
+static void generate_tail_call(CodeGen* cg, const IrInstr* instr) {
+    const IrFunction* f = &cg->ir;
+    uint32_t count = instr->c;
+    if (!reuses_incoming_arguments(cg, instr)) {
+        emit_call_sequence(cg, instr);
+        generate_teardown(cg);
+        emit_op(cg->out, OP_RET);
+        return;
+    }
+    for (uint32_t i = count; i-- > 6;) {
+        emit_reg(cg->out, OP_PUSH, use_value(cg, f->operands[instr->b + i], TEMP_REG));
+    }
+    move_register_arguments(cg, instr);
+    for (uint32_t i = 6; i < count; ++i) {
+        emit_reg(cg->out, OP_POP, TEMP_REG);
+        emit_store(cg->out, REG_RBP, incoming_offset((int)i), TEMP_REG);
+    }
+    int arg_registers = count < 6 ? (int)count : 6;
+    if (loops_back(cg, instr)) {
+        emit_jump(cg->out, cg->loop_label, cg->loop_label_length, arg_registers);
+        return;
+    }
+    generate_teardown(cg);
+    emit_jump(cg->out, symbol_text(cg->names, instr->a), symbol_length(cg->names, instr->a), arg_registers);
+}
+
+// Puts the loop label after the prologue when a self tail call needs it
+static void generate_loop_label(CodeGen* cg) {
+    const IrFunction* f = &cg->ir;
+    uint32_t i = 0;
+    while (i < f->instr_count && !loops_back(cg, &f->instrs[i])) ++i;
+    if (i == f->instr_count) return;
+    size_t length = symbol_length(cg->names, f->name);
+    if (length + 8 > cg->loop_label_capacity) {
+        cg->loop_label_capacity = length + 8;
+        cg->loop_label = (char*)grow_array(cg->loop_label, cg->loop_label_capacity, 1);
+    }
+    memcpy(cg->loop_label, ".L", 2);
+    memcpy(cg->loop_label + 2, symbol_text(cg->names, f->name), length);
+    memcpy(cg->loop_label + 2 + length, ".loop", 5);
+    cg->loop_label_length = length + 7;
+    emit_label(cg->out, cg->loop_label, cg->loop_label_length);
+}
+
+// Whether parameter instr (an IR_PARAM) has to be moved from where it came in
+static int parameter_moves(const CodeGen* cg, const IrInstr* instr) {
+    const Location* loc = &cg->where[instr->dst];
+    if (loc->kind == LOC_UNUSED || loc->kind == LOC_INCOMING) return 0;
+    return loc->kind != LOC_REG || loc->reg != incoming_register((int)instr->a);
+}
+
+// Moves the parameters from where they came in to where they were allocated,
+// the IR_PARAM instructions at the top of the function: spilled ones are
+// stored first, then the rest go to their registers in one parallel move.
+static void generate_parameters(CodeGen* cg) {
+    const IrFunction* f = &cg->ir;
+    Move moves[REG_COUNT];
+    int count = 0;
+    for (uint32_t i = 0; i < f->instr_count && f->instrs[i].op == IR_PARAM; ++i) {
+        const IrInstr* instr = &f->instrs[i];
+        if (!parameter_moves(cg, instr)) continue;
+        if (cg->where[instr->dst].kind == LOC_SLOT) { // only those that came in registers
+            store_result(cg, instr->dst, arg_regs[instr->a]);
+            continue;
+        }
+        moves[count].dst = (Reg)cg->where[instr->dst].reg;
+        if (instr->a < 6) {
+            moves[count].src.kind = LOC_REG;
+            moves[count].src.reg = (uint8_t)arg_regs[instr->a];
+        } else {
+            moves[count].src.kind = LOC_INCOMING;
+            moves[count].src.value = (int)instr->a;
+        }
+        ++count;
+    }
+    emit_parallel_move(cg, moves, count);
+}
+
+// Lowers and checks one function definition into cg->ir. Returns 0, or -1
+// after reporting a semantic error in it.
+static int build_ir(CodeGen* cg, NodeId def) {
+    if (ast_kind(cg->ast, def) != AST_FUNCTION_DEF) {
+        fprintf(stderr, "Code Generation Error: Expected function definition.\n");
+        exit(1);
+    }
+    SymbolId name = ast_name(cg->ast, def);
+    if (cg->defined[name]) {
+        fprintf(stderr, "Code Generation Error: Function '%.*s' is defined twice.\n",
+                (int)symbol_length(cg->names, name), symbol_text(cg->names, name));
+        return -1;
+    }
+    cg->defined[name] = 1;
+    if (lower_function(&cg->lowerer, &cg->ir, def) != 0) return -1;
+    ir_verify(&cg->ir, cg->names);
+    return 0;
+}
+
+static void generate_function(CodeGen* cg) {
+    const IrFunction* f = &cg->ir;
+    reserve_function(cg);
+    compute_lifetimes(cg);
+    allocate_registers(cg);
+
+    emit_global(cg->out, symbol_text(cg->names, f->name), symbol_length(cg->names, f->name)); // Declare global function
+    emit_label(cg->out, symbol_text(cg->names, f->name), symbol_length(cg->names, f->name)); // Function label
+    generate_prologue(cg);
+    generate_loop_label(cg);
+    generate_parameters(cg);
+    for (uint32_t i = 0; i < f->instr_count; ++i) {
+        const IrInstr* instr = &f->instrs[i];
+        switch (instr->op) {
+            case IR_CONST:
+                break; // folded into its uses
+            case IR_PARAM:
+                break; // moved into place by generate_parameters
+            case IR_ADD:
+            case IR_SUB:
+            case IR_MUL:
+                generate_arithmetic(cg, instr);
+                break;
+            case IR_DIV:
+                generate_division(cg, instr);
+                break;
+            case IR_CALL:
+                generate_call(cg, instr);
+                break;
+            case IR_TAIL_CALL:
+                generate_tail_call(cg, instr);
+                break;
+            case IR_RET:
+                generate_return(cg, instr);
+                break;
+        }
+    }
+    emit_flush(cg->out); // the function is the peephole window
+    emitf("\n");
+}
+
+static void codegen_init(CodeGen* cg, const AST* ast, NodeId program, const Interner* names,
+                         const OptimizeOptions* options, Emitter* emitter) {
+    if (program == NODE_NONE || ast_kind(ast, program) != AST_PROGRAM) {
+        fprintf(stderr, "Code Generation Error: Invalid AST root node.\n");
+        exit(1);
+    }
+    memset(cg, 0, sizeof(*cg));
+    cg->out = emitter;
+    cg->ast = ast;
+    cg->names = names;
+    cg->options = options;
+    lowerer_init(&cg->lowerer, ast, names, options->tail_calls);
+    ir_init(&cg->ir);
+    cg->defined = (uint8_t*)grow_array(NULL, (size_t)names->symbol_count + 1, sizeof(uint8_t));
+    memset(cg->defined, 0, (size_t)names->symbol_count + 1);
+}
+
+static void codegen_free(CodeGen* cg) {
+    lowerer_free(&cg->lowerer);
+    ir_free(&cg->ir);
+    free(cg->defined);
+    free(cg->where);
+    free(cg->defined_at);
+    free(cg->last_use);
+    free(cg->hint);
+    free(cg->calls_before);
+    free(cg->slot_end);
+    free(cg->loop_label);
+}
+
+// Main code generation function
+int generate_code(const AST* ast, NodeId program, const Interner* names, const OptimizeOptions* options,
+                  Emitter* emitter) {
+    CodeGen state;
+    CodeGen* cg = &state;
+    codegen_init(cg, ast, program, names, options, emitter);
+
+    emitf(".intel_syntax noprefix\n"); // Use Intel syntax, no % prefix
+    emitf(".data\n"); // Data section (if needed for global variables, not used here)
+    emitf(".text\n"); // Code section
+
+    // After an error the other functions are still checked, but not generated
+    int status = 0;
+    for (uint32_t i = 0; i < ast_list_count(ast, program); ++i) {
+        if (build_ir(cg, ast_list_item(ast, program, i)) != 0) status = -1;
+        else if (status == 0) generate_function(cg);
+    }
+    codegen_free(cg);
+    return status;
+}
+
+int generate_ir(const AST* ast, NodeId program, const Interner* names, const OptimizeOptions* options,
+                Emitter* emitter) {
+    CodeGen state;
+    CodeGen* cg = &state;
+    codegen_init(cg, ast, program, names, options, emitter);
+    int status = 0;
+    for (uint32_t i = 0; i < ast_list_count(ast, program); ++i) {
+        if (build_ir(cg, ast_list_item(ast, program, i)) != 0) status = -1;
+        else if (status == 0) ir_dump(&cg->ir, names, emitter);
+    }
+    codegen_free(cg);
+    return status;
+}
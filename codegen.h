@@ -1,6 +1,19 @@
-// codegen.h
-#ifndef CODEGEN_H
-#define CODEGEN_H
-#include "ast.h"
-void generate_code(ASTNode* ast);
+// codegen.h
+#ifndef CODEGEN_H
+#define CODEGEN_H
+#include "ast.h"
+#include "emit.h"
+#include "optimize.h"
+// Appends the assembly for the AST_PROGRAM node program of ast to emitter;
+// names resolves its symbols, and options picks the instruction selection
+// (see OptimizeOptions). Keeps no global state, so separate programs can be
+// generated concurrently. Returns 0, or -1 after reporting semantic errors
+// (an undefined variable, a parameter declared twice, a function defined
+// twice); what emitter holds then is incomplete and must not be written out.
+int generate_code(const AST* ast, NodeId program, const Interner* names, const OptimizeOptions* options,
+                  Emitter* emitter);
+// Appends the IR generate_code would select instructions from, as text
+// (--emit-ir), instead of the assembly. Returns as generate_code does.
+int generate_ir(const AST* ast, NodeId program, const Interner* names, const OptimizeOptions* options,
+                Emitter* emitter);
 #endif // CODEGEN_H
\ No newline at end of file
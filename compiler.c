@@ -0,0 +1,328 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+#include "compiler.h"
+#include "lexer.h"
+#include "parser.h"
+#include "codegen.h"
+#include "scan.h"
+#include "elf.h"
+#include "jit.h"
+
+// Phase timing is skipped entirely when no report was asked for
+static void phase_begin(Compiler* compiler) {
+    if (compiler->stats) stats_phase_begin(compiler->stats);
+}
+
+static void phase_end(Compiler* compiler, CompilePhase phase) {
+    if (compiler->stats) stats_phase_end(compiler->stats, phase);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// --lex-only: drain the lexer (or fill a token array, with --prelex) and
+// report throughput, nothing else runs. An unknown character still fails.
+static int run_lexer_only(Compiler* compiler, const char* input_path) {
+    const SourceBuffer* source = &compiler->source;
+    size_t tokens = 0;
+    int failed;
+    double start = now_seconds();
+    if (compiler->options->prelex) {
+        TokenArray array;
+        failed = lex_tokens(&array, source->data, source->length, &compiler->names, compiler->options->prelex) != 0;
+        tokens = array.count - 1; // EOF is not counted
+        token_array_free(&array);
+    } else {
+        Lexer lexer;
+        lexer_init(&lexer, source->data, &compiler->names);
+        while (getNextToken(&lexer).type != TOKEN_EOF) {
+            tokens++;
+        }
+        failed = lexer.failed;
+    }
+    double elapsed = now_seconds() - start;
+    printf("--- Lexed %zu tokens from %zu bytes of %s in %.3f ms (%.1f MB/s, %s scanner) ---\n",
+           tokens, source->length, input_path, elapsed * 1e3,
+           elapsed > 0 ? source->length / elapsed / (1024.0 * 1024.0) : 0.0, scan_isa_name());
+    return failed;
+}
+
+// Phase 5: write the buffer out in one go
+static int write_output(const char* output_path, const char* data, size_t length) {
+    int to_stdout = strcmp(output_path, "-") == 0;
+    int status = 0;
+    int fd = to_stdout ? STDOUT_FILENO : open(output_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open output file '%s'.\n", output_path);
+        return 1;
+    }
+    if (write_fully(fd, data, length) != 0) {
+        fprintf(stderr, "Error: Could not write output to '%s'.\n", output_path);
+        status = 1;
+    }
+    if (!to_stdout) {
+        close(fd);
+        if (status != 0) unlink(output_path); // no truncated output left behind
+    }
+    return status;
+}
+
+static const char* output_extension(const CompileOptions* options) {
+    return options->object ? ".o" : options->emit_ir ? ".ir" : ".s";
+}
+
+// Phase 5: assembly text goes out as it is, objects are laid out first.
+// The bytes are also kept in the cache when there is one.
+static int write_assembly(Compiler* compiler, const char* output_path) {
+    const CompileOptions* options = compiler->options;
+    size_t length = compiler->assembly.length;
+    char* object = options->object ? elf_build_object(&compiler->assembly, &length) : NULL;
+    const char* data = object ? object : compiler->assembly.data;
+    int status = write_output(output_path, data, length);
+    if (status == 0 && compiler->cache_key) {
+        cache_store(options->cache, compiler->cache_key, output_extension(options), data, length);
+    }
+    free(object);
+    return status;
+}
+
+// Everything the output depends on besides the source bytes
+static void cache_key_for(const Compiler* compiler, CacheKey* key) {
+    const CompileOptions* options = compiler->options;
+    const char* exports = options->optimize.exports ? options->optimize.exports : "";
+    size_t salt_size = 192 + strlen(exports);
+    char* salt = (char*)malloc(salt_size);
+    if (!salt) {
+        fprintf(stderr, "Memory allocation failed for the cache key.\n");
+        exit(1);
+    }
+    snprintf(salt, salt_size, "razancompiler %s fold=%d peephole=%d reduce=%d inline=%d/%d dce=%d tail=%d format=%s exports=%s",
+             COMPILER_VERSION, options->optimize.fold_constants, options->optimize.peephole,
+             options->optimize.strength_reduce, options->optimize.inline_limit, options->optimize.inline_growth,
+             options->optimize.eliminate_dead_code, options->optimize.tail_calls, options->object ? "elf64" : options->emit_ir ? "ir" : "asm", exports);
+    cache_key(key, salt, compiler->source.data, compiler->source.length);
+    free(salt);
+}
+
+// Serves the output from the cache if it is there. Returns 1 on a hit.
+static int serve_from_cache(Compiler* compiler, const CacheKey* key, const char* output_path, int* status) {
+    const CompileOptions* options = compiler->options;
+    size_t length;
+    char* data = cache_lookup(options->cache, key, output_extension(options), &length);
+    if (!data) return 0;
+    phase_begin(compiler);
+    *status = write_output(output_path, data, length);
+    phase_end(compiler, PHASE_WRITE);
+    free(data);
+    if (compiler->stats) {
+        compiler->stats->source_bytes = compiler->source.length;
+        compiler->stats->assembly_bytes = length;
+        compiler->stats->cache = CACHE_HIT;
+    }
+    if (*status == 0 && options->log) {
+        fprintf(options->log, "--- Source: %zu bytes, unchanged: %s served from cache ---\n",
+                compiler->source.length, strcmp(output_path, "-") == 0 ? "stdout" : output_path);
+    }
+    return 1;
+}
+
+static int run_pipeline(Compiler* compiler, const char* input_path, const char* output_path) {
+    const CompileOptions* options = compiler->options;
+    FILE* log = options->log;
+    if (options->lex_only) {
+        return run_lexer_only(compiler, input_path);
+    }
+    if (log) fprintf(log, "--- Source: %zu bytes (%s) ---\n", compiler->source.length,
+                     compiler->source.is_mapped ? "mapped" : "buffered");
+
+    // Phase 1: Lexical Analysis. Errors from here on are reported where they
+    // are found and fail this file only; nothing is written for it.
+    Lexer lexer;
+    TokenArray tokens;
+    size_t token_count;
+    if (options->prelex) {
+        phase_begin(compiler);
+        int failed = lex_tokens(&tokens, compiler->source.data, compiler->source.length, &compiler->names,
+                                options->prelex) != 0;
+        phase_end(compiler, PHASE_LEX);
+        if (failed) {
+            token_array_free(&tokens);
+            return 1;
+        }
+        if (log) fprintf(log, "--- Lexing Complete: %zu tokens ---\n", tokens.count);
+    } else {
+        if (compiler->stats) {
+            // The parser pulls tokens on demand, so lexing is only timed on its own
+            // in a separate pass when a report is wanted
+            phase_begin(compiler);
+            lexer_init(&lexer, compiler->source.data, &compiler->names);
+            while (getNextToken(&lexer).type != TOKEN_EOF) {}
+            phase_end(compiler, PHASE_LEX);
+            if (lexer.failed) return 1;
+        }
+        lexer_init(&lexer, compiler->source.data, &compiler->names);
+        if (log) fprintf(log, "--- Lexing Initialized ---\n");
+    }
+
+    // Phase 2 & 3: Syntax Analysis and AST Construction
+    // The parser calls getNextToken internally, or walks the pre-lexed tokens.
+    Parser parser;
+    phase_begin(compiler);
+    if (options->prelex) {
+        parser_init_tokens(&parser, &tokens, &compiler->ast);
+    } else {
+        parser_init(&parser, &lexer, &compiler->ast);
+    }
+    NodeId program_ast = parse_program(&parser);
+    phase_end(compiler, PHASE_PARSE);
+    if (options->prelex) {
+        token_count = tokens.count;
+        token_array_free(&tokens); // the tree keeps no references into it
+    } else {
+        token_count = lexer.token_count;
+    }
+    if (parser.failed) return 1;
+    if (log) {
+        fprintf(log, "--- Parsing and AST Construction Complete ---\n");
+        fprintf(log, "--- AST: %u nodes, %u child links, %zu bytes reserved ---\n",
+                compiler->ast.node_count, compiler->ast.extra_count, ast_bytes(&compiler->ast));
+        fprintf(log, "--- Generated AST ---\n");
+        ast_print(log, &compiler->ast, &compiler->names, program_ast, 0); // Print AST for verification
+    }
+
+    // Optimization passes over the AST (-O0 turns them off)
+    phase_begin(compiler);
+    OptimizeReport optimized;
+    int failed = optimize_program(&compiler->ast, program_ast, &compiler->names, &options->optimize, &optimized) != 0;
+    phase_end(compiler, PHASE_OPTIMIZE);
+    if (failed) return 1;
+    if (log) fprintf(log, "--- Optimization: %zu simplifications, %zu calls inlined, %zu dead functions removed ---\n",
+                     optimized.simplifications, optimized.inlined_calls, optimized.removed_functions);
+
+    // Phase 4: Code Generation into an in-memory buffer
+    int machine_code = options->object || options->run;
+    const char* output_kind = machine_code ? "Machine Code" : options->emit_ir ? "IR" : "Assembly Code";
+    if (log) fprintf(log, "--- Generating %s ---\n", output_kind);
+    phase_begin(compiler);
+    if (options->emit_ir) {
+        failed = generate_ir(&compiler->ast, program_ast, &compiler->names, &options->optimize, &compiler->assembly) != 0;
+    } else {
+        failed = generate_code(&compiler->ast, program_ast, &compiler->names, &options->optimize, &compiler->assembly) != 0;
+    }
+    phase_end(compiler, PHASE_CODEGEN);
+    if (failed) return 1;
+
+    int status;
+    if (options->run) {
+        // Phase 5 with --run: no file at all, main runs right here
+        phase_begin(compiler);
+        status = jit_run(&compiler->assembly, &compiler->run_result) == 0 ? 0 : 1;
+        phase_end(compiler, PHASE_RUN);
+        if (status == 0 && log) fprintf(log, "--- main returned %d ---\n", compiler->run_result);
+    } else {
+        phase_begin(compiler);
+        status = write_assembly(compiler, output_path);
+        phase_end(compiler, PHASE_WRITE);
+    }
+
+    if (compiler->stats) {
+        CompileStats* stats = compiler->stats;
+        stats->source_bytes = compiler->source.length;
+        stats->tokens = token_count;
+        stats->prelexed = options->prelex != 0;
+        memcpy(stats->nodes_by_type, compiler->ast.nodes_by_type, sizeof(stats->nodes_by_type));
+        stats->ast_grows = compiler->ast.grow_count;
+        stats->ast_bytes = ast_bytes(&compiler->ast);
+        stats->symbols = compiler->names.symbol_count;
+        stats->simplifications = optimized.simplifications;
+        stats->inlined_calls = optimized.inlined_calls;
+        stats->inline_growth = optimized.inline_growth;
+        stats->removed_functions = optimized.removed_functions;
+        stats->removed_statements = optimized.removed_statements;
+        stats->instructions = compiler->assembly.instruction_count;
+        memcpy(stats->peephole_hits, compiler->assembly.peephole_hits, sizeof(stats->peephole_hits));
+        stats->assembly_bytes = compiler->assembly.length;
+    }
+    if (status == 0 && log && !options->run) {
+        fprintf(log, "--- %s Generated to %s ---\n", options->object ? "Object File" : output_kind,
+                strcmp(output_path, "-") == 0 ? "stdout" : output_path);
+    }
+    return status;
+}
+
+static int compile_unit(const char* input_path, const char* output_path, const CompileOptions* options,
+                        int* run_result) {
+    Compiler compiler;
+    CompileStats stats;
+    compiler.options = options;
+    compiler.stats = NULL;
+    compiler.run_result = 0;
+    compiler.cache_key = NULL;
+    if (options->stats != STATS_OFF && !options->lex_only) {
+        stats_init(&stats);
+        compiler.stats = &stats;
+    }
+
+    // Read source code: regular files are mapped, "-" and pipes are streamed
+    phase_begin(&compiler);
+    if (source_open(input_path, &compiler.source) != 0) {
+        return 1;
+    }
+    phase_end(&compiler, PHASE_READ);
+
+    // Unchanged inputs skip lexing, parsing and codegen entirely
+    CacheKey key;
+    if (options->cache && !options->run && !options->lex_only) {
+        int status;
+        cache_key_for(&compiler, &key);
+        if (serve_from_cache(&compiler, &key, output_path, &status)) {
+            if (status == 0 && compiler.stats) stats_print(compiler.stats, input_path, options->stats, stderr);
+            source_close(&compiler.source);
+            return status;
+        }
+        compiler.cache_key = &key;
+        if (compiler.stats) compiler.stats->cache = CACHE_MISS;
+    }
+
+    // Every AST node and child list of this translation unit lives in compiler.ast
+    interner_init(&compiler.names);
+    ast_init(&compiler.ast);
+    if (options->object || options->run) {
+        emitter_init_machine_code(&compiler.assembly);
+    } else {
+        emitter_init(&compiler.assembly);
+    }
+    compiler.assembly.peephole = options->optimize.peephole;
+
+    int status = run_pipeline(&compiler, input_path, output_path);
+    *run_result = compiler.run_result;
+    if (status == 0 && compiler.stats) {
+        stats_print(compiler.stats, input_path, options->stats, stderr);
+    }
+
+    // Clean up AST and source code memory (the whole tree is a handful of arrays).
+    // Interned names point into the source buffer, so the table goes before it.
+    emitter_free(&compiler.assembly);
+    ast_release(&compiler.ast);
+    interner_free(&compiler.names);
+    source_close(&compiler.source);
+    return status;
+}
+
+int compile_file(const char* input_path, const char* output_path, const CompileOptions* options) {
+    int run_result;
+    return compile_unit(input_path, output_path, options, &run_result);
+}
+
+int run_file(const char* input_path, const CompileOptions* options, int* result) {
+    CompileOptions run_options = *options;
+    run_options.run = 1;
+    return compile_unit(input_path, NULL, &run_options, result);
+}
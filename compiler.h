@@ -0,0 +1,53 @@
+#ifndef COMPILER_H
+#define COMPILER_H
+
+#include <stdio.h>
+#include "source.h"
+#include "intern.h"
+#include "ast.h"
+#include "emit.h"
+#include "optimize.h"
+#include "stats.h"
+#include "cache.h"
+
+// Part of every cache key: bump it whenever generated code changes
+#define COMPILER_VERSION "0.26"
+
+// Settings shared by every file of one run; read-only while compiling
+typedef struct CompileOptions {
+    OptimizeOptions optimize;
+    int lex_only; // drain the lexer and report throughput, nothing else runs
+    int prelex;   // lex the whole file before parsing on up to this many threads; 0: the parser pulls tokens
+    int object;   // write an ELF object file directly instead of assembly text
+    int run;      // execute main in-process (JIT) instead of writing any output
+    int emit_ir;  // write the IR codegen works from (see ir.h) as text instead of assembly
+    FILE* log;    // progress banners and the AST dump, NULL to stay quiet
+    StatsFormat stats; // per-file time report on stderr, STATS_OFF for none
+    Cache* cache;      // serve and store outputs here, NULL for no caching
+} CompileOptions;
+
+// Everything one translation unit owns. Nothing in the pipeline keeps global
+// state, so any number of these can be compiled at the same time.
+typedef struct Compiler {
+    const CompileOptions* options;
+    SourceBuffer source;
+    Interner names;
+    AST ast;
+    Emitter assembly;
+    CompileStats* stats; // NULL unless options->stats asks for a report
+    int run_result;      // what main returned, with options->run
+    const CacheKey* cache_key; // where the output is stored on a cache miss, or NULL
+} Compiler;
+
+// Compiles input_path into output_path ("-" for stdout): assembly, an object
+// file when options->object is set, or the IR with options->emit_ir.
+// Returns 0 on success, 1 after printing a diagnostic, syntax and semantic
+// errors included; nothing is written for a file that fails, and other files
+// compiling at the same time are not affected.
+int compile_file(const char* input_path, const char* output_path, const CompileOptions* options);
+
+// Compiles input_path to machine code in memory and runs its main (the
+// options->run path of compile_file). Returns 0 with main's result in *result.
+int run_file(const char* input_path, const CompileOptions* options, int* result);
+
+#endif
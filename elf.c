@@ -0,0 +1,195 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "elf.h"
+
+// The ELF64 structures we need, spelled out rather than taken from <elf.h>
+// so the writer builds on hosts without it. Fields are stored in host byte
+// order, which is little-endian on every x86-64 host.
+typedef struct {
+    uint8_t ident[16];
+    uint16_t type, machine;
+    uint32_t version;
+    uint64_t entry, phoff, shoff;
+    uint32_t flags;
+    uint16_t ehsize, phentsize, phnum, shentsize, shnum, shstrndx;
+} ElfHeader;
+
+typedef struct {
+    uint32_t name, type;
+    uint64_t flags, addr, offset, size;
+    uint32_t link, info;
+    uint64_t addralign, entsize;
+} ElfSection;
+
+typedef struct {
+    uint32_t name;
+    uint8_t info, other;
+    uint16_t shndx;
+    uint64_t value, size;
+} ElfSymbol;
+
+typedef struct {
+    uint64_t offset, info;
+    int64_t addend;
+} ElfRela;
+
+#define ET_REL 1
+#define EM_X86_64 62
+#define SHT_PROGBITS 1
+#define SHT_SYMTAB 2
+#define SHT_STRTAB 3
+#define SHT_RELA 4
+#define SHF_ALLOC 0x2
+#define SHF_EXECINSTR 0x4
+#define SHF_INFO_LINK 0x40
+#define STB_LOCAL 0
+#define STB_GLOBAL 1
+#define STT_NOTYPE 0
+#define R_X86_64_PLT32 4
+
+enum { SEC_NULL, SEC_TEXT, SEC_RELA_TEXT, SEC_SYMTAB, SEC_STRTAB, SEC_SHSTRTAB, SEC_NOTE_STACK, SEC_COUNT };
+
+// Section names, each preceded by the NUL that index 0 of .shstrtab needs
+static const char shstrtab[] = "\0.text\0.rela.text\0.symtab\0.strtab\0.shstrtab\0.note.GNU-stack";
+#define SHSTR_TEXT 1
+#define SHSTR_RELA_TEXT 7
+#define SHSTR_SYMTAB 18
+#define SHSTR_STRTAB 26
+#define SHSTR_SHSTRTAB 34
+#define SHSTR_NOTE_STACK 44
+
+static size_t align_up(size_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+char* elf_build_object(const Emitter* code, size_t* size) {
+    const Interner* names = &code->symbol_names;
+    uint32_t symbol_count = names->symbol_count; // emitter ids 1..symbol_count
+
+    // ELF symbol order: the null symbol, then locals, then globals (the
+    // linker requires locals first and .symtab's info to point past them)
+    uint32_t* elf_index = (uint32_t*)calloc(symbol_count + 1, sizeof(uint32_t));
+    ElfSymbol* symbols = (ElfSymbol*)calloc(symbol_count + 1, sizeof(ElfSymbol));
+    size_t strtab_size = 1;
+    for (SymbolId id = 1; id <= symbol_count; ++id) {
+        if (!code->symbols[id].local) strtab_size += symbol_length(names, id) + 1;
+    }
+    char* strtab = (char*)calloc(strtab_size, 1);
+    ElfRela* relas = (ElfRela*)calloc(code->relocation_count ? code->relocation_count : 1, sizeof(ElfRela));
+    if (!elf_index || !symbols || !strtab || !relas) {
+        fprintf(stderr, "Memory allocation failed for object file.\n");
+        exit(1);
+    }
+
+    uint32_t next = 1, first_global = 1;
+    size_t strtab_used = 1;
+    for (int pass = 0; pass < 2; ++pass) {
+        if (pass == 1) first_global = next;
+        for (SymbolId id = 1; id <= symbol_count; ++id) {
+            const CodeSymbol* symbol = &code->symbols[id];
+            int global = symbol->global || !symbol->defined; // undefined call targets are external
+            if (global != pass || symbol->local) continue;
+            ElfSymbol* out = &symbols[next];
+            size_t length = symbol_length(names, id);
+            memcpy(strtab + strtab_used, symbol_text(names, id), length);
+            out->name = (uint32_t)strtab_used;
+            strtab_used += length + 1;
+            out->info = (uint8_t)(((global ? STB_GLOBAL : STB_LOCAL) << 4) | STT_NOTYPE);
+            out->shndx = symbol->defined ? SEC_TEXT : 0;
+            out->value = symbol->defined ? symbol->offset : 0;
+            elf_index[id] = next++;
+        }
+    }
+
+    // call rel32: target - (field + 4). Jumps to symbols defined here are
+    // patched into the text below instead.
+    size_t rela_count = 0;
+    for (size_t i = 0; i < code->relocation_count; ++i) {
+        const CodeRelocation* reloc = &code->relocations[i];
+        if (reloc->jump && code->symbols[reloc->symbol].defined) continue;
+        relas[rela_count].offset = reloc->offset;
+        relas[rela_count].info = ((uint64_t)elf_index[reloc->symbol] << 32) | R_X86_64_PLT32;
+        relas[rela_count].addend = -4;
+        rela_count++;
+    }
+
+    ElfSection sections[SEC_COUNT];
+    memset(sections, 0, sizeof(sections));
+    size_t offset = align_up(sizeof(ElfHeader), 16);
+
+    sections[SEC_TEXT] = (ElfSection){SHSTR_TEXT, SHT_PROGBITS, SHF_ALLOC | SHF_EXECINSTR, 0,
+                                      offset, code->length, 0, 0, 16, 0};
+    offset = align_up(offset + code->length, 8);
+    sections[SEC_RELA_TEXT] = (ElfSection){SHSTR_RELA_TEXT, SHT_RELA, SHF_INFO_LINK, 0,
+                                           offset, rela_count * sizeof(ElfRela),
+                                           SEC_SYMTAB, SEC_TEXT, 8, sizeof(ElfRela)};
+    offset += sections[SEC_RELA_TEXT].size;
+    sections[SEC_SYMTAB] = (ElfSection){SHSTR_SYMTAB, SHT_SYMTAB, 0, 0,
+                                        offset, next * sizeof(ElfSymbol),
+                                        SEC_STRTAB, first_global, 8, sizeof(ElfSymbol)};
+    offset += sections[SEC_SYMTAB].size;
+    sections[SEC_STRTAB] = (ElfSection){SHSTR_STRTAB, SHT_STRTAB, 0, 0, offset, strtab_size, 0, 0, 1, 0};
+    offset += strtab_size;
+    sections[SEC_SHSTRTAB] = (ElfSection){SHSTR_SHSTRTAB, SHT_STRTAB, 0, 0, offset, sizeof(shstrtab), 0, 0, 1, 0};
+    offset += sizeof(shstrtab);
+    // Empty, non-executable: tells the linker this code needs no executable stack
+    sections[SEC_NOTE_STACK] = (ElfSection){SHSTR_NOTE_STACK, SHT_PROGBITS, 0, 0, offset, 0, 0, 0, 1, 0};
+    offset = align_up(offset, 8);
+
+    ElfHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.ident, "\177ELF", 4);
+    header.ident[4] = 2; // ELFCLASS64
+    header.ident[5] = 1; // ELFDATA2LSB
+    header.ident[6] = 1; // EV_CURRENT
+    header.type = ET_REL;
+    header.machine = EM_X86_64;
+    header.version = 1;
+    header.shoff = offset;
+    header.ehsize = sizeof(ElfHeader);
+    header.shentsize = sizeof(ElfSection);
+    header.shnum = SEC_COUNT;
+    header.shstrndx = SEC_SHSTRTAB;
+
+    // Lay the whole file out in memory and write it in one go
+    size_t file_size = offset + sizeof(sections);
+    char* file = (char*)calloc(file_size, 1);
+    if (!file) {
+        fprintf(stderr, "Memory allocation failed for object file.\n");
+        exit(1);
+    }
+    memcpy(file, &header, sizeof(header));
+    if (code->length) memcpy(file + sections[SEC_TEXT].offset, code->data, code->length);
+    for (size_t i = 0; i < code->relocation_count; ++i) {
+        const CodeRelocation* reloc = &code->relocations[i];
+        const CodeSymbol* target = &code->symbols[reloc->symbol];
+        if (!reloc->jump || !target->defined) continue;
+        int32_t displacement = (int32_t)((long long)target->offset - ((long long)reloc->offset + 4));
+        memcpy(file + sections[SEC_TEXT].offset + reloc->offset, &displacement, sizeof(displacement));
+    }
+    memcpy(file + sections[SEC_RELA_TEXT].offset, relas, sections[SEC_RELA_TEXT].size);
+    memcpy(file + sections[SEC_SYMTAB].offset, symbols, sections[SEC_SYMTAB].size);
+    memcpy(file + sections[SEC_STRTAB].offset, strtab, strtab_size);
+    memcpy(file + sections[SEC_SHSTRTAB].offset, shstrtab, sizeof(shstrtab));
+    memcpy(file + header.shoff, sections, sizeof(sections));
+
+    free(relas);
+    free(strtab);
+    free(symbols);
+    free(elf_index);
+    *size = file_size;
+    return file;
+}
+
+int elf_write_object(const Emitter* code, int fd, const char* path) {
+    size_t size;
+    char* file = elf_build_object(code, &size);
+    int status = write_fully(fd, file, size);
+    if (status != 0) {
+        fprintf(stderr, "Error: Could not write object file '%s': %s\n", path, strerror(errno));
+    }
+    free(file);
+    return status;
+}
@@ -0,0 +1,15 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include "emit.h"
+
+// Writes the machine code of a EMIT_MACHINE_CODE emitter as a relocatable
+// x86-64 ELF object (.text, .rela.text, .symtab, .strtab), ready for the
+// linker without going through as. Calls become R_X86_64_PLT32 relocations.
+// Returns 0, or -1 after printing a diagnostic.
+int elf_write_object(const Emitter* code, int fd, const char* path);
+
+// The same object file as a malloc'ed buffer of *size bytes
+char* elf_build_object(const Emitter* code, size_t* size);
+
+#endif
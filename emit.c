@@ -0,0 +1,513 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <unistd.h>
+#include "emit.h"
+#include "encode.h"
+#include "peephole.h"
+
+#define EMITTER_INITIAL_CAPACITY (256 * 1024)
+
+static const char* const reg_names[REG_COUNT] = {
+    "rax", "rcx", "rdx", "rbx", "rsp", "rbp", "rsi", "rdi",
+    "r8", "r9", "r10", "r11", "r12", "r13", "r14", "r15",
+};
+
+static const char* const reg_names32[REG_COUNT] = {
+    "eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi",
+    "r8d", "r9d", "r10d", "r11d", "r12d", "r13d", "r14d", "r15d",
+};
+
+static const char* const opcode_names[OP_COUNT] = {
+    "mov", "add", "sub", "imul", "idiv", "push", "pop", "call", "ret",
+    "shl", "sar", "shr", "neg", "cqo", "movsxd", "lea", "jmp",
+};
+
+const char* reg_name(Reg reg) {
+    return reg_names[reg];
+}
+
+const char* reg_name32(Reg reg) {
+    return reg_names32[reg];
+}
+
+const char* opcode_name(Opcode op) {
+    return opcode_names[op];
+}
+
+void emitter_init(Emitter* emitter) {
+    emitter->format = EMIT_ASSEMBLY;
+    emitter->data = NULL;
+    emitter->length = 0;
+    emitter->capacity = 0;
+    emitter->instruction_count = 0;
+    emitter->code = NULL;
+    emitter->code_count = 0;
+    emitter->code_capacity = 0;
+    emitter->peephole = 0;
+    memset(emitter->peephole_hits, 0, sizeof(emitter->peephole_hits));
+    interner_init(&emitter->symbol_names);
+    emitter->symbols = NULL;
+    emitter->symbol_capacity = 0;
+    emitter->relocations = NULL;
+    emitter->relocation_count = 0;
+    emitter->relocation_capacity = 0;
+}
+
+void emitter_init_machine_code(Emitter* emitter) {
+    emitter_init(emitter);
+    emitter->format = EMIT_MACHINE_CODE;
+}
+
+void emitter_free(Emitter* emitter) {
+    free(emitter->data);
+    free(emitter->code);
+    interner_free(&emitter->symbol_names);
+    free(emitter->symbols);
+    free(emitter->relocations);
+    emitter_init(emitter);
+}
+
+// Makes room for `extra` more bytes plus a terminating NUL
+static void emitter_reserve(Emitter* emitter, size_t extra) {
+    size_t needed = emitter->length + extra + 1;
+    if (needed <= emitter->capacity) return;
+    size_t capacity = emitter->capacity ? emitter->capacity : EMITTER_INITIAL_CAPACITY;
+    while (capacity < needed) capacity *= 2;
+    char* data = (char*)realloc(emitter->data, capacity);
+    if (!data) {
+        fprintf(stderr, "Memory reallocation failed for assembly buffer.\n");
+        exit(1);
+    }
+    emitter->data = data;
+    emitter->capacity = capacity;
+}
+
+void emit_fmt(Emitter* emitter, const char* fmt, ...) {
+    emit_flush(emitter);
+    if (emitter->format != EMIT_ASSEMBLY) return;
+    va_list args;
+    emitter_reserve(emitter, 128);
+    va_start(args, fmt);
+    int n = vsnprintf(emitter->data + emitter->length, emitter->capacity - emitter->length, fmt, args);
+    va_end(args);
+    if (n < 0) {
+        fprintf(stderr, "Code Generation Error: Could not format assembly.\n");
+        exit(1);
+    }
+    if ((size_t)n >= emitter->capacity - emitter->length) { // did not fit, format again
+        emitter_reserve(emitter, (size_t)n);
+        va_start(args, fmt);
+        vsnprintf(emitter->data + emitter->length, emitter->capacity - emitter->length, fmt, args);
+        va_end(args);
+    }
+    emitter->length += (size_t)n;
+}
+
+void emit_text(Emitter* emitter, const char* text, size_t length) {
+    emit_flush(emitter);
+    if (emitter->format != EMIT_ASSEMBLY) return;
+    emitter_reserve(emitter, length);
+    memcpy(emitter->data + emitter->length, text, length);
+    emitter->length += length;
+}
+
+// The put_* helpers assume emitter_reserve was called for the whole line
+static inline void put_str(Emitter* emitter, const char* str) {
+    while (*str) emitter->data[emitter->length++] = *str++;
+}
+
+static inline void put_imm(Emitter* emitter, long long imm) {
+    char digits[24];
+    int n = 0;
+    unsigned long long magnitude = imm < 0 ? 0ULL - (unsigned long long)imm : (unsigned long long)imm;
+    if (imm < 0) emitter->data[emitter->length++] = '-';
+    do {
+        digits[n++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude);
+    while (n) emitter->data[emitter->length++] = digits[--n];
+}
+
+// Machine code mode: makes sure symbol `id` has an entry
+static void reserve_symbol(Emitter* emitter, SymbolId id) {
+    if (id >= emitter->symbol_capacity) {
+        uint32_t capacity = emitter->symbol_capacity ? emitter->symbol_capacity * 2 : 64;
+        while (capacity <= id) capacity *= 2;
+        CodeSymbol* symbols = (CodeSymbol*)realloc(emitter->symbols, capacity * sizeof(CodeSymbol));
+        if (!symbols) {
+            fprintf(stderr, "Memory reallocation failed for code symbols.\n");
+            exit(1);
+        }
+        memset(symbols + emitter->symbol_capacity, 0, (capacity - emitter->symbol_capacity) * sizeof(CodeSymbol));
+        emitter->symbols = symbols;
+        emitter->symbol_capacity = capacity;
+    }
+}
+
+// Machine code mode: the symbol entry for a name, created on first use
+static SymbolId code_symbol(Emitter* emitter, const char* name, size_t length) {
+    SymbolId id = intern(&emitter->symbol_names, name, length);
+    reserve_symbol(emitter, id);
+    return id;
+}
+
+static void add_relocation(Emitter* emitter, uint32_t offset, SymbolId symbol, int jump) {
+    if (emitter->relocation_count == emitter->relocation_capacity) {
+        size_t capacity = emitter->relocation_capacity ? emitter->relocation_capacity * 2 : 64;
+        CodeRelocation* relocations = (CodeRelocation*)realloc(emitter->relocations, capacity * sizeof(CodeRelocation));
+        if (!relocations) {
+            fprintf(stderr, "Memory reallocation failed for relocations.\n");
+            exit(1);
+        }
+        emitter->relocations = relocations;
+        emitter->relocation_capacity = capacity;
+    }
+    emitter->relocations[emitter->relocation_count].offset = offset;
+    emitter->relocations[emitter->relocation_count].symbol = symbol;
+    emitter->relocations[emitter->relocation_count].jump = (uint8_t)jump;
+    emitter->relocation_count++;
+}
+
+static inline uint8_t* code_space(Emitter* emitter) {
+    emitter_reserve(emitter, ENCODE_MAX_BYTES);
+    return (uint8_t*)emitter->data + emitter->length;
+}
+
+// The write_* functions put one instruction into the output buffer, in the
+// emitter's format, when the IR is flushed.
+
+// Longest line a write_* can produce: "  " op " " reg ", " -9223372036854775808 "\n"
+#define EMIT_MAX_LINE 64
+
+static void write_op(Emitter* emitter, Opcode op) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        emitter->length += encode_op(code_space(emitter), op);
+        return;
+    }
+    emitter_reserve(emitter, EMIT_MAX_LINE);
+    put_str(emitter, "  ");
+    put_str(emitter, opcode_names[op]);
+    emitter->data[emitter->length++] = '\n';
+}
+
+static void write_reg(Emitter* emitter, Opcode op, Reg reg, int dword) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        emitter->length += encode_reg(code_space(emitter), op, reg, dword);
+        return;
+    }
+    const char* const* names = dword ? reg_names32 : reg_names;
+    emitter_reserve(emitter, EMIT_MAX_LINE);
+    put_str(emitter, "  ");
+    put_str(emitter, opcode_names[op]);
+    emitter->data[emitter->length++] = ' ';
+    put_str(emitter, names[reg]);
+    emitter->data[emitter->length++] = '\n';
+}
+
+static void write_reg_reg(Emitter* emitter, Opcode op, Reg dst, Reg src, int dword) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        emitter->length += encode_reg_reg(code_space(emitter), op, dst, src, dword);
+        return;
+    }
+    const char* const* names = dword ? reg_names32 : reg_names;
+    emitter_reserve(emitter, EMIT_MAX_LINE);
+    put_str(emitter, "  ");
+    put_str(emitter, opcode_names[op]);
+    emitter->data[emitter->length++] = ' ';
+    put_str(emitter, names[dst]);
+    put_str(emitter, ", ");
+    put_str(emitter, op == OP_MOVSXD ? reg_names32[src] : names[src]);
+    emitter->data[emitter->length++] = '\n';
+}
+
+static void write_reg_imm(Emitter* emitter, Opcode op, Reg dst, long long imm, int dword) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        emitter->length += encode_reg_imm(code_space(emitter), op, dst, imm, dword);
+        return;
+    }
+    emitter_reserve(emitter, EMIT_MAX_LINE);
+    put_str(emitter, "  ");
+    put_str(emitter, opcode_names[op]);
+    emitter->data[emitter->length++] = ' ';
+    put_str(emitter, dword ? reg_names32[dst] : reg_names[dst]);
+    put_str(emitter, ", ");
+    put_imm(emitter, imm);
+    emitter->data[emitter->length++] = '\n';
+}
+
+static void write_lea(Emitter* emitter, Reg dst, Reg src, int scale) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        emitter->length += encode_lea(code_space(emitter), dst, src, scale);
+        return;
+    }
+    emitter_reserve(emitter, EMIT_MAX_LINE);
+    put_str(emitter, "  lea ");
+    put_str(emitter, reg_names[dst]);
+    put_str(emitter, ", [");
+    put_str(emitter, reg_names[src]);
+    emitter->data[emitter->length++] = '+';
+    put_str(emitter, reg_names[src]);
+    emitter->data[emitter->length++] = '*';
+    emitter->data[emitter->length++] = (char)('0' + scale);
+    put_str(emitter, "]\n");
+}
+
+// mov reg, QWORD PTR [base+disp], or the other way round for a store
+static void write_memory(Emitter* emitter, int store, Reg reg, Reg base, int disp) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        uint8_t* out = code_space(emitter);
+        emitter->length += store ? encode_store(out, base, disp, reg) : encode_load(out, reg, base, disp);
+        return;
+    }
+    emitter_reserve(emitter, EMIT_MAX_LINE);
+    put_str(emitter, "  mov ");
+    if (!store) {
+        put_str(emitter, reg_names[reg]);
+        put_str(emitter, ", ");
+    }
+    put_str(emitter, "QWORD PTR [");
+    put_str(emitter, reg_names[base]);
+    if (disp != 0) {
+        if (disp > 0) emitter->data[emitter->length++] = '+';
+        put_imm(emitter, disp);
+    }
+    emitter->data[emitter->length++] = ']';
+    if (store) {
+        put_str(emitter, ", ");
+        put_str(emitter, reg_names[reg]);
+    }
+    emitter->data[emitter->length++] = '\n';
+}
+
+static void write_call(Emitter* emitter, SymbolId target) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        reserve_symbol(emitter, target);
+        add_relocation(emitter, (uint32_t)(emitter->length + ENCODE_CALL_DISPLACEMENT), target, 0);
+        emitter->length += encode_call(code_space(emitter));
+        return;
+    }
+    const char* name = symbol_text(&emitter->symbol_names, target);
+    size_t length = symbol_length(&emitter->symbol_names, target);
+    emitter_reserve(emitter, length + 8);
+    put_str(emitter, "  call ");
+    memcpy(emitter->data + emitter->length, name, length);
+    emitter->length += length;
+    emitter->data[emitter->length++] = '\n';
+}
+
+// Always the rel32 form, spelled {disp32} for as: the target may not be
+// defined yet, and choosing the short form would take a relaxation pass
+static void write_jump(Emitter* emitter, SymbolId target) {
+    emitter->instruction_count++;
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        reserve_symbol(emitter, target);
+        add_relocation(emitter, (uint32_t)(emitter->length + ENCODE_CALL_DISPLACEMENT), target, 1);
+        emitter->length += encode_jump(code_space(emitter));
+        return;
+    }
+    const char* name = symbol_text(&emitter->symbol_names, target);
+    size_t length = symbol_length(&emitter->symbol_names, target);
+    emitter_reserve(emitter, length + 18);
+    put_str(emitter, "  {disp32} jmp ");
+    memcpy(emitter->data + emitter->length, name, length);
+    emitter->length += length;
+    emitter->data[emitter->length++] = '\n';
+}
+
+// Appends an instruction to the IR, operands zeroed
+static Instr* record(Emitter* emitter, InstrShape shape, Opcode op) {
+    if (emitter->code_count == emitter->code_capacity) {
+        size_t capacity = emitter->code_capacity ? emitter->code_capacity * 2 : 256;
+        Instr* code = (Instr*)realloc(emitter->code, capacity * sizeof(Instr));
+        if (!code) {
+            fprintf(stderr, "Memory reallocation failed for instruction buffer.\n");
+            exit(1);
+        }
+        emitter->code = code;
+        emitter->code_capacity = capacity;
+    }
+    Instr* instr = &emitter->code[emitter->code_count++];
+    instr->shape = (uint8_t)shape;
+    instr->op = (uint8_t)op;
+    instr->dst = 0;
+    instr->src = 0;
+    instr->dword = 0;
+    instr->target = 0;
+    instr->imm = 0;
+    return instr;
+}
+
+void emit_op(Emitter* emitter, Opcode op) {
+    record(emitter, INSTR_OP, op);
+}
+
+void emit_reg(Emitter* emitter, Opcode op, Reg reg) {
+    record(emitter, INSTR_REG, op)->dst = (uint8_t)reg;
+}
+
+void emit_reg_reg(Emitter* emitter, Opcode op, Reg dst, Reg src) {
+    Instr* instr = record(emitter, INSTR_REG_REG, op);
+    instr->dst = (uint8_t)dst;
+    instr->src = (uint8_t)src;
+}
+
+void emit_reg_imm(Emitter* emitter, Opcode op, Reg dst, long long imm) {
+    Instr* instr = record(emitter, INSTR_REG_IMM, op);
+    instr->dst = (uint8_t)dst;
+    instr->imm = imm;
+}
+
+void emit_reg32(Emitter* emitter, Opcode op, Reg reg) {
+    Instr* instr = record(emitter, INSTR_REG, op);
+    instr->dst = (uint8_t)reg;
+    instr->dword = 1;
+}
+
+void emit_reg_reg32(Emitter* emitter, Opcode op, Reg dst, Reg src) {
+    Instr* instr = record(emitter, INSTR_REG_REG, op);
+    instr->dst = (uint8_t)dst;
+    instr->src = (uint8_t)src;
+    instr->dword = 1;
+}
+
+void emit_reg_imm32(Emitter* emitter, Opcode op, Reg dst, int imm) {
+    Instr* instr = record(emitter, INSTR_REG_IMM, op);
+    instr->dst = (uint8_t)dst;
+    instr->imm = imm;
+    instr->dword = 1;
+}
+
+void emit_lea(Emitter* emitter, Reg dst, Reg src, int scale) {
+    Instr* instr = record(emitter, INSTR_REG_REG, OP_LEA);
+    instr->dst = (uint8_t)dst;
+    instr->src = (uint8_t)src;
+    instr->imm = scale;
+}
+
+void emit_load(Emitter* emitter, Reg dst, Reg base, int disp) {
+    Instr* instr = record(emitter, INSTR_LOAD, OP_MOV);
+    instr->dst = (uint8_t)dst;
+    instr->src = (uint8_t)base;
+    instr->imm = disp;
+}
+
+void emit_store(Emitter* emitter, Reg base, int disp, Reg src) {
+    Instr* instr = record(emitter, INSTR_STORE, OP_MOV);
+    instr->dst = (uint8_t)base;
+    instr->src = (uint8_t)src;
+    instr->imm = disp;
+}
+
+// Call targets are interned in both formats, so an Instr stays fixed-size
+void emit_call(Emitter* emitter, const char* name, size_t length, int arg_registers) {
+    SymbolId target = intern(&emitter->symbol_names, name, length);
+    Instr* instr = record(emitter, INSTR_CALL, OP_CALL);
+    instr->src = (uint8_t)arg_registers;
+    instr->target = target;
+}
+
+void emit_jump(Emitter* emitter, const char* name, size_t length, int arg_registers) {
+    SymbolId target = intern(&emitter->symbol_names, name, length);
+    Instr* instr = record(emitter, INSTR_JUMP, OP_JMP);
+    instr->src = (uint8_t)arg_registers;
+    instr->target = target;
+}
+
+void emit_flush(Emitter* emitter) {
+    if (emitter->code_count == 0) return;
+    size_t count = emitter->code_count;
+    if (emitter->peephole) count = peephole_optimize(emitter->code, count, emitter->peephole_hits);
+    for (size_t i = 0; i < count; ++i) {
+        const Instr* instr = &emitter->code[i];
+        switch ((InstrShape)instr->shape) {
+            case INSTR_NOP: break;
+            case INSTR_OP: write_op(emitter, (Opcode)instr->op); break;
+            case INSTR_REG: write_reg(emitter, (Opcode)instr->op, (Reg)instr->dst, instr->dword); break;
+            case INSTR_REG_REG:
+                if (instr->op == OP_LEA) write_lea(emitter, (Reg)instr->dst, (Reg)instr->src, (int)instr->imm);
+                else write_reg_reg(emitter, (Opcode)instr->op, (Reg)instr->dst, (Reg)instr->src, instr->dword);
+                break;
+            case INSTR_REG_IMM:
+                write_reg_imm(emitter, (Opcode)instr->op, (Reg)instr->dst, instr->imm, instr->dword);
+                break;
+            case INSTR_CALL: write_call(emitter, instr->target); break;
+            case INSTR_JUMP: write_jump(emitter, instr->target); break;
+            case INSTR_LOAD: write_memory(emitter, 0, (Reg)instr->dst, (Reg)instr->src, (int)instr->imm); break;
+            case INSTR_STORE: write_memory(emitter, 1, (Reg)instr->src, (Reg)instr->dst, (int)instr->imm); break;
+        }
+    }
+    emitter->code_count = 0;
+}
+
+void emit_label(Emitter* emitter, const char* name, size_t length) {
+    emit_flush(emitter);
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        SymbolId id = code_symbol(emitter, name, length); // may move the symbols array
+        CodeSymbol* symbol = &emitter->symbols[id];
+        if (symbol->defined) {
+            fprintf(stderr, "Code Generation Error: Symbol '%.*s' is already defined.\n", (int)length, name);
+            exit(1);
+        }
+        symbol->defined = 1;
+        symbol->local = length > 2 && name[0] == '.' && name[1] == 'L';
+        symbol->offset = (uint32_t)emitter->length;
+        return;
+    }
+    emitter_reserve(emitter, length + 2);
+    memcpy(emitter->data + emitter->length, name, length);
+    emitter->length += length;
+    emitter->data[emitter->length++] = ':';
+    emitter->data[emitter->length++] = '\n';
+}
+
+void emit_global(Emitter* emitter, const char* name, size_t length) {
+    emit_flush(emitter);
+    if (emitter->format == EMIT_MACHINE_CODE) {
+        SymbolId id = code_symbol(emitter, name, length);
+        emitter->symbols[id].global = 1;
+        return;
+    }
+    emitter_reserve(emitter, length + 10);
+    put_str(emitter, ".global ");
+    memcpy(emitter->data + emitter->length, name, length);
+    emitter->length += length;
+    emitter->data[emitter->length++] = '\n';
+}
+
+int emitter_write(Emitter* emitter, int fd) {
+    emit_flush(emitter);
+    return write_fully(fd, emitter->data, emitter->length);
+}
+
+int write_fully(int fd, const char* data, size_t length) {
+    size_t written = 0;
+    while (written < length) {
+        ssize_t n = write(fd, data + written, length - written);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        written += (size_t)n;
+    }
+    return 0;
+}
+
+char* emitter_take(Emitter* emitter, size_t* length) {
+    emit_flush(emitter);
+    emitter_reserve(emitter, 0);
+    emitter->data[emitter->length] = '\0';
+    char* data = emitter->data;
+    if (length) *length = emitter->length;
+    emitter_init(emitter);
+    return data;
+}
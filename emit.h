@@ -0,0 +1,174 @@
+#ifndef EMIT_H
+#define EMIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+
+// x86-64 general purpose registers, in hardware encoding order
+typedef enum {
+    REG_RAX, REG_RCX, REG_RDX, REG_RBX, REG_RSP, REG_RBP, REG_RSI, REG_RDI,
+    REG_R8, REG_R9, REG_R10, REG_R11, REG_R12, REG_R13, REG_R14, REG_R15,
+    REG_COUNT
+} Reg;
+
+// Instructions the code generator produces
+typedef enum {
+    OP_MOV,
+    OP_ADD,
+    OP_SUB,
+    OP_IMUL,
+    OP_IDIV,
+    OP_PUSH,
+    OP_POP,
+    OP_CALL,
+    OP_RET,
+    OP_SHL,
+    OP_SAR,
+    OP_SHR,
+    OP_NEG,
+    OP_CQO,
+    OP_MOVSXD, // movsxd rax, ecx: sign-extends a 32-bit register
+    OP_LEA,
+    OP_JMP,
+    OP_COUNT
+} Opcode;
+
+// The emitter's instruction-level IR. The fast paths record instructions
+// here instead of writing them straight away; emit_flush runs the peephole
+// pass (peephole.c) over what was recorded and then writes it out, as text or
+// machine code. Everything that is not an instruction flushes first, so a
+// label never ends up in the middle of a window.
+typedef enum {
+    INSTR_NOP,     // deleted by the peephole pass, never written out
+    INSTR_OP,      // ret, cqo
+    INSTR_REG,     // push rax; imul rcx is the widening rdx:rax = rax * rcx
+    INSTR_REG_REG, // add rax, rbx; lea with imm as the scale
+    INSTR_REG_IMM, // mov rax, 5
+    INSTR_CALL,    // call f
+    INSTR_LOAD,    // mov dst, QWORD PTR [src+imm]
+    INSTR_STORE,   // mov QWORD PTR [dst+imm], src
+    INSTR_JUMP,    // jmp f: a tail call, or a loop back to a label
+} InstrShape;
+
+typedef struct Instr {
+    uint8_t shape; // InstrShape
+    uint8_t op;    // Opcode
+    uint8_t dst;   // Reg, also the operand of INSTR_REG
+    uint8_t src;   // Reg; for INSTR_CALL and INSTR_JUMP, how many argument registers it reads
+    uint8_t dword; // INSTR_REG, INSTR_REG_REG, INSTR_REG_IMM: 32-bit operands (eax, r8d)
+    SymbolId target; // INSTR_CALL and INSTR_JUMP: target in the emitter's symbol_names
+    long long imm;
+} Instr;
+
+// Rewrite rules of the peephole pass, each with its own hit counter
+typedef enum {
+    PEEP_PUSH_POP,      // push x ... pop y        -> mov y, x
+    PEEP_SELF_MOV,      // mov r, r                -> (nothing)
+    PEEP_IDENTITY,      // add/sub r, 0; imul r, 1 -> (nothing)
+    PEEP_IMM_FORWARD,   // mov t, 5; add d, t      -> add d, 5       (t dead)
+    PEEP_COPY_FORWARD,  // mov t, s; add d, t      -> add d, s       (t dead)
+    PEEP_COPY_BACK,     // add t, s; mov s, t      -> add s, t       (t dead)
+    PEEP_FRAME_RESTORE, // mov rsp, rbp when rsp is back where the prologue left it
+    PEEP_DEAD_WRITE,    // mov/add/sub/imul into a register nothing reads
+    PEEPHOLE_RULE_COUNT
+} PeepholeRule;
+
+// What the fast paths produce
+typedef enum {
+    EMIT_ASSEMBLY,     // Intel-syntax text for as
+    EMIT_MACHINE_CODE, // encoded .text bytes, with symbols and call relocations
+} EmitFormat;
+
+// A label or call target in machine code mode, indexed by its id in symbol_names
+typedef struct CodeSymbol {
+    uint32_t offset; // into the code, once defined
+    uint8_t defined;
+    uint8_t global;
+    uint8_t local; // a .L label: only jumps reach it, and it is not written to the object
+} CodeSymbol;
+
+// A call or jump whose rel32 field at `offset` must be patched to reach
+// `symbol`. Like GNU as, the object writer resolves jumps to symbols defined
+// in the program itself instead of leaving them to the linker.
+typedef struct CodeRelocation {
+    uint32_t offset;
+    SymbolId symbol;
+    uint8_t jump;
+} CodeRelocation;
+
+// Assembly text (or machine code) is appended to one growable in-memory
+// buffer and written out in a single call at the end, instead of going
+// through stdio per line.
+typedef struct Emitter {
+    EmitFormat format;
+    char* data;
+    size_t length;
+    size_t capacity;
+    size_t instruction_count; // instructions written out, after the peephole pass
+
+    // Instructions recorded since the last flush
+    Instr* code;
+    size_t code_count;
+    size_t code_capacity;
+    int peephole; // run the peephole pass on flush; off unless the caller sets it
+    size_t peephole_hits[PEEPHOLE_RULE_COUNT];
+
+    // Machine code mode only
+    Interner symbol_names; // label and call target names
+    CodeSymbol* symbols;   // by symbol id
+    uint32_t symbol_capacity;
+    CodeRelocation* relocations;
+    size_t relocation_count;
+    size_t relocation_capacity;
+} Emitter;
+
+void emitter_init(Emitter* emitter);              // assembly text
+void emitter_init_machine_code(Emitter* emitter); // x86-64 machine code
+void emitter_free(Emitter* emitter);
+
+// Slow path: printf-style formatting straight into the buffer. Text that only
+// means something to an assembler (directives, blank lines) goes through these
+// two, and they do nothing in machine code mode.
+void emit_fmt(Emitter* emitter, const char* fmt, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+void emit_text(Emitter* emitter, const char* text, size_t length);
+
+// Fast paths for common instruction shapes, recorded as Instr and formatted
+// without printf on flush. A call names how many argument registers it reads
+// (at most six), so the peephole pass knows which of them are still live.
+void emit_op(Emitter* emitter, Opcode op);                               // ret
+void emit_reg(Emitter* emitter, Opcode op, Reg reg);                     // push rax
+void emit_reg_reg(Emitter* emitter, Opcode op, Reg dst, Reg src);        // add rax, rbx
+void emit_reg_imm(Emitter* emitter, Opcode op, Reg dst, long long imm);  // mov rax, 5
+// The same on 32-bit operands, for int arithmetic whose result depends on the
+// upper half of a 64-bit register (division, high products, right shifts)
+void emit_reg32(Emitter* emitter, Opcode op, Reg reg);                   // idiv ecx
+void emit_reg_reg32(Emitter* emitter, Opcode op, Reg dst, Reg src);      // add eax, ecx
+void emit_reg_imm32(Emitter* emitter, Opcode op, Reg dst, int imm);      // sar eax, 3
+void emit_lea(Emitter* emitter, Reg dst, Reg src, int scale);           // lea rax, [rcx+rcx*4]
+void emit_load(Emitter* emitter, Reg dst, Reg base, int disp);          // mov rax, QWORD PTR [rbp-8]
+void emit_store(Emitter* emitter, Reg base, int disp, Reg src);         // mov QWORD PTR [rbp-8], rax
+void emit_call(Emitter* emitter, const char* name, size_t length, int arg_registers); // call f
+void emit_jump(Emitter* emitter, const char* name, size_t length, int arg_registers); // jmp f, always rel32
+void emit_label(Emitter* emitter, const char* name, size_t length);      // f:, or .Lf.loop: for a local one
+void emit_global(Emitter* emitter, const char* name, size_t length);     // .global f
+// Optimizes and writes out the recorded instructions. The code generator
+// flushes at the end of every function; labels, directives, emitter_write
+// and emitter_take flush on their own.
+void emit_flush(Emitter* emitter);
+
+const char* reg_name(Reg reg);
+const char* reg_name32(Reg reg); // eax, r8d
+const char* opcode_name(Opcode op);
+
+// Writes the whole buffer to fd (looping over short writes). Returns 0 or -1.
+int emitter_write(Emitter* emitter, int fd);
+int write_fully(int fd, const char* data, size_t length);
+// Hands the buffer (NUL-terminated) over to the caller, who must free() it.
+char* emitter_take(Emitter* emitter, size_t* length);
+
+#endif
@@ -0,0 +1,220 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "encode.h"
+
+#define REX_W 0x48
+#define REX_R 0x04 // extends ModRM.reg
+#define REX_X 0x02 // extends SIB.index
+#define REX_B 0x01 // extends ModRM.rm or the register in the opcode
+
+static void unsupported(Opcode op, const char* shape) {
+    fprintf(stderr, "Code Generation Error: No encoding for '%s' with %s operands.\n", opcode_name(op), shape);
+    exit(1);
+}
+
+// Register-direct ModRM (mod = 11)
+static uint8_t modrm(int reg_field, Reg rm) {
+    return (uint8_t)(0xC0 | ((reg_field & 7) << 3) | (rm & 7));
+}
+
+static uint8_t rex_w(int reg_field, Reg rm) {
+    return (uint8_t)(REX_W | ((reg_field & 8) ? REX_R : 0) | ((rm & 8) ? REX_B : 0));
+}
+
+// REX for 64-bit operands, or for 32-bit ones only when r8-r15 need it.
+// Writes 0 or 1 bytes.
+static size_t put_rex(uint8_t* out, int dword, int reg_field, Reg rm) {
+    if (!dword) {
+        out[0] = rex_w(reg_field, rm);
+        return 1;
+    }
+    if (!(reg_field & 8) && !(rm & 8)) return 0;
+    out[0] = (uint8_t)(0x40 | ((reg_field & 8) ? REX_R : 0) | ((rm & 8) ? REX_B : 0));
+    return 1;
+}
+
+static size_t put_imm32(uint8_t* out, int32_t imm) {
+    uint32_t v = (uint32_t)imm;
+    out[0] = (uint8_t)v;
+    out[1] = (uint8_t)(v >> 8);
+    out[2] = (uint8_t)(v >> 16);
+    out[3] = (uint8_t)(v >> 24);
+    return 4;
+}
+
+size_t encode_op(uint8_t* out, Opcode op) {
+    if (op == OP_CQO) { // REX.W 99
+        out[0] = REX_W;
+        out[1] = 0x99;
+        return 2;
+    }
+    if (op != OP_RET) unsupported(op, "no");
+    out[0] = 0xC3;
+    return 1;
+}
+
+size_t encode_reg(uint8_t* out, Opcode op, Reg reg, int dword) {
+    size_t n = 0;
+    switch (op) {
+        case OP_PUSH:
+        case OP_POP: // 50+r / 58+r, 64-bit by default
+            if (reg & 8) out[n++] = 0x40 | REX_B;
+            out[n++] = (uint8_t)((op == OP_PUSH ? 0x50 : 0x58) + (reg & 7));
+            return n;
+        case OP_IDIV: // REX.W F7 /7
+        case OP_IMUL: // REX.W F7 /5, rdx:rax = rax * reg
+        case OP_NEG:  // REX.W F7 /3
+            n += put_rex(out + n, dword, 0, reg);
+            out[n++] = 0xF7;
+            out[n++] = modrm(op == OP_IDIV ? 7 : op == OP_IMUL ? 5 : 3, reg);
+            return n;
+        default:
+            unsupported(op, "one register");
+            return 0;
+    }
+}
+
+size_t encode_reg_reg(uint8_t* out, Opcode op, Reg dst, Reg src, int dword) {
+    size_t n = 0;
+    switch (op) {
+        case OP_MOV: // REX.W 89 /r: r/m64 = r64
+        case OP_ADD: // REX.W 01 /r
+        case OP_SUB: // REX.W 29 /r
+            n += put_rex(out + n, dword, src, dst);
+            out[n++] = op == OP_MOV ? 0x89 : op == OP_ADD ? 0x01 : 0x29;
+            out[n++] = modrm(src, dst);
+            return n;
+        case OP_MOVSXD: // REX.W 63 /r: r64 = sign-extended r/m32
+            out[n++] = rex_w(dst, src);
+            out[n++] = 0x63;
+            out[n++] = modrm(dst, src);
+            return n;
+        case OP_IMUL: // REX.W 0F AF /r: r64 *= r/m64
+            n += put_rex(out + n, dword, dst, src);
+            out[n++] = 0x0F;
+            out[n++] = 0xAF;
+            out[n++] = modrm(dst, src);
+            return n;
+        default:
+            unsupported(op, "register, register");
+            return 0;
+    }
+}
+
+size_t encode_reg_imm(uint8_t* out, Opcode op, Reg dst, long long imm, int dword) {
+    size_t n = 0;
+    if (dword && op == OP_MOV) { // B8+r id, no ModRM
+        n += put_rex(out + n, dword, 0, dst);
+        out[n++] = (uint8_t)(0xB8 + (dst & 7));
+        return n + put_imm32(out + n, (int32_t)imm);
+    }
+    if (imm < INT32_MIN || imm > INT32_MAX) {
+        if (op != OP_MOV) unsupported(op, "register, 64-bit immediate");
+        out[n++] = rex_w(0, dst); // REX.W B8+r io (movabs)
+        out[n++] = (uint8_t)(0xB8 + (dst & 7));
+        uint64_t v = (uint64_t)imm;
+        for (int i = 0; i < 8; ++i) out[n++] = (uint8_t)(v >> (8 * i));
+        return n;
+    }
+    int fits_imm8 = imm >= -128 && imm <= 127;
+    switch (op) {
+        case OP_MOV: // REX.W C7 /0 id, sign-extended
+            out[n++] = rex_w(0, dst);
+            out[n++] = 0xC7;
+            out[n++] = modrm(0, dst);
+            return n + put_imm32(out + n, (int32_t)imm);
+        case OP_ADD:
+        case OP_SUB: {
+            int ext = op == OP_ADD ? 0 : 5;
+            if (fits_imm8) { // REX.W 83 /ext ib
+                n += put_rex(out + n, dword, 0, dst);
+                out[n++] = 0x83;
+                out[n++] = modrm(ext, dst);
+                out[n++] = (uint8_t)imm;
+                return n;
+            }
+            if (dst == REG_RAX) { // REX.W 05/2D id, the short accumulator form
+                if (!dword) out[n++] = REX_W;
+                out[n++] = op == OP_ADD ? 0x05 : 0x2D;
+                return n + put_imm32(out + n, (int32_t)imm);
+            }
+            n += put_rex(out + n, dword, 0, dst); // REX.W 81 /ext id
+            out[n++] = 0x81;
+            out[n++] = modrm(ext, dst);
+            return n + put_imm32(out + n, (int32_t)imm);
+        }
+        case OP_SHL:
+        case OP_SAR:
+        case OP_SHR: { // REX.W D1 /ext for a count of 1 (as picks it too), else REX.W C1 /ext ib
+            int ext = op == OP_SHL ? 4 : op == OP_SAR ? 7 : 5;
+            n += put_rex(out + n, dword, 0, dst);
+            out[n++] = imm == 1 ? 0xD1 : 0xC1;
+            out[n++] = modrm(ext, dst);
+            if (imm != 1) out[n++] = (uint8_t)imm;
+            return n;
+        }
+        case OP_IMUL: // REX.W 6B /r ib or 69 /r id, with dst as both operands
+            n += put_rex(out + n, dword, dst, dst);
+            out[n++] = fits_imm8 ? 0x6B : 0x69;
+            out[n++] = modrm(dst, dst);
+            if (fits_imm8) {
+                out[n++] = (uint8_t)imm;
+                return n;
+            }
+            return n + put_imm32(out + n, (int32_t)imm);
+        default:
+            unsupported(op, "register, immediate");
+            return 0;
+    }
+}
+
+size_t encode_lea(uint8_t* out, Reg dst, Reg src, int scale) {
+    // REX.W 8D /r with a SIB byte, src as both base and index. A base of
+    // rbp or r13 has no mod = 00 form, so it takes a zero disp8. src is never
+    // rsp, which cannot be an index.
+    size_t n = 0;
+    int scale_bits = scale == 8 ? 3 : scale == 4 ? 2 : scale == 2 ? 1 : 0;
+    int needs_disp8 = (src & 7) == 5;
+    out[n++] = (uint8_t)(REX_W | ((dst & 8) ? REX_R : 0) | ((src & 8) ? REX_X | REX_B : 0));
+    out[n++] = 0x8D;
+    out[n++] = (uint8_t)((needs_disp8 ? 0x40 : 0x00) | ((dst & 7) << 3) | 4);
+    out[n++] = (uint8_t)((scale_bits << 6) | ((src & 7) << 3) | (src & 7));
+    if (needs_disp8) out[n++] = 0;
+    return n;
+}
+
+// REX.W 8B /r (load) or 89 /r (store) with a [base+disp] operand: no
+// displacement when it is 0 and the base allows that (not rbp or r13), else
+// disp8 or disp32. A base of rsp or r12 needs a SIB byte.
+static size_t encode_memory(uint8_t* out, uint8_t opcode, Reg reg, Reg base, int disp) {
+    size_t n = 0;
+    int mod = (disp == 0 && (base & 7) != 5) ? 0 : (disp >= -128 && disp <= 127) ? 1 : 2;
+    out[n++] = (uint8_t)(REX_W | ((reg & 8) ? REX_R : 0) | ((base & 8) ? REX_B : 0));
+    out[n++] = opcode;
+    out[n++] = (uint8_t)((mod << 6) | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == 4) out[n++] = 0x24;
+    if (mod == 1) out[n++] = (uint8_t)disp;
+    if (mod == 2) n += put_imm32(out + n, disp);
+    return n;
+}
+
+size_t encode_load(uint8_t* out, Reg dst, Reg base, int disp) {
+    return encode_memory(out, 0x8B, dst, base, disp);
+}
+
+size_t encode_store(uint8_t* out, Reg base, int disp, Reg src) {
+    return encode_memory(out, 0x89, src, base, disp);
+}
+
+size_t encode_call(uint8_t* out) {
+    out[0] = 0xE8; // call rel32
+    memset(out + ENCODE_CALL_DISPLACEMENT, 0, 4);
+    return 5;
+}
+
+size_t encode_jump(uint8_t* out) {
+    out[0] = 0xE9; // jmp rel32
+    memset(out + ENCODE_CALL_DISPLACEMENT, 0, 4);
+    return 5;
+}
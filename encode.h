@@ -0,0 +1,29 @@
+#ifndef ENCODE_H
+#define ENCODE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "emit.h"
+
+// x86-64 machine code for the instruction shapes of emit.h. Each encoder
+// writes at most ENCODE_MAX_BYTES bytes to out and returns how many it wrote.
+// dword picks 32-bit operands (eax, r8d) over 64-bit ones.
+// The encodings are the ones GNU as picks for the same Intel-syntax line, so
+// objects written directly and objects assembled from our .s files match.
+#define ENCODE_MAX_BYTES 16
+
+size_t encode_op(uint8_t* out, Opcode op);                                         // ret, cqo, cdq
+size_t encode_reg(uint8_t* out, Opcode op, Reg reg, int dword);                    // push/pop/idiv/neg/imul reg
+size_t encode_reg_reg(uint8_t* out, Opcode op, Reg dst, Reg src, int dword);       // mov/add/sub/imul dst, src
+size_t encode_reg_imm(uint8_t* out, Opcode op, Reg dst, long long imm, int dword); // mov/add/sub/imul/shl/sar/shr dst, imm
+size_t encode_lea(uint8_t* out, Reg dst, Reg src, int scale);           // lea dst, [src+src*scale]
+size_t encode_load(uint8_t* out, Reg dst, Reg base, int disp);          // mov dst, QWORD PTR [base+disp]
+size_t encode_store(uint8_t* out, Reg base, int disp, Reg src);         // mov QWORD PTR [base+disp], src
+
+// call rel32 and jmp rel32 with a zero displacement; the caller records a
+// relocation for the 4 bytes at offset ENCODE_CALL_DISPLACEMENT
+size_t encode_call(uint8_t* out);
+size_t encode_jump(uint8_t* out);
+#define ENCODE_CALL_DISPLACEMENT 1
+
+#endif
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+
+struct Symbol {
+    const char* text;
+    uint32_t length;
+    uint32_t hash;
+};
+
+static uint32_t hash_text(const char* text, size_t length) {
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= (unsigned char)text[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+void interner_init(Interner* interner) {
+    interner->symbols = NULL;
+    interner->symbol_count = 0;
+    interner->symbol_capacity = 0;
+    interner->slots = NULL;
+    interner->slot_capacity = 0;
+}
+
+static void grow_slots(Interner* interner) {
+    uint32_t new_capacity = interner->slot_capacity == 0 ? 256 : interner->slot_capacity * 2;
+    uint32_t* new_slots = (uint32_t*)calloc(new_capacity, sizeof(uint32_t));
+    if (!new_slots) {
+        fprintf(stderr, "Memory allocation failed for symbol table.\n");
+        exit(1);
+    }
+    // Rehash from the stored hashes, no need to touch the names
+    for (uint32_t id = 1; id <= interner->symbol_count; ++id) {
+        uint32_t i = interner->symbols[id].hash & (new_capacity - 1);
+        while (new_slots[i]) i = (i + 1) & (new_capacity - 1);
+        new_slots[i] = id;
+    }
+    free(interner->slots);
+    interner->slots = new_slots;
+    interner->slot_capacity = new_capacity;
+}
+
+SymbolId intern(Interner* interner, const char* text, size_t length) {
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((interner->symbol_count + 1) * 2 > interner->slot_capacity) grow_slots(interner);
+
+    uint32_t hash = hash_text(text, length);
+    uint32_t mask = interner->slot_capacity - 1;
+    uint32_t i = hash & mask;
+    while (interner->slots[i]) {
+        Symbol* sym = &interner->symbols[interner->slots[i]];
+        if (sym->hash == hash && sym->length == length && memcmp(sym->text, text, length) == 0) {
+            return interner->slots[i];
+        }
+        i = (i + 1) & mask;
+    }
+
+    if (interner->symbol_count + 1 >= interner->symbol_capacity) {
+        interner->symbol_capacity = interner->symbol_capacity == 0 ? 256 : interner->symbol_capacity * 2;
+        interner->symbols = (Symbol*)realloc(interner->symbols, interner->symbol_capacity * sizeof(Symbol));
+        if (!interner->symbols) {
+            fprintf(stderr, "Memory reallocation failed for symbol table.\n");
+            exit(1);
+        }
+    }
+    SymbolId id = ++interner->symbol_count;
+    interner->symbols[id].text = text;
+    interner->symbols[id].length = (uint32_t)length;
+    interner->symbols[id].hash = hash;
+    interner->slots[i] = id;
+    return id;
+}
+
+const char* symbol_text(const Interner* interner, SymbolId id) {
+    return interner->symbols[id].text;
+}
+
+size_t symbol_length(const Interner* interner, SymbolId id) {
+    return interner->symbols[id].length;
+}
+
+void interner_free(Interner* interner) {
+    free(interner->symbols);
+    free(interner->slots);
+    interner_init(interner);
+}
@@ -0,0 +1,30 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Interned identifier. Equal names always get the same id, so later phases
+// compare names with ==. Id 0 is never handed out.
+typedef uint32_t SymbolId;
+#define SYMBOL_NONE 0
+
+// Hash table from names to ids, one per compilation.
+// It does not copy names: it keeps (pointer, length) spans into the caller's
+// buffer, which must outlive every use of the returned ids.
+typedef struct Symbol Symbol;
+typedef struct Interner {
+    Symbol* symbols; // by id; index 0 unused so that SYMBOL_NONE stays invalid
+    uint32_t symbol_count;
+    uint32_t symbol_capacity;
+    uint32_t* slots; // open addressing, linear probing; holds ids, 0 = empty
+    uint32_t slot_capacity; // power of two
+} Interner;
+
+void interner_init(Interner* interner);
+void interner_free(Interner* interner); // drops every symbol (ids become invalid)
+SymbolId intern(Interner* interner, const char* text, size_t length);
+const char* symbol_text(const Interner* interner, SymbolId id); // not NUL-terminated, see symbol_length
+size_t symbol_length(const Interner* interner, SymbolId id);
+
+#endif
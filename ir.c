@@ -0,0 +1,244 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ir.h"
+
+static const char* const op_names[IR_OP_COUNT] = {
+    "const", "add", "sub", "mul", "div", "call", "ret", "tail call", "param",
+};
+
+const char* ir_op_name(IrOp op) {
+    return op < IR_OP_COUNT ? op_names[op] : "?";
+}
+
+void ir_init(IrFunction* f) {
+    memset(f, 0, sizeof(*f));
+}
+
+void ir_free(IrFunction* f) {
+    free(f->instrs);
+    free(f->blocks);
+    free(f->operands);
+    free(f->marks);
+    ir_init(f);
+}
+
+// Doubles *capacity until `needed` items fit
+static void* grow(void* items, uint32_t needed, uint32_t* capacity, size_t item_size) {
+    if (needed <= *capacity) return items;
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 256;
+    while (new_capacity < needed) new_capacity *= 2;
+    void* grown = realloc(items, (size_t)new_capacity * item_size);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed for %u IR entries.\n", new_capacity);
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+void ir_begin_function(IrFunction* f, SymbolId name, uint32_t param_count) {
+    f->name = name;
+    f->param_count = param_count;
+    f->instr_count = 0;
+    f->block_count = 0;
+    f->operand_count = 0;
+    f->value_count = 0;
+    ir_new_block(f);
+}
+
+uint32_t ir_new_block(IrFunction* f) {
+    f->blocks = (IrBlock*)grow(f->blocks, f->block_count + 1, &f->block_capacity, sizeof(IrBlock));
+    f->blocks[f->block_count].first = f->instr_count;
+    f->blocks[f->block_count].count = 0;
+    return f->block_count++;
+}
+
+int ir_block_open(const IrFunction* f) {
+    const IrBlock* block = &f->blocks[f->block_count - 1];
+    return block->count == 0 || !ir_is_terminator((IrOp)f->instrs[block->first + block->count - 1].op);
+}
+
+static IrInstr* append(IrFunction* f, IrOp op, int has_result) {
+    f->instrs = (IrInstr*)grow(f->instrs, f->instr_count + 1, &f->instr_capacity, sizeof(IrInstr));
+    IrInstr* instr = &f->instrs[f->instr_count++];
+    f->blocks[f->block_count - 1].count++;
+    instr->op = (uint8_t)op;
+    instr->dst = has_result ? ++f->value_count : IR_NONE;
+    instr->a = instr->b = instr->c = 0;
+    return instr;
+}
+
+IrValue ir_const(IrFunction* f, int value) {
+    IrInstr* instr = append(f, IR_CONST, 1);
+    instr->a = (uint32_t)value;
+    return instr->dst;
+}
+
+IrValue ir_binary(IrFunction* f, IrOp op, IrValue left, IrValue right) {
+    IrInstr* instr = append(f, op, 1);
+    instr->a = left;
+    instr->b = right;
+    return instr->dst;
+}
+
+uint32_t ir_reserve_operands(IrFunction* f, uint32_t count) {
+    if (count == 0) return f->operand_count; // operands may still be NULL
+    f->operands = (IrValue*)grow(f->operands, f->operand_count + count, &f->operand_capacity, sizeof(IrValue));
+    memset(f->operands + f->operand_count, 0, count * sizeof(IrValue));
+    f->operand_count += count;
+    return f->operand_count - count;
+}
+
+IrValue ir_call(IrFunction* f, SymbolId callee, uint32_t first_arg, uint32_t count) {
+    IrInstr* instr = append(f, IR_CALL, 1);
+    instr->a = callee;
+    instr->b = first_arg;
+    instr->c = count;
+    return instr->dst;
+}
+
+void ir_tail_call(IrFunction* f, SymbolId callee, uint32_t first_arg, uint32_t count) {
+    IrInstr* instr = append(f, IR_TAIL_CALL, 0);
+    instr->a = callee;
+    instr->b = first_arg;
+    instr->c = count;
+}
+
+void ir_ret(IrFunction* f, IrValue value) {
+    append(f, IR_RET, 0)->a = value;
+}
+
+IrValue ir_param(IrFunction* f, uint32_t index) {
+    IrInstr* instr = append(f, IR_PARAM, 1);
+    instr->a = index;
+    return instr->dst;
+}
+
+// Verification. Without branches no block reaches another, so "defined before
+// every use" means earlier in the same block, or a parameter.
+#define PARAM_DEFINED UINT32_MAX // def_block of parameters, defined on entry
+typedef struct Verifier {
+    const IrFunction* f;
+    const Interner* names;
+    uint32_t* def_block; // block + 1 of each value's definition, 0 while undefined (f->marks)
+    uint32_t block;
+    uint32_t instr;
+} Verifier;
+
+static void verify_fail(const Verifier* v, const char* fmt, ...) {
+    va_list args;
+    fprintf(stderr, "IR Error: function '%.*s', block b%u, instruction %u: ",
+            (int)symbol_length(v->names, v->f->name), symbol_text(v->names, v->f->name), v->block, v->instr);
+    va_start(args, fmt);
+    vfprintf(stderr, fmt, args);
+    va_end(args);
+    fprintf(stderr, "\n");
+    exit(1);
+}
+
+static void verify_use(const Verifier* v, IrValue value) {
+    if (value == IR_NONE || value > v->f->value_count) verify_fail(v, "operand v%u is out of range", value);
+    uint32_t def_block = v->def_block[value];
+    if (def_block != v->block + 1 && def_block != PARAM_DEFINED) {
+        verify_fail(v, "operand v%u is not defined before this use", value);
+    }
+}
+
+void ir_verify(IrFunction* f, const Interner* names) {
+    f->marks = (uint32_t*)grow(f->marks, f->value_count + 1, &f->mark_capacity, sizeof(uint32_t));
+    memset(f->marks, 0, ((size_t)f->value_count + 1) * sizeof(uint32_t));
+    Verifier state = {f, names, f->marks, 0, 0};
+    Verifier* v = &state;
+    uint32_t expected_first = 0;
+    int params_done = 0; // past the parameters at the top of the entry block
+    for (v->block = 0; v->block < f->block_count; ++v->block) {
+        const IrBlock* block = &f->blocks[v->block];
+        v->instr = block->first;
+        if (block->first != expected_first) verify_fail(v, "block does not follow the previous one");
+        if (block->count == 0) verify_fail(v, "block is empty");
+        expected_first = block->first + block->count;
+        if (expected_first > f->instr_count) verify_fail(v, "block runs past the last instruction");
+        for (; v->instr < expected_first; ++v->instr) {
+            const IrInstr* instr = &f->instrs[v->instr];
+            int last = v->instr + 1 == expected_first;
+            int terminator = ir_is_terminator((IrOp)instr->op);
+            if (instr->op != IR_PARAM) params_done = 1;
+            switch (instr->op) {
+                case IR_CONST:
+                    break;
+                case IR_PARAM:
+                    if (params_done) verify_fail(v, "parameter after the top of the entry block");
+                    if (instr->a >= f->param_count) verify_fail(v, "parameter %u of %u", instr->a, f->param_count);
+                    break;
+                case IR_ADD:
+                case IR_SUB:
+                case IR_MUL:
+                case IR_DIV:
+                    verify_use(v, instr->a);
+                    verify_use(v, instr->b);
+                    break;
+                case IR_CALL:
+                case IR_TAIL_CALL:
+                    if (instr->a == 0 || instr->a > names->symbol_count) verify_fail(v, "callee %u is not a symbol", instr->a);
+                    if ((uint64_t)instr->b + instr->c > f->operand_count) verify_fail(v, "arguments run past the operands");
+                    for (uint32_t i = 0; i < instr->c; ++i) verify_use(v, f->operands[instr->b + i]);
+                    break;
+                case IR_RET:
+                    verify_use(v, instr->a);
+                    break;
+                default:
+                    verify_fail(v, "unknown opcode %u", instr->op);
+            }
+            if (terminator && !last) verify_fail(v, "terminator in the middle of the block");
+            if (last && !terminator) verify_fail(v, "block does not end in a terminator");
+            if (terminator) {
+                if (instr->dst != IR_NONE) verify_fail(v, "%s defines v%u", ir_op_name((IrOp)instr->op), instr->dst);
+                continue;
+            }
+            if (instr->dst == IR_NONE || instr->dst > f->value_count) verify_fail(v, "result v%u is out of range", instr->dst);
+            if (v->def_block[instr->dst]) verify_fail(v, "v%u is defined twice", instr->dst);
+            v->def_block[instr->dst] = instr->op == IR_PARAM ? PARAM_DEFINED : v->block + 1;
+        }
+    }
+    if (expected_first != f->instr_count) verify_fail(v, "instructions after the last block");
+}
+
+void ir_dump(const IrFunction* f, const Interner* names, Emitter* out) {
+    emit_fmt(out, "function %.*s/%u {\n", (int)symbol_length(names, f->name), symbol_text(names, f->name),
+             f->param_count);
+    for (uint32_t b = 0; b < f->block_count; ++b) {
+        const IrBlock* block = &f->blocks[b];
+        emit_fmt(out, "b%u:\n", b);
+        for (uint32_t i = block->first; i < block->first + block->count; ++i) {
+            const IrInstr* instr = &f->instrs[i];
+            if (instr->dst != IR_NONE) emit_fmt(out, "  v%u = ", instr->dst);
+            else emit_fmt(out, "  ");
+            switch (instr->op) {
+                case IR_CONST:
+                    emit_fmt(out, "const %d\n", (int)instr->a);
+                    break;
+                case IR_CALL:
+                case IR_TAIL_CALL:
+                    emit_fmt(out, "%s %.*s(", ir_op_name((IrOp)instr->op), (int)symbol_length(names, instr->a),
+                             symbol_text(names, instr->a));
+                    for (uint32_t j = 0; j < instr->c; ++j) {
+                        emit_fmt(out, "%sv%u", j ? ", " : "", f->operands[instr->b + j]);
+                    }
+                    emit_fmt(out, ")\n");
+                    break;
+                case IR_RET:
+                    emit_fmt(out, "ret v%u\n", instr->a);
+                    break;
+                case IR_PARAM:
+                    emit_fmt(out, "param %u\n", instr->a);
+                    break;
+                default:
+                    emit_fmt(out, "%s v%u, v%u\n", ir_op_name((IrOp)instr->op), instr->a, instr->b);
+                    break;
+            }
+        }
+    }
+    emit_fmt(out, "}\n\n");
+}
@@ -0,0 +1,100 @@
+#ifndef IR_H
+#define IR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "intern.h"
+#include "emit.h"
+
+// Middle end: one function at a time as three-address code in SSA form.
+// lower.c builds it from the AST, passes rewrite it, and codegen.c selects
+// x86-64 instructions and allocates registers from it.
+
+// Virtual register, the result of exactly one instruction. Values are
+// numbered in the order they are defined; 0 is never handed out.
+typedef uint32_t IrValue;
+#define IR_NONE 0
+
+typedef enum {
+    IR_CONST, // dst = a, an int
+    IR_ADD,   // dst = a + b
+    IR_SUB,   // dst = a - b
+    IR_MUL,   // dst = a * b
+    IR_DIV,   // dst = a / b, signed, truncating
+    IR_CALL,  // dst = a(operands[b .. b + c)), a is the callee's SymbolId
+    IR_RET,   // return a; ends a block
+    IR_TAIL_CALL, // return a(operands[b .. b + c)), reusing this function's frame; ends a block
+    IR_PARAM, // dst = parameter number a; only at the top of the entry block
+    IR_OP_COUNT
+} IrOp;
+
+static inline int ir_is_terminator(IrOp op) {
+    return op == IR_RET || op == IR_TAIL_CALL;
+}
+
+// One instruction; what a, b and c hold depends on op, see IrOp.
+// dst is IR_NONE for instructions without a result.
+typedef struct IrInstr {
+    uint8_t op; // IrOp
+    IrValue dst;
+    uint32_t a;
+    uint32_t b;
+    uint32_t c;
+} IrInstr;
+
+// Basic block: instrs[first .. first + count), ending in its only
+// terminator. Blocks are stored in order, so the function's instructions
+// run contiguously from block to block.
+typedef struct IrBlock {
+    uint32_t first;
+    uint32_t count;
+} IrBlock;
+
+// One function. The arrays are kept from one function to the next, so a
+// program is lowered without allocating per function once they have grown.
+typedef struct IrFunction {
+    SymbolId name;
+    uint32_t param_count;
+    IrInstr* instrs;
+    uint32_t instr_count;
+    uint32_t instr_capacity;
+    IrBlock* blocks;
+    uint32_t block_count;
+    uint32_t block_capacity;
+    IrValue* operands; // call arguments, see IR_CALL
+    uint32_t operand_count;
+    uint32_t operand_capacity;
+    uint32_t value_count; // values run from 1 to value_count
+    uint32_t* marks;      // per-value scratch for the verifier, value_count + 1 of them
+    uint32_t mark_capacity;
+} IrFunction;
+
+void ir_init(IrFunction* f);
+void ir_free(IrFunction* f);
+const char* ir_op_name(IrOp op);
+
+// Building: ir_begin_function drops the previous function and opens its entry
+// block. Instructions go to the end of the last block.
+void ir_begin_function(IrFunction* f, SymbolId name, uint32_t param_count);
+uint32_t ir_new_block(IrFunction* f);
+int ir_block_open(const IrFunction* f); // the last block has no terminator yet
+IrValue ir_const(IrFunction* f, int value);
+IrValue ir_binary(IrFunction* f, IrOp op, IrValue left, IrValue right);
+// Call arguments are filled into operands reserved before they are lowered,
+// so calls nested in an argument take the operands after them
+uint32_t ir_reserve_operands(IrFunction* f, uint32_t count);
+IrValue ir_call(IrFunction* f, SymbolId callee, uint32_t first_arg, uint32_t count);
+void ir_tail_call(IrFunction* f, SymbolId callee, uint32_t first_arg, uint32_t count);
+void ir_ret(IrFunction* f, IrValue value);
+IrValue ir_param(IrFunction* f, uint32_t index);
+
+// Checks that every block ends in exactly one terminator, that each value is
+// defined once and before every use, and that operands are in range.
+// Parameters come first in the entry block and may be used in any block. The
+// first violation is reported as an error.
+void ir_verify(IrFunction* f, const Interner* names);
+
+// Appends the text form (what --emit-ir prints) to out
+void ir_dump(const IrFunction* f, const Interner* names, Emitter* out);
+
+#endif
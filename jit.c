@@ -0,0 +1,77 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#include "jit.h"
+
+#ifdef _WIN32
+
+int jit_run(Emitter* code, int* result) {
+    (void)code;
+    (void)result;
+    fprintf(stderr, "JIT Error: --run is not supported on this platform.\n");
+    return -1;
+}
+
+#else
+
+// Fills in the rel32 of every call and jump; all targets must be defined in this program
+static int link_calls(Emitter* code, unsigned char* base) {
+    for (size_t i = 0; i < code->relocation_count; ++i) {
+        const CodeRelocation* reloc = &code->relocations[i];
+        const CodeSymbol* target = &code->symbols[reloc->symbol];
+        if (!target->defined) {
+            fprintf(stderr, "JIT Error: Call to undefined function '%.*s'.\n",
+                    (int)symbol_length(&code->symbol_names, reloc->symbol),
+                    symbol_text(&code->symbol_names, reloc->symbol));
+            return -1;
+        }
+        int32_t displacement = (int32_t)((long long)target->offset - ((long long)reloc->offset + 4));
+        memcpy(base + reloc->offset, &displacement, sizeof(displacement));
+    }
+    return 0;
+}
+
+int jit_run(Emitter* code, int* result) {
+    SymbolId main_id = intern(&code->symbol_names, "main", 4);
+    if (main_id >= code->symbol_capacity || !code->symbols[main_id].defined) {
+        fprintf(stderr, "JIT Error: The program has no 'main' function.\n");
+        return -1;
+    }
+
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+    size_t size = (code->length + (size_t)page - 1) / (size_t)page * (size_t)page;
+    if (size == 0) size = (size_t)page;
+    unsigned char* base = (unsigned char*)mmap(NULL, size, PROT_READ | PROT_WRITE,
+                                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "JIT Error: Could not map code memory: %s\n", strerror(errno));
+        return -1;
+    }
+    memcpy(base, code->data, code->length);
+    if (link_calls(code, base) != 0) {
+        munmap(base, size);
+        return -1;
+    }
+    if (mprotect(base, size, PROT_READ | PROT_EXEC) != 0) {
+        fprintf(stderr, "JIT Error: Could not make code executable: %s\n", strerror(errno));
+        munmap(base, size);
+        return -1;
+    }
+
+    // Object-to-function pointer conversion, as dlsym users do
+    int (*entry)(void);
+    void* address = base + code->symbols[main_id].offset;
+    memcpy(&entry, &address, sizeof(entry));
+    *result = entry();
+
+    munmap(base, size);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include "emit.h"
+
+// --run: loads the machine code of a EMIT_MACHINE_CODE emitter into memory,
+// links the calls between its functions and calls `main`, all in-process.
+// The code is written into a read/write mapping that is switched to
+// read/execute before it runs, so no page is ever writable and executable.
+// Returns 0 with main's return value in *result, or -1 after a diagnostic.
+int jit_run(Emitter* code, int* result);
+
+#endif
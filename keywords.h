@@ -0,0 +1,30 @@
+#ifndef KEYWORDS_H
+#define KEYWORDS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keyword lookup is a perfect hash generated ahead of time by
+// tools/gen_keywords.c from keywords.def into keywords.inc: every keyword
+// lands in its own slot, so a lookup is one multiply, one load and one memcmp.
+
+typedef struct KeywordEntry {
+    const char* text;
+    uint8_t length; // 0 marks an empty slot
+    uint8_t type;   // TokenType
+} KeywordEntry;
+
+// Key fed to the hash: first two bytes, last byte and length. s[1] may be the
+// byte after a one-letter word, which is fine (the memcmp decides).
+static inline uint32_t keyword_key(const char* s, size_t length) {
+    return (uint32_t)(unsigned char)s[0] |
+           (uint32_t)(unsigned char)s[1] << 8 |
+           (uint32_t)(unsigned char)s[length - 1] << 16 |
+           (uint32_t)length << 24;
+}
+
+static inline uint32_t keyword_slot(uint32_t key, uint32_t seed, unsigned shift) {
+    return (key * seed) >> shift;
+}
+
+#endif
@@ -1,107 +1,373 @@
-
-#include "token.h"
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h> // For isalnum, isdigit, isalpha, isspace
-
-#define MAX_ID_LEN 64
-static const char* input_ptr;
-Token getNextToken();
-
-static void skip_whitespace_and_comments(){
-    while (*input_ptr!='\0'){
-        if (isspace(*input_ptr)){  //skipping whitespace
-            input_ptr++;
-        }
-        else if (*input_ptr == '/' && *(input_ptr + 1) == '/'){
-            input_ptr+=2; // skip single line comment
-            while (*input_ptr!='\n' && *input_ptr != '\0'){
-                input_ptr++;
-            }
-        }
-        else if(*input_ptr == '/' && *(input_ptr + 1) == '*') { // Multi-line comment
-            input_ptr += 2;
-            while (!(*input_ptr == '*' && *(input_ptr + 1) == '/') && *input_ptr!= '\0') {
-                input_ptr++;
-            if (*input_ptr!='\0'){ // skips the closing sequence 
-                input_ptr+=2;
-            }
-        }
-        }
-        else{
-            break; // Not whitespace or comment
-        }
-    }
-}
-
-
-static Token create_token(TokenType type){
-    Token t;
-    t.type=type;
-    return t;
-};
-static Token create_number_token(int value) {
-    Token t = create_token(TOKEN_NUMBER);
-    t.value.int_value = value;
-    return t;
-}
-static Token create_string_token(TokenType type, const char* str_value){
-    Token t = create_token(type);
-    t.value.string_value=strdup(str_value);
-    return t;
-}
-Token getNextToken(){
-    skip_whitespace_and_comments();
-    if (*input_ptr=='\0'){
-        return create_token(TOKEN_EOF);
-    }
-    // Handle numbers:
-    if (isdigit(*input_ptr)){
-        int value = 0;
-        while (isdigit(*input_ptr)){
-            value=value*10+ (*input_ptr-'0'); // method to convert a string digit to an int
-            input_ptr++;
-        }
-        return create_number_token(value);
-    };
-    switch(*input_ptr){
-        case '+': input_ptr++; return create_token(TOKEN_PLUS);
-        case '-':input_ptr++; return create_token(TOKEN_MINUS);
-        case '*': input_ptr++; return create_token(TOKEN_MULTIPLY);
-        case '/': input_ptr++; return create_token(TOKEN_DIVIDE);
-        case '(': input_ptr++; return create_token(TOKEN_LPAREN);
-        case ')': input_ptr++; return create_token(TOKEN_RPAREN);
-        case ';': input_ptr++; return create_token(TOKEN_SEMICOLON);
-        case '{': input_ptr++; return create_token(TOKEN_LBRACE);
-        case '}': input_ptr++; return create_token(TOKEN_RBRACE);
-        case ',': input_ptr++; return create_token(TOKEN_COMMA);
-        case '=': input_ptr++; return create_token(TOKEN_ASSIGN);
-    }
-    // handle identifiers and keywords: 
-    if (isalpha(*input_ptr) || *input_ptr == '_') {
-        char buffer[MAX_ID_LEN]; // Max identifier length
-        int i = 0;
-        while (((isalnum(*input_ptr) || *input_ptr == '_')) && (i<MAX_ID_LEN-1)) {
-            buffer[i++] = *input_ptr++;
-        }
-        buffer[i] = '\0';
-
-        // Check for keywords
-        if (strcmp(buffer, "return") == 0) {
-            return create_string_token(TOKEN_RETURN, buffer);
-        } else if (strcmp(buffer, "int") == 0) {
-            return create_string_token(TOKEN_INT, buffer);
-        }
-        // Add other keywords here as the language expands
-        return create_string_token(TOKEN_IDENTIFIER, buffer);
-    }
-    //UNKNOWN CHARACTER 
-    fprintf(stderr, "Lexer Error: Unknown character '%c'\n", *input_ptr);
-    input_ptr++; // Advance to avoid infinite loop
-    return create_token(TOKEN_EOF);}
- // Or a specific error token
-
-void lexer_init(const char* source_code){
-    input_ptr = source_code;
-}
\ No newline at end of file
+#include "lexer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "scan.h"
+#include "threadpool.h"
+#include "keywords.h"
+#include "keywords.inc" // keyword_table, generated from keywords.def
+
+
+// Single-character tokens; 0 (TOKEN_EOF) marks bytes that are not punctuators
+static const uint8_t punct_tokens[256] = {
+    ['+'] = TOKEN_PLUS,
+    ['-'] = TOKEN_MINUS,
+    ['*'] = TOKEN_MULTIPLY,
+    ['/'] = TOKEN_DIVIDE,
+    ['('] = TOKEN_LPAREN,
+    [')'] = TOKEN_RPAREN,
+    [';'] = TOKEN_SEMICOLON,
+    ['{'] = TOKEN_LBRACE,
+    ['}'] = TOKEN_RBRACE,
+    [','] = TOKEN_COMMA,
+    ['='] = TOKEN_ASSIGN,
+};
+
+static void skip_whitespace_and_comments(Lexer* lexer){
+    const char* p = lexer->input_ptr;
+    for (;;) {
+        p = scan_whitespace(p, &lexer->lines);
+        if (p[0] != '/') break;
+        if (p[1] == '/') { // single line comment, the '\n' is skipped as whitespace
+            p = scan_line_comment(p + 2);
+        } else if (p[1] == '*') { // multi-line comment, an unterminated one runs to the end
+            p = scan_block_comment(p + 2, &lexer->lines);
+        } else {
+            break; // a division operator
+        }
+    }
+    lexer->input_ptr = p;
+}
+
+// Keyword type for the word [start, start + length), or TOKEN_IDENTIFIER
+static TokenType lookup_keyword(const char* start, size_t length){
+    if (length < KEYWORD_MIN_LENGTH || length > KEYWORD_MAX_LENGTH) return TOKEN_IDENTIFIER;
+    const KeywordEntry* entry = &keyword_table[keyword_slot(keyword_key(start, length), KEYWORD_HASH_SEED, KEYWORD_HASH_SHIFT)];
+    if (entry->length != length) return TOKEN_IDENTIFIER;
+    // Keywords are short; an inline byte loop beats a call to memcmp
+    for (size_t i = 0; i < length; ++i) {
+        if (entry->text[i] != start[i]) return TOKEN_IDENTIFIER;
+    }
+    return (TokenType)entry->type;
+}
+
+// Token of `type` spanning [start, input_ptr)
+static Token create_token(Lexer* lexer, TokenType type, const char* start){
+    Token t;
+    t.type=type;
+    t.offset=(uint32_t)(start - lexer->source_start);
+    t.length=(uint32_t)(lexer->input_ptr - start);
+    t.line=lexer->lines.line;
+    t.column=(uint32_t)(start - lexer->lines.line_start) + 1;
+    lexer->token_count++;
+    return t;
+};
+// Next token, without reporting errors: an unknown character comes back as a
+// TOKEN_EOF of length 1, where the real end of input has length 0
+static Token next_token(Lexer* lexer){
+    skip_whitespace_and_comments(lexer);
+    const char* start = lexer->input_ptr;
+    unsigned char c = (unsigned char)*lexer->input_ptr;
+    if (c=='\0'){
+        return create_token(lexer, TOKEN_EOF, start);
+    }
+    uint8_t punct = punct_tokens[c];
+    if (punct) {
+        lexer->input_ptr++;
+        return create_token(lexer, (TokenType)punct, start);
+    }
+    // Handle numbers:
+    if (CHAR_IS(c, CC_DIGIT)){
+        int value = 0;
+        while (CHAR_IS(*lexer->input_ptr, CC_DIGIT)){
+            value=value*10+ (*lexer->input_ptr-'0'); // method to convert a string digit to an int
+            lexer->input_ptr++;
+        }
+        Token t = create_token(lexer, TOKEN_NUMBER, start);
+        t.value.int_value = value;
+        return t;
+    };
+    // handle identifiers and keywords: 
+    if (CHAR_IS(c, CC_IDENT_START)) {
+        do {
+            lexer->input_ptr++;
+        } while (CHAR_IS(*lexer->input_ptr, CC_IDENT));
+        size_t length = (size_t)(lexer->input_ptr - start);
+
+        TokenType type = lookup_keyword(start, length);
+        Token t = create_token(lexer, type, start);
+        if (type == TOKEN_IDENTIFIER) {
+            t.value.symbol = intern(lexer->names, start, length); // the name stays in the source buffer
+        }
+        return t;
+    }
+    //UNKNOWN CHARACTER 
+    lexer->input_ptr++; // Advance to avoid infinite loop
+    return create_token(lexer, TOKEN_EOF, start);
+}
+
+static void report_unknown_character(const char* source, uint32_t line, uint32_t column, uint32_t offset){
+    fprintf(stderr, "Lexer Error: %u:%u: Unknown character '%c'\n", line, column, source[offset]);
+}
+
+Token getNextToken(Lexer* lexer){
+    Token t = next_token(lexer);
+    if (t.type == TOKEN_EOF && t.length != 0) {
+        report_unknown_character(lexer->source_start, t.line, t.column, t.offset);
+        lexer->failed = 1;
+    }
+    return t;
+}
+
+void lexer_init(Lexer* lexer, const char* source_code, Interner* names){
+    scan_init();
+    lexer->source_start = source_code;
+    lexer->input_ptr = source_code;
+    lexer->lines.line = 1;
+    lexer->lines.line_start = source_code;
+    lexer->names = names;
+    lexer->token_count = 0;
+    lexer->failed = 0;
+}
+
+// ---- Pre-lexing into a TokenArray ----
+
+void token_array_init(TokenArray* tokens, const char* source){
+    tokens->kinds = NULL;
+    tokens->values = NULL;
+    tokens->offsets = NULL;
+    tokens->lengths = NULL;
+    tokens->count = 0;
+    tokens->capacity = 0;
+    tokens->source = source;
+}
+
+void token_array_free(TokenArray* tokens){
+    free(tokens->kinds);
+    free(tokens->values);
+    free(tokens->offsets);
+    free(tokens->lengths);
+    token_array_init(tokens, tokens->source);
+}
+
+static void token_array_reserve(TokenArray* tokens, size_t capacity){
+    if (capacity <= tokens->capacity) return;
+    uint8_t* kinds = realloc(tokens->kinds, capacity * sizeof(*kinds));
+    if (kinds) tokens->kinds = kinds;
+    TokenValue* values = realloc(tokens->values, capacity * sizeof(*values));
+    if (values) tokens->values = values;
+    uint32_t* offsets = realloc(tokens->offsets, capacity * sizeof(*offsets));
+    if (offsets) tokens->offsets = offsets;
+    uint32_t* lengths = realloc(tokens->lengths, capacity * sizeof(*lengths));
+    if (lengths) tokens->lengths = lengths;
+    if (!kinds || !values || !offsets || !lengths) {
+        fprintf(stderr, "Lexer Error: Out of memory for %zu tokens\n", capacity);
+        exit(1);
+    }
+    tokens->capacity = capacity;
+}
+
+static void token_array_push(TokenArray* tokens, const Token* t){
+    if (tokens->count == tokens->capacity) token_array_reserve(tokens, tokens->capacity * 2 + 64);
+    size_t i = tokens->count++;
+    tokens->kinds[i] = (uint8_t)t->type;
+    tokens->values[i] = t->value;
+    tokens->offsets[i] = t->offset;
+    tokens->lengths[i] = t->length;
+}
+
+void token_array_position(const TokenArray* tokens, uint32_t offset, uint32_t* line, uint32_t* column){
+    // Only error paths ask, so the newlines are simply counted again
+    const char* p = tokens->source;
+    const char* end = p + offset;
+    const char* line_start = p;
+    uint32_t lines = 1;
+    while ((p = memchr(p, '\n', (size_t)(end - p))) != NULL) {
+        lines++;
+        line_start = ++p;
+    }
+    *line = lines;
+    *column = (uint32_t)(end - line_start) + 1;
+}
+
+// Lexing split at line starts. A chunk owns the tokens that start in
+// [begin, end); since a boundary may fall inside a block comment, each chunk
+// also records where its first token starts so the join can tell whether the
+// previous chunk would have reached the same place.
+typedef struct LexChunk {
+    const char* begin;
+    const char* end;
+    TokenArray* tokens;
+    Interner* names;
+    uint32_t first_offset;  // start of the first token at or after begin
+    uint32_t resume_offset; // start of the first token at or after end
+    int reached_eof;        // stopped at the end of input or an unknown character
+} LexChunk;
+
+static void lex_chunk(LexChunk* chunk, const char* source){
+    Lexer lexer;
+    lexer_init(&lexer, source, chunk->names);
+    lexer.input_ptr = chunk->begin;
+    lexer.lines.line_start = chunk->begin; // columns are recomputed on demand, see token_array_position
+    chunk->tokens->count = 0;
+    chunk->reached_eof = 0;
+    Token t = next_token(&lexer);
+    chunk->first_offset = t.offset;
+    for (;;) {
+        if (t.type == TOKEN_EOF) {
+            token_array_push(chunk->tokens, &t);
+            chunk->reached_eof = 1;
+            return;
+        }
+        if (source + t.offset >= chunk->end) {
+            chunk->resume_offset = t.offset;
+            return;
+        }
+        token_array_push(chunk->tokens, &t);
+        t = next_token(&lexer);
+    }
+}
+
+// A chunk is only worth a thread with at least this much source
+#define LEX_CHUNK_MIN_BYTES (256 * 1024)
+
+typedef struct ParallelLex {
+    const char* source;
+    LexChunk* chunks;
+    TokenArray* chunk_tokens;
+    Interner* chunk_names;
+    SymbolId** remaps;      // chunk symbol id -> shared id
+    size_t* destinations;   // index of each chunk's first token in the joined array
+    TokenArray* out;
+} ParallelLex;
+
+static void lex_chunk_task(void* context, size_t index){
+    ParallelLex* lex = context;
+    lex_chunk(&lex->chunks[index], lex->source);
+}
+
+static void copy_chunk_task(void* context, size_t index){
+    ParallelLex* lex = context;
+    const TokenArray* from = &lex->chunk_tokens[index];
+    TokenArray* to = lex->out;
+    size_t at = lex->destinations[index];
+    const SymbolId* remap = lex->remaps[index];
+    memcpy(to->kinds + at, from->kinds, from->count * sizeof(*from->kinds));
+    memcpy(to->offsets + at, from->offsets, from->count * sizeof(*from->offsets));
+    memcpy(to->lengths + at, from->lengths, from->count * sizeof(*from->lengths));
+    for (size_t i = 0; i < from->count; ++i) {
+        TokenValue value = from->values[i];
+        if (from->kinds[i] == TOKEN_IDENTIFIER) value.symbol = remap[value.symbol];
+        to->values[at + i] = value;
+    }
+}
+
+static void lex_tokens_parallel(TokenArray* out, const char* source, size_t length, Interner* names,
+                                size_t chunk_count, int thread_count){
+    ParallelLex lex;
+    lex.source = source;
+    lex.out = out;
+    lex.chunks = calloc(chunk_count, sizeof(LexChunk));
+    lex.chunk_tokens = calloc(chunk_count, sizeof(TokenArray));
+    lex.chunk_names = calloc(chunk_count, sizeof(Interner));
+    lex.remaps = calloc(chunk_count, sizeof(SymbolId*));
+    lex.destinations = calloc(chunk_count, sizeof(size_t));
+    if (!lex.chunks || !lex.chunk_tokens || !lex.chunk_names || !lex.remaps || !lex.destinations) {
+        fprintf(stderr, "Lexer Error: Out of memory for %zu chunks\n", chunk_count);
+        exit(1);
+    }
+
+    // Boundaries go just past a '\n', which never falls inside a token
+    const char* begin = source;
+    for (size_t i = 0; i < chunk_count; ++i) {
+        const char* end = source + length;
+        if (i + 1 < chunk_count) {
+            const char* target = source + length / chunk_count * (i + 1);
+            if (target < begin) target = begin;
+            const char* newline = memchr(target, '\n', (size_t)(source + length - target));
+            if (newline) end = newline + 1;
+        }
+        LexChunk* chunk = &lex.chunks[i];
+        chunk->begin = begin;
+        chunk->end = end;
+        chunk->tokens = &lex.chunk_tokens[i];
+        chunk->names = &lex.chunk_names[i];
+        token_array_init(chunk->tokens, source);
+        token_array_reserve(chunk->tokens, (size_t)(end - begin) / 4 + 16);
+        interner_init(chunk->names);
+        begin = end;
+    }
+    parallel_for(chunk_count, thread_count, lex_chunk_task, &lex);
+
+    // Join in order. A chunk whose first token is not where the previous one
+    // stopped began inside a comment, and is lexed again from the right place.
+    // Renumbering chunk by chunk hands out shared ids in first-use order, the
+    // same ids a single lexer would have assigned.
+    size_t used = 0, total = 0;
+    while (used < chunk_count) {
+        LexChunk* chunk = &lex.chunks[used];
+        if (used > 0) {
+            const LexChunk* previous = &lex.chunks[used - 1];
+            if (previous->reached_eof) break;
+            if (chunk->first_offset != previous->resume_offset) {
+                chunk->begin = source + previous->resume_offset;
+                interner_free(chunk->names);
+                interner_init(chunk->names);
+                lex_chunk(chunk, source);
+            }
+        }
+        SymbolId* remap = malloc(((size_t)chunk->names->symbol_count + 1) * sizeof(SymbolId));
+        if (!remap) {
+            fprintf(stderr, "Lexer Error: Out of memory for %u symbols\n", chunk->names->symbol_count);
+            exit(1);
+        }
+        remap[SYMBOL_NONE] = SYMBOL_NONE;
+        for (SymbolId id = 1; id <= chunk->names->symbol_count; ++id) {
+            remap[id] = intern(names, symbol_text(chunk->names, id), symbol_length(chunk->names, id));
+        }
+        lex.remaps[used] = remap;
+        lex.destinations[used] = total;
+        total += chunk->tokens->count;
+        used++;
+    }
+    token_array_reserve(out, total);
+    out->count = total;
+    parallel_for(used, thread_count, copy_chunk_task, &lex);
+
+    for (size_t i = 0; i < chunk_count; ++i) {
+        free(lex.remaps[i]);
+        token_array_free(&lex.chunk_tokens[i]);
+        interner_free(&lex.chunk_names[i]);
+    }
+    free(lex.chunks);
+    free(lex.chunk_tokens);
+    free(lex.chunk_names);
+    free(lex.remaps);
+    free(lex.destinations);
+}
+
+int lex_tokens(TokenArray* out, const char* source, size_t length, Interner* names, int thread_count){
+    scan_init();
+    token_array_init(out, source);
+    size_t chunk_count = length / LEX_CHUNK_MIN_BYTES;
+    if (thread_count < 1) thread_count = 1;
+    if (chunk_count > (size_t)thread_count) chunk_count = (size_t)thread_count;
+    if (chunk_count > 1) {
+        lex_tokens_parallel(out, source, length, names, chunk_count, thread_count);
+    } else {
+        LexChunk chunk = {source, source + length, out, names, 0, 0, 0};
+        token_array_reserve(out, length / 4 + 16); // about one token per four bytes of typical source
+        lex_chunk(&chunk, source);
+    }
+    // The chunks stay quiet; the one error a streaming lexer would have
+    // reported before the parser stopped at it is reported here instead
+    size_t last = out->count - 1;
+    if (out->lengths[last] != 0) {
+        uint32_t line, column;
+        token_array_position(out, out->offsets[last], &line, &column);
+        report_unknown_character(source, line, column, out->offsets[last]);
+        return -1;
+    }
+    return 0;
+}
@@ -1,10 +1,34 @@
-#ifndef LEXER_H
-#define LEXER_H
-
-#include "token.h"
-
-void lexer_init(const char* source_code);
-
-Token getNextToken();
-
-#endif
\ No newline at end of file
+#ifndef LEXER_H
+#define LEXER_H
+
+#include "token.h"
+#include "intern.h"
+#include "scan.h"
+
+// Lexing state for one source buffer
+typedef struct Lexer {
+    const char* source_start; // offsets in tokens are relative to this
+    const char* input_ptr;
+    ScanLines lines;          // current line and where it starts
+    Interner* names;          // identifiers are interned here
+    size_t token_count;       // tokens returned so far, EOF included
+    int failed;               // an unknown character was reported; it ended the input
+} Lexer;
+
+void lexer_init(Lexer* lexer, const char* source_code, Interner* names);
+
+Token getNextToken(Lexer* lexer);
+
+// Lexes all of source (length bytes, NUL-terminated as for lexer_init) into
+// tokens, which is initialized here and freed with token_array_free. Files
+// large enough are split at line starts and lexed on up to thread_count
+// threads; the result is the same as with one thread. Lexing stops at the
+// end of input or at the first unknown character, which is reported.
+// Returns 0, or -1 if it stopped at an unknown character.
+int lex_tokens(TokenArray* tokens, const char* source, size_t length, Interner* names, int thread_count);
+void token_array_init(TokenArray* tokens, const char* source);
+void token_array_free(TokenArray* tokens);
+// 1-based line and column of the byte at offset, counted from the source
+void token_array_position(const TokenArray* tokens, uint32_t offset, uint32_t* line, uint32_t* column);
+
+#endif
@@ -0,0 +1,243 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "lower.h"
+#include "token.h" // For TokenType
+
+// Calls clobber every caller-saved register, so they count as needing all of
+// them: a parent then evaluates the call first, while nothing else is live.
+#define CALL_NEED 1000000
+
+// Sethi-Ullman number of every node: how many values evaluating it keeps
+// live at once. Constants need none; the backend folds them into the
+// instruction that uses them. Variables need none either, their values being
+// live already. The parser makes a node's children before the node, so one
+// forward pass over the node arrays sees children first. The inliner breaks
+// that only by hanging copies, which have larger ids, under older nodes; the
+// copies point only at each other, so they are right after the first pass
+// and a second one fixes the older nodes above them.
+static void compute_register_need(Lowerer* lw) {
+    const AST* ast = lw->ast;
+    int passes = 1;
+    for (int pass = 0; pass < passes; ++pass) {
+        for (NodeId node = 1; node <= ast->node_count; ++node) {
+            uint32_t need;
+            switch (ast_kind(ast, node)) {
+                case AST_NUMBER:
+                case AST_IDENTIFIER:
+                    need = 0;
+                    break;
+                case AST_BINARY_OP: {
+                    NodeId left = ast_left(ast, node), right = ast_right(ast, node);
+                    if (left > node || right > node) passes = 2;
+                    uint32_t left_need = lw->need[left];
+                    uint32_t right_need = lw->need[right];
+                    if (left_need == right_need) need = left_need + 1;
+                    else need = left_need > right_need ? left_need : right_need;
+                    break;
+                }
+                case AST_FUNCTION_CALL:
+                    need = CALL_NEED;
+                    break;
+                default:
+                    need = 1;
+                    break;
+            }
+            lw->need[node] = need;
+        }
+    }
+}
+
+void lowerer_init(Lowerer* lw, const AST* ast, const Interner* names, int tail_calls) {
+    lw->ast = ast;
+    lw->names = names;
+    lw->tail_calls = tail_calls;
+    scope_init(&lw->scopes);
+    lw->frames = NULL;
+    lw->frame_count = 0;
+    lw->frame_capacity = 0;
+    lw->need = (uint32_t*)calloc((size_t)ast->node_count + 1, sizeof(uint32_t));
+    if (!lw->need) {
+        fprintf(stderr, "Memory allocation failed for lowering.\n");
+        exit(1);
+    }
+    compute_register_need(lw);
+}
+
+void lowerer_free(Lowerer* lw) {
+    free(lw->need);
+    lw->need = NULL;
+    free(lw->frames);
+    lw->frames = NULL;
+    scope_free(&lw->scopes);
+}
+
+static IrOp binary_opcode(TokenType op) {
+    switch (op) {
+        case TOKEN_PLUS:
+            return IR_ADD;
+        case TOKEN_MINUS:
+            return IR_SUB;
+        case TOKEN_MULTIPLY:
+            return IR_MUL;
+        case TOKEN_DIVIDE:
+            return IR_DIV;
+        default:
+            fprintf(stderr, "Code Generation Error: Unknown binary operator.\n");
+            exit(1);
+    }
+}
+
+static void push_frame(Lowerer* lw, NodeId node) {
+    if (lw->frame_count == lw->frame_capacity) {
+        lw->frame_capacity = lw->frame_capacity ? lw->frame_capacity * 2 : 64;
+        lw->frames = (LowerFrame*)realloc(lw->frames, lw->frame_capacity * sizeof(LowerFrame));
+        if (!lw->frames) {
+            fprintf(stderr, "Memory allocation failed for lowering.\n");
+            exit(1);
+        }
+    }
+    LowerFrame* frame = &lw->frames[lw->frame_count++];
+    frame->node = node;
+    frame->step = 0;
+}
+
+static IrValue lower_variable(Lowerer* lw, IrFunction* f, NodeId node) {
+    const AST* ast = lw->ast;
+    IrValue value;
+    if (!scope_lookup(&lw->scopes, ast_name(ast, node), &value)) {
+        SymbolId name = ast_name(ast, node);
+        fprintf(stderr, "Code Generation Error: Undefined variable '%.*s' in function '%.*s'.\n",
+                (int)symbol_length(lw->names, name), symbol_text(lw->names, name),
+                (int)symbol_length(lw->names, f->name), symbol_text(lw->names, f->name));
+        lw->errors++;
+        return ir_const(f, 0);
+    }
+    return value;
+}
+
+// Lowers the expression root and returns its value. The tree is walked over
+// an explicit stack (lw->frames), so nesting depth costs heap, not native
+// stack. A frame that is done leaves its value in `value` for the frame
+// below it, which picks it up on its next step.
+static IrValue lower_expression(Lowerer* lw, IrFunction* f, NodeId root) {
+    const AST* ast = lw->ast;
+    uint32_t base = lw->frame_count;
+    IrValue value = IR_NONE;
+    push_frame(lw, root);
+    while (lw->frame_count > base) {
+        LowerFrame* frame = &lw->frames[lw->frame_count - 1];
+        NodeId node = frame->node;
+        switch (ast_kind(ast, node)) {
+            case AST_NUMBER:
+                value = ir_const(f, ast_number_value(ast, node));
+                break;
+            case AST_IDENTIFIER:
+                value = lower_variable(lw, f, node);
+                break;
+            case AST_BINARY_OP: {
+                // The operand that needs more registers goes first
+                NodeId left = ast_left(ast, node);
+                NodeId right = ast_right(ast, node);
+                int right_first = lw->need[right] > lw->need[left];
+                if (frame->step == 0) {
+                    frame->step = 1;
+                    push_frame(lw, right_first ? right : left);
+                    continue;
+                }
+                if (frame->step == 1) {
+                    frame->step = 2;
+                    frame->value = value;
+                    push_frame(lw, right_first ? left : right);
+                    continue;
+                }
+                IrValue left_value = right_first ? value : frame->value;
+                IrValue right_value = right_first ? frame->value : value;
+                value = ir_binary(f, binary_opcode(ast_binary_op(ast, node)), left_value, right_value);
+                break;
+            }
+            case AST_FUNCTION_CALL: {
+                // Arguments are lowered right to left into operands reserved up front
+                NodeId args = ast_call_args(ast, node);
+                uint32_t count = ast_list_count(ast, args);
+                if (frame->step == 0) frame->first = ir_reserve_operands(f, count);
+                else f->operands[frame->first + count - frame->step] = value;
+                if (frame->step < count) {
+                    uint32_t next = count - ++frame->step;
+                    push_frame(lw, ast_list_item(ast, args, next));
+                    continue;
+                }
+                value = ir_call(f, ast_name(ast, node), frame->first, count);
+                break;
+            }
+            default:
+                fprintf(stderr, "Code Generation Error: Unexpected AST node type in expression: %d\n", ast_kind(ast, node));
+                exit(1);
+        }
+        lw->frame_count--; // node is done; value holds it
+    }
+    return value;
+}
+
+// Lowers the arguments of call, right to left, into operands it returns the first of
+static uint32_t lower_arguments(Lowerer* lw, IrFunction* f, NodeId call) {
+    const AST* ast = lw->ast;
+    NodeId args = ast_call_args(ast, call);
+    uint32_t count = ast_list_count(ast, args);
+    uint32_t first = ir_reserve_operands(f, count);
+    for (uint32_t i = count; i-- > 0;) {
+        IrValue value = lower_expression(lw, f, ast_list_item(ast, args, i));
+        f->operands[first + i] = value;
+    }
+    return first;
+}
+
+static void lower_statement(Lowerer* lw, IrFunction* f, NodeId node) {
+    const AST* ast = lw->ast;
+    if (!ir_block_open(f)) ir_new_block(f); // code after a return
+    switch (ast_kind(ast, node)) {
+        case AST_RETURN_STMT: {
+            NodeId expr = ast_expr(ast, node);
+            if (lw->tail_calls && ast_kind(ast, expr) == AST_FUNCTION_CALL) {
+                uint32_t first = lower_arguments(lw, f, expr);
+                ir_tail_call(f, ast_name(ast, expr), first, ast_list_count(ast, ast_call_args(ast, expr)));
+                break;
+            }
+            ir_ret(f, lower_expression(lw, f, expr));
+            break;
+        }
+        case AST_EXPRESSION_STMT:
+            lower_expression(lw, f, ast_expr(ast, node));
+            break;
+        case AST_BLOCK:
+            scope_push(&lw->scopes);
+            for (uint32_t i = 0; i < ast_list_count(ast, node); ++i) {
+                lower_statement(lw, f, ast_list_item(ast, node, i));
+            }
+            scope_pop(&lw->scopes);
+            break;
+        default:
+            fprintf(stderr, "Code Generation Error: Unexpected AST node type in statement: %d\n", ast_kind(ast, node));
+            exit(1);
+    }
+}
+
+int lower_function(Lowerer* lw, IrFunction* f, NodeId def) {
+    const AST* ast = lw->ast;
+    NodeId params = ast_params(ast, def);
+    lw->errors = 0;
+    ir_begin_function(f, ast_name(ast, def), ast_list_count(ast, params));
+    scope_push(&lw->scopes);
+    for (uint32_t i = 0; i < f->param_count; ++i) {
+        SymbolId name = ast_name(ast, ast_list_item(ast, params, i));
+        if (!scope_define(&lw->scopes, name, ir_param(f, i))) {
+            fprintf(stderr, "Code Generation Error: Parameter '%.*s' of function '%.*s' is declared twice.\n",
+                    (int)symbol_length(lw->names, name), symbol_text(lw->names, name),
+                    (int)symbol_length(lw->names, f->name), symbol_text(lw->names, f->name));
+            lw->errors++;
+        }
+    }
+    lower_statement(lw, f, ast_body(ast, def));
+    scope_pop(&lw->scopes);
+    if (ir_block_open(f)) ir_ret(f, ir_const(f, 0));
+    return lw->errors ? -1 : 0;
+}
@@ -0,0 +1,42 @@
+#ifndef LOWER_H
+#define LOWER_H
+
+#include "ast.h"
+#include "ir.h"
+#include "scope.h"
+
+// An expression node lower_expression is working on
+typedef struct LowerFrame {
+    NodeId node;
+    uint32_t step;  // operands lowered so far
+    uint32_t first; // AST_FUNCTION_CALL: its first reserved operand
+    IrValue value;  // AST_BINARY_OP: the operand lowered first
+} LowerFrame;
+
+// State shared by the functions of one program
+typedef struct Lowerer {
+    const AST* ast;
+    const Interner* names; // for error messages
+    uint32_t* need; // Sethi-Ullman number by node
+    int tail_calls; // lower `return f(...);` to IR_TAIL_CALL
+    ScopeTable scopes; // name to IrValue, for the function being lowered
+    int errors;     // reported in the function being lowered
+    LowerFrame* frames; // lower_expression's work stack, kept for the next expression
+    uint32_t frame_count;
+    uint32_t frame_capacity;
+} Lowerer;
+
+void lowerer_init(Lowerer* lw, const AST* ast, const Interner* names, int tail_calls);
+void lowerer_free(Lowerer* lw);
+
+// Lowers the AST_FUNCTION_DEF def into f, replacing what f held. Each
+// parameter becomes an IR_PARAM value that its name is bound to, in a scope
+// of the function's own that each block nests in. Operands are evaluated in
+// Sethi-Ullman order, so the values that are live at once stay few; a return
+// ends its block and whatever follows it is lowered into a block nothing
+// reaches. A body that falls off its end returns 0.
+// Returns 0, or -1 after reporting an undefined variable or a parameter
+// declared twice; f is then still well formed, with 0 for each bad name.
+int lower_function(Lowerer* lw, IrFunction* f, NodeId def);
+
+#endif
@@ -1,100 +1,242 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <unistd.h>
-#include "lexer.h"
-#include "parser.h"
-#include "codegen.h"
-#include "ast.h"
-
-
-int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <source_file.c>\n", argv[0]);
-        return 1;
-    }
-
-    // Read source code from file
-    FILE* fp = fopen(argv[1], "r");
-    if (!fp) {
-        fprintf(stderr, "Error: Could not open source file '%s'\n", argv[1]);
-        return 1;
-    }
-    fseek(fp, 0, SEEK_END);
-    long file_size = ftell(fp);
-    fseek(fp, 0, SEEK_SET);
-    char* source_code = (char*)malloc(file_size + 1);
-    if (!source_code) {
-        fprintf(stderr, "Memory allocation failed for source code.\n");
-        fclose(fp);
-        return 1;
-    }
-    fread(source_code, 1, file_size, fp);
-    source_code[file_size] = '\0';
-    fclose(fp);
-
-    printf("--- Source Code ---\n%s\n", source_code);
-
-    // Phase 1: Lexical Analysis
-    lexer_init(source_code);
-    printf("--- Lexing Initialized ---\n");
-
-    // Phase 2 & 3: Syntax Analysis and AST Construction
-    // The parser will call getNextToken internally.
-    // Advance once to get the first token for the parser.
-    advance(); 
-    ASTNode* program_ast = parse_program();
-    printf("--- Parsing and AST Construction Complete ---\n");
-    printf("--- Generated AST ---\n");
-    ast_print(program_ast, 0); // Print AST for verification
-
-    // Phase 4: Code Generation
-    printf("--- Generating Assembly Code ---\n");
-    
-    // Redirect stdout to a file for assembly output
-    FILE* assembly_fp = fopen("output.s", "w");
-    if (!assembly_fp) {
-        fprintf(stderr, "Error: Could not open output assembly file.\n");
-        ast_free(program_ast);
-        free(source_code);
-        return 1;
-    }
-    
-        // Temporarily redirect stdout to file
-        // Save the current stdout file descriptor
-    int original_stdout_fd = dup(fileno(stdout));
-    if (original_stdout_fd == -1) {
-        fprintf(stderr, "Error: Could not duplicate stdout file descriptor.\n");
-        ast_free(program_ast);
-        free(source_code);
-        fclose(assembly_fp);
-        return 1;
-    }
-
-    // Redirect stdout to the file
-    if (dup2(fileno(assembly_fp), fileno(stdout)) == -1) {
-        fprintf(stderr, "Error: Could not redirect stdout.\n");
-        ast_free(program_ast);
-        free(source_code);
-        fclose(assembly_fp);
-        close(original_stdout_fd);
-        return 1;
-    }
-
-    generate_code(program_ast);
-
-    // Flush and restore stdout
-    fflush(stdout);
-    dup2(original_stdout_fd, fileno(stdout));
-    close(original_stdout_fd);
-    fclose(assembly_fp);
-
-    printf("--- Assembly Code Generated to output.s ---\n");
-
-    // Clean up AST and source code memory
-    ast_free(program_ast);
-    free(source_code);
-
-    printf("Compilation successful!\n");
-    return 0;
-}
\ No newline at end of file
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "cache.h"
+#include "compiler.h"
+#include "optimize.h"
+#include "scan.h"
+#include "threadpool.h"
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [-O0 | -O1] [-c | --run | --emit-ir] [-o <output.s | ->] [-j <threads>]\n"
+                    "       [--inline-limit=<nodes>] [--inline-growth=<percent>] [--export=<name>[,<name>...]]\n"
+                    "       [--lex-only] [--prelex[=<threads>]] [--stats[=table|json] | --time-report]\n"
+                    "       [--cache-dir <dir>] [--cache-size <MiB>]\n"
+                    "       <source_file.c | -> [more.c ...]\n", program);
+}
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// With several inputs each foo.c is compiled to foo.s (or foo.o, foo.ir) next to it
+static char* output_path_for(const char* input_path, const char* extension) {
+    size_t length = strlen(input_path);
+    size_t extension_size = strlen(extension) + 1;
+    if (length > 2 && strcmp(input_path + length - 2, ".c") == 0) {
+        length -= 2;
+    }
+    char* path = (char*)malloc(length + extension_size);
+    if (!path) {
+        fprintf(stderr, "Memory allocation failed for output file name.\n");
+        exit(1);
+    }
+    memcpy(path, input_path, length);
+    memcpy(path + length, extension, extension_size);
+    return path;
+}
+
+// Evicts old entries if this run stored new ones, then reports the counters
+static void finish_cache(Cache* cache, FILE* log) {
+    if (!cache) return;
+    if (cache->stores > 0) cache_trim(cache);
+    fprintf(log, "--- Cache: %zu hits, %zu misses, %zu stored, %zu evicted ---\n",
+            cache->hits, cache->misses, cache->stores, cache->evictions);
+}
+
+// One compile_file call per input, spread over the thread pool
+typedef struct CompileJob {
+    const char** inputs;
+    char** outputs;
+    int* statuses;
+    const CompileOptions* options;
+} CompileJob;
+
+static void compile_one(void* context, size_t index) {
+    CompileJob* job = (CompileJob*)context;
+    job->statuses[index] = compile_file(job->inputs[index], job->outputs[index], job->options);
+}
+
+int main(int argc, char *argv[]) {
+    const char** inputs = (const char**)malloc(sizeof(const char*) * (argc > 1 ? argc : 1));
+    size_t input_count = 0;
+    const char* output_path = NULL;
+    int thread_count = 0; // 0: one per online CPU
+    const char* cache_dir = getenv("RAZANCOMPILER_CACHE_DIR");
+    unsigned long long cache_size = CACHE_DEFAULT_MAX_BYTES;
+    Cache cache;
+    CompileOptions options;
+    optimize_options_for_level(&options.optimize, 1);
+    options.lex_only = 0;
+    options.prelex = 0;
+    options.object = 0;
+    options.run = 0;
+    options.emit_ir = 0;
+    options.log = NULL;
+    options.stats = STATS_OFF;
+    options.cache = NULL;
+    if (!inputs) {
+        fprintf(stderr, "Memory allocation failed for input list.\n");
+        return 1;
+    }
+    for (int i = 1; i < argc; ++i) {
+        if (strncmp(argv[i], "-O", 2) == 0 && argv[i][2] >= '0' && argv[i][2] <= '9' && argv[i][3] == '\0') {
+            optimize_options_for_level(&options.optimize, argv[i][2] - '0');
+        } else if (strncmp(argv[i], "--inline-limit=", 15) == 0) {
+            if (atoi(argv[i] + 15) < 0) {
+                fprintf(stderr, "Error: --inline-limit= needs a node count of at least 0.\n");
+                return 1;
+            }
+            options.optimize.inline_limit = atoi(argv[i] + 15);
+        } else if (strncmp(argv[i], "--inline-growth=", 16) == 0) {
+            if (atoi(argv[i] + 16) < 0) {
+                fprintf(stderr, "Error: --inline-growth= needs a percentage of at least 0.\n");
+                return 1;
+            }
+            options.optimize.inline_growth = atoi(argv[i] + 16);
+        } else if (strncmp(argv[i], "--export=", 9) == 0) {
+            options.optimize.exports = argv[i] + 9;
+        } else if (strcmp(argv[i], "-c") == 0) {
+            options.object = 1;
+        } else if (strcmp(argv[i], "--run") == 0) {
+            options.run = 1;
+        } else if (strcmp(argv[i], "--emit-ir") == 0) {
+            options.emit_ir = 1;
+        } else if (strcmp(argv[i], "--lex-only") == 0) {
+            options.lex_only = 1;
+        } else if (strcmp(argv[i], "--prelex") == 0) {
+            options.prelex = threadpool_cpu_count();
+        } else if (strncmp(argv[i], "--prelex=", 9) == 0) {
+            if (atoi(argv[i] + 9) < 1) {
+                fprintf(stderr, "Error: --prelex= needs a thread count of at least 1.\n");
+                return 1;
+            }
+            options.prelex = atoi(argv[i] + 9);
+        } else if (strcmp(argv[i], "--stats") == 0 || strcmp(argv[i], "--stats=table") == 0 ||
+                   strcmp(argv[i], "--time-report") == 0) {
+            options.stats = STATS_TABLE;
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            options.stats = STATS_JSON;
+        } else if (strcmp(argv[i], "-o") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: -o needs an output file name.\n");
+                return 1;
+            }
+            output_path = argv[++i];
+        } else if (strcmp(argv[i], "--cache-dir") == 0) {
+            if (i + 1 >= argc) {
+                fprintf(stderr, "Error: --cache-dir needs a directory.\n");
+                return 1;
+            }
+            cache_dir = argv[++i];
+        } else if (strcmp(argv[i], "--cache-size") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+                fprintf(stderr, "Error: --cache-size needs a size in MiB of at least 1.\n");
+                return 1;
+            }
+            cache_size = (unsigned long long)atoi(argv[++i]) * 1024 * 1024;
+        } else if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc || atoi(argv[i + 1]) < 1) {
+                fprintf(stderr, "Error: -j needs a thread count of at least 1.\n");
+                return 1;
+            }
+            thread_count = atoi(argv[++i]);
+        } else if (argv[i][0] == '-' && argv[i][1] != '\0') {
+            fprintf(stderr, "Error: Unknown option '%s'\n", argv[i]);
+            print_usage(argv[0]);
+            return 1;
+        } else {
+            inputs[input_count++] = argv[i];
+        }
+    }
+    if (input_count == 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
+    if (options.emit_ir && (options.object || options.run)) {
+        fprintf(stderr, "Error: --emit-ir cannot be combined with -c or --run.\n");
+        return 1;
+    }
+    scan_init(); // picks the SIMD scanner once, before any worker thread starts
+    if (cache_dir && cache_dir[0] && !options.run && !options.lex_only) {
+        if (cache_open(&cache, cache_dir, cache_size) != 0) return 1;
+        options.cache = &cache;
+    }
+
+    if (options.run) {
+        // --run: main's return value becomes our exit status, as if the
+        // program had been built and run
+        if (input_count != 1 || output_path || options.object) {
+            fprintf(stderr, "Error: --run takes exactly one input file and no -o or -c.\n");
+            return 1;
+        }
+        options.log = stdout;
+        int result;
+        int status = run_file(inputs[0], &options, &result);
+        free(inputs);
+        return status == 0 ? result : status;
+    }
+
+    if (input_count == 1) {
+        if (!output_path) output_path = options.object ? "output.o" : options.emit_ir ? "output.ir" : "output.s";
+        // With "-o -" the assembly owns stdout, so progress messages move to stderr
+        FILE* log = strcmp(output_path, "-") == 0 ? stderr : stdout;
+        options.log = log;
+        int status = compile_file(inputs[0], output_path, &options);
+        finish_cache(options.cache, log);
+        if (status == 0 && !options.lex_only) {
+            fprintf(log, "Compilation successful!\n");
+        }
+        free(inputs);
+        return status;
+    }
+
+    // Several inputs: compile them in parallel, each to its own .s, .o or .ir file
+    if (output_path) {
+        fprintf(stderr, "Error: -o cannot be used with more than one input file.\n");
+        return 1;
+    }
+    for (size_t i = 0; i < input_count; ++i) {
+        if (strcmp(inputs[i], "-") == 0) {
+            fprintf(stderr, "Error: stdin ('-') can only be compiled on its own.\n");
+            return 1;
+        }
+    }
+    if (thread_count == 0) thread_count = threadpool_cpu_count();
+    if ((size_t)thread_count > input_count) thread_count = (int)input_count;
+
+    char** outputs = (char**)malloc(sizeof(char*) * input_count);
+    int* statuses = (int*)calloc(input_count, sizeof(int));
+    if (!outputs || !statuses) {
+        fprintf(stderr, "Memory allocation failed for output list.\n");
+        return 1;
+    }
+    for (size_t i = 0; i < input_count; ++i) {
+        outputs[i] = output_path_for(inputs[i], options.object ? ".o" : options.emit_ir ? ".ir" : ".s");
+    }
+
+    CompileJob job = {inputs, outputs, statuses, &options};
+    double start = now_seconds();
+    parallel_for(input_count, thread_count, compile_one, &job);
+    double elapsed = now_seconds() - start;
+
+    size_t failed = 0;
+    for (size_t i = 0; i < input_count; ++i) {
+        if (statuses[i] != 0) failed++;
+        free(outputs[i]);
+    }
+    if (!options.lex_only) {
+        printf("--- Compiled %zu of %zu files on %d threads in %.3f ms ---\n",
+               input_count - failed, input_count, thread_count, elapsed * 1e3);
+    }
+    finish_cache(options.cache, stdout);
+    free(outputs);
+    free(statuses);
+    free(inputs);
+    if (failed > 0) return 1;
+    if (!options.lex_only) printf("Compilation successful!\n");
+    return 0;
+}
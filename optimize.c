@@ -0,0 +1,729 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "optimize.h"
+
+// State for one optimize_program call
+typedef struct Optimizer {
+    AST* ast;
+    size_t simplifications;
+    SymbolId current_function; // for diagnostics
+    size_t errors;
+    const Interner* names;
+    const OptimizeOptions* options;
+    NodeId program;
+    // Inlining
+    uint32_t* function_of;  // by SymbolId: index of its definition in program + 1, 0 if not defined here
+    uint8_t* inlinable;     // by function index: on no call cycle, and defined once
+    uint32_t* first_edge;   // by function index, from the call graph: its calls to functions defined here
+    uint32_t* uses;         // by parameter index, scratch for one call site
+    NodeId copied_after;    // nodes with larger ids were copied in by the inliner
+    long long budget;       // AST nodes inlining may still add
+    size_t inlined_calls;
+    size_t inline_growth;
+    // Dead code elimination
+    uint8_t* reachable;     // by function index: called, directly or not, from main or an export
+    uint8_t* pure;          // by function index: calling it has no effect besides the value returned
+    size_t removed_functions;
+    size_t removed_statements;
+} Optimizer;
+
+void optimize_options_for_level(OptimizeOptions* options, int level) {
+    options->fold_constants = level > 0;
+    options->peephole = level > 0;
+    options->strength_reduce = level > 0;
+    options->inline_limit = level > 0 ? 40 : 0;
+    options->inline_growth = 100;
+    options->eliminate_dead_code = level > 0;
+    options->tail_calls = level > 0;
+    options->exports = NULL;
+}
+
+static void* allocate(size_t count, size_t size) {
+    void* items = calloc(count ? count : 1, size);
+    if (!items) {
+        fprintf(stderr, "Memory allocation failed for the optimizer.\n");
+        exit(1);
+    }
+    return items;
+}
+
+// Expressions without calls can be dropped or duplicated freely
+static int is_pure(const AST* ast, NodeId node) {
+    switch (ast_kind(ast, node)) {
+        case AST_NUMBER:
+        case AST_IDENTIFIER:
+            return 1;
+        case AST_BINARY_OP:
+            return is_pure(ast, ast_left(ast, node)) && is_pure(ast, ast_right(ast, node));
+        default:
+            return 0;
+    }
+}
+
+static int same_expression(const AST* ast, NodeId a, NodeId b) {
+    if (ast_kind(ast, a) != ast_kind(ast, b)) return 0;
+    switch (ast_kind(ast, a)) {
+        case AST_NUMBER:
+            return ast_number_value(ast, a) == ast_number_value(ast, b);
+        case AST_IDENTIFIER:
+            return ast_name(ast, a) == ast_name(ast, b);
+        case AST_BINARY_OP:
+            return ast_binary_op(ast, a) == ast_binary_op(ast, b) &&
+                   same_expression(ast, ast_left(ast, a), ast_left(ast, b)) &&
+                   same_expression(ast, ast_right(ast, a), ast_right(ast, b));
+        default:
+            return 0;
+    }
+}
+
+static int is_number(const AST* ast, NodeId node, int value) {
+    return ast_kind(ast, node) == AST_NUMBER && ast_number_value(ast, node) == value;
+}
+
+// Turns node into a constant in place (the dropped children stay unreferenced in the arrays)
+static NodeId make_number(Optimizer* opt, NodeId node, int value) {
+    ast_set_number(opt->ast, node, value);
+    opt->simplifications++;
+    return node;
+}
+
+// int arithmetic with two's complement wrap-around, computed in uint32_t so the
+// compiler itself never hits signed overflow
+static int fold_binary(TokenType op, int left, int right) {
+    uint32_t l = (uint32_t)left, r = (uint32_t)right;
+    switch (op) {
+        case TOKEN_PLUS: return (int)(l + r);
+        case TOKEN_MINUS: return (int)(l - r);
+        case TOKEN_MULTIPLY: return (int)(l * r);
+        case TOKEN_DIVIDE:
+            if (left == INT32_MIN && right == -1) return INT32_MIN; // wraps instead of trapping
+            return left / right; // C division truncates toward zero
+        default:
+            fprintf(stderr, "Optimization Error: Unknown binary operator.\n");
+            exit(1);
+    }
+}
+
+static NodeId fold_expression(Optimizer* opt, NodeId node) {
+    AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_BINARY_OP: {
+            NodeId left = fold_expression(opt, ast_left(ast, node));
+            NodeId right = fold_expression(opt, ast_right(ast, node));
+            ast_set_left(ast, node, left);
+            ast_set_right(ast, node, right);
+            TokenType op = ast_binary_op(ast, node);
+
+            if (op == TOKEN_DIVIDE && is_number(ast, right, 0)) {
+                if (node > opt->copied_after || right > opt->copied_after) return node; // the call would trap here too
+                fprintf(stderr, "Optimization Error: Division by constant zero in function '%.*s'.\n",
+                        (int)symbol_length(opt->names, opt->current_function),
+                        symbol_text(opt->names, opt->current_function));
+                opt->errors++;
+                return node;
+            }
+            if (ast_kind(ast, left) == AST_NUMBER && ast_kind(ast, right) == AST_NUMBER) {
+                return make_number(opt, node, fold_binary(op, ast_number_value(ast, left), ast_number_value(ast, right)));
+            }
+            switch (op) {
+                case TOKEN_PLUS:
+                    if (is_number(ast, right, 0)) { opt->simplifications++; return left; }  // x + 0
+                    if (is_number(ast, left, 0)) { opt->simplifications++; return right; }  // 0 + x
+                    break;
+                case TOKEN_MINUS:
+                    if (is_number(ast, right, 0)) { opt->simplifications++; return left; }  // x - 0
+                    if (is_pure(ast, left) && same_expression(ast, left, right)) return make_number(opt, node, 0); // x - x
+                    break;
+                case TOKEN_MULTIPLY:
+                    if (is_number(ast, right, 1)) { opt->simplifications++; return left; }  // x * 1
+                    if (is_number(ast, left, 1)) { opt->simplifications++; return right; }  // 1 * x
+                    if ((is_number(ast, right, 0) && is_pure(ast, left)) ||
+                        (is_number(ast, left, 0) && is_pure(ast, right))) return make_number(opt, node, 0); // x * 0
+                    break;
+                case TOKEN_DIVIDE:
+                    if (is_number(ast, right, 1)) { opt->simplifications++; return left; }  // x / 1
+                    break;
+                default:
+                    break;
+            }
+            return node;
+        }
+        case AST_FUNCTION_CALL: {
+            NodeId args = ast_call_args(ast, node);
+            for (uint32_t i = 0; i < ast_list_count(ast, args); ++i) {
+                ast_set_list_item(ast, args, i, fold_expression(opt, ast_list_item(ast, args, i)));
+            }
+            return node;
+        }
+        default:
+            return node;
+    }
+}
+
+static void fold_statement(Optimizer* opt, NodeId node) {
+    AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_RETURN_STMT:
+        case AST_EXPRESSION_STMT:
+            ast_set_expr(ast, node, fold_expression(opt, ast_expr(ast, node)));
+            break;
+        case AST_BLOCK:
+            for (uint32_t i = 0; i < ast_list_count(ast, node); ++i) {
+                fold_statement(opt, ast_list_item(ast, node, i));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Inlining. A call to a function whose body starts with `return <expr>;` is
+// replaced by a copy of <expr> with the arguments put in place of the
+// parameters, when the callee is small (inline_limit), is on no call cycle,
+// and the program's growth stays within budget (inline_growth). Functions are
+// visited callees first, so a callee has had its own calls inlined and its
+// constants folded by the time it is measured and copied, and calls with
+// constant arguments fold away completely in the caller.
+
+// The calls between the functions of the program, by function index
+typedef struct CallGraph {
+    uint32_t function_count;
+    uint32_t* first_edge; // function i calls edges[first_edge[i] .. first_edge[i + 1])
+    uint32_t* edges;
+    uint32_t edge_count;
+    uint32_t edge_capacity;
+} CallGraph;
+
+// The parser creates a function's nodes before its AST_FUNCTION_DEF node, so
+// the ids between two definitions belong to the later one: one pass over
+// the kind array finds every call without walking the trees.
+static void build_call_graph(Optimizer* opt, CallGraph* graph) {
+    const AST* ast = opt->ast;
+    uint32_t count = ast_list_count(ast, opt->program);
+    graph->function_count = count;
+    graph->first_edge = (uint32_t*)allocate(count + 1, sizeof(uint32_t));
+    graph->edges = NULL;
+    graph->edge_count = 0;
+    graph->edge_capacity = 0;
+    NodeId node = 1;
+    for (uint32_t i = 0; i < count; ++i) {
+        NodeId def = ast_list_item(ast, opt->program, i);
+        graph->first_edge[i] = graph->edge_count;
+        for (; node < def; ++node) {
+            if (ast_kind(ast, node) != AST_FUNCTION_CALL) continue;
+            uint32_t callee = opt->function_of[ast_name(ast, node)];
+            if (callee == 0) continue; // defined elsewhere
+            if (graph->edge_count == graph->edge_capacity) {
+                graph->edge_capacity = graph->edge_capacity ? graph->edge_capacity * 2 : 64;
+                graph->edges = (uint32_t*)realloc(graph->edges, graph->edge_capacity * sizeof(uint32_t));
+                if (!graph->edges) {
+                    fprintf(stderr, "Memory allocation failed for the call graph.\n");
+                    exit(1);
+                }
+            }
+            graph->edges[graph->edge_count++] = callee - 1;
+        }
+        node = def + 1;
+    }
+    graph->first_edge[count] = graph->edge_count;
+}
+
+// Returns the functions callees first, the order in which Tarjan's algorithm
+// completes strongly connected components, and clears inlinable for every
+// function on a call cycle. The depth-first search keeps its own stack, so
+// long call chains cannot overflow the native one.
+static uint32_t* order_callees_first(Optimizer* opt, const CallGraph* graph) {
+    const uint32_t unvisited = UINT32_MAX;
+    uint32_t count = graph->function_count;
+    uint32_t* order = (uint32_t*)allocate(count, sizeof(uint32_t));
+    uint32_t* index = (uint32_t*)allocate(count, sizeof(uint32_t));
+    uint32_t* low = (uint32_t*)allocate(count, sizeof(uint32_t));
+    uint32_t* next_edge = (uint32_t*)allocate(count, sizeof(uint32_t));
+    uint32_t* path = (uint32_t*)allocate(count, sizeof(uint32_t));      // the search's call stack
+    uint32_t* component = (uint32_t*)allocate(count, sizeof(uint32_t)); // Tarjan's stack
+    uint8_t* on_component = (uint8_t*)allocate(count, 1);
+    uint32_t ordered = 0, visited = 0, path_depth = 0, component_depth = 0;
+
+    for (uint32_t i = 0; i < count; ++i) index[i] = unvisited;
+    for (uint32_t root = 0; root < count; ++root) {
+        if (index[root] != unvisited) continue;
+        uint32_t v = root;
+        for (;;) {
+            if (index[v] == unvisited) {
+                index[v] = low[v] = visited++;
+                next_edge[v] = graph->first_edge[v];
+                component[component_depth++] = v;
+                on_component[v] = 1;
+                path[path_depth++] = v;
+            }
+            v = path[path_depth - 1];
+            if (next_edge[v] < graph->first_edge[v + 1]) {
+                uint32_t w = graph->edges[next_edge[v]++];
+                if (w == v) opt->inlinable[v] = 0; // calls itself
+                if (index[w] == unvisited) {
+                    v = w;
+                } else if (on_component[w] && index[w] < low[v]) {
+                    low[v] = index[w];
+                }
+                continue;
+            }
+            // Every callee of v is done
+            path_depth--;
+            if (low[v] == index[v]) {
+                uint32_t first = ordered;
+                uint32_t w;
+                do {
+                    w = component[--component_depth];
+                    on_component[w] = 0;
+                    order[ordered++] = w;
+                } while (w != v);
+                if (ordered - first > 1) {
+                    for (uint32_t k = first; k < ordered; ++k) opt->inlinable[order[k]] = 0;
+                }
+            }
+            if (path_depth == 0) break;
+            uint32_t caller = path[path_depth - 1];
+            if (low[v] < low[caller]) low[caller] = low[v];
+            v = caller;
+        }
+    }
+    free(index);
+    free(low);
+    free(next_edge);
+    free(path);
+    free(component);
+    free(on_component);
+    return order;
+}
+
+// Number of nodes in the expression, or cap + 1 once it is larger than cap
+static size_t expression_size(const AST* ast, NodeId node, size_t cap) {
+    switch (ast_kind(ast, node)) {
+        case AST_BINARY_OP: {
+            size_t size = 1 + expression_size(ast, ast_left(ast, node), cap);
+            if (size > cap) return cap + 1;
+            size += expression_size(ast, ast_right(ast, node), cap - size);
+            return size > cap ? cap + 1 : size;
+        }
+        case AST_FUNCTION_CALL: {
+            NodeId args = ast_call_args(ast, node);
+            size_t size = 2; // the call and its argument list
+            for (uint32_t i = 0; i < ast_list_count(ast, args) && size <= cap; ++i) {
+                size += expression_size(ast, ast_list_item(ast, args, i), cap - size);
+            }
+            return size > cap ? cap + 1 : size;
+        }
+        default:
+            return 1;
+    }
+}
+
+static int parameter_index(const AST* ast, NodeId params, SymbolId name) {
+    for (uint32_t i = 0; i < ast_list_count(ast, params); ++i) {
+        if (ast_name(ast, ast_list_item(ast, params, i)) == name) return (int)i;
+    }
+    return -1;
+}
+
+// Counts how often each parameter is read into opt->uses. Returns 0 if the
+// expression names anything else, which would mean something different in
+// the caller.
+static int count_parameter_uses(Optimizer* opt, NodeId node, NodeId params) {
+    const AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_IDENTIFIER: {
+            int i = parameter_index(ast, params, ast_name(ast, node));
+            if (i < 0) return 0;
+            opt->uses[i]++;
+            return 1;
+        }
+        case AST_BINARY_OP:
+            return count_parameter_uses(opt, ast_left(ast, node), params) &&
+                   count_parameter_uses(opt, ast_right(ast, node), params);
+        case AST_FUNCTION_CALL: {
+            NodeId args = ast_call_args(ast, node);
+            for (uint32_t i = 0; i < ast_list_count(ast, args); ++i) {
+                if (!count_parameter_uses(opt, ast_list_item(ast, args, i), params)) return 0;
+            }
+            return 1;
+        }
+        default:
+            return 1;
+    }
+}
+
+// Copy of node with copies of args in place of params (NODE_NONE for a
+// plain copy). Arguments are copied too, so every node the inliner puts in
+// place has an id above copied_after.
+static NodeId copy_expression(Optimizer* opt, NodeId node, NodeId params, NodeId args) {
+    AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_NUMBER:
+            return ast_new_number(ast, ast_number_value(ast, node));
+        case AST_IDENTIFIER: {
+            int i = params == NODE_NONE ? -1 : parameter_index(ast, params, ast_name(ast, node));
+            if (i < 0) return ast_new_identifier(ast, ast_name(ast, node));
+            return copy_expression(opt, ast_list_item(ast, args, (uint32_t)i), NODE_NONE, NODE_NONE);
+        }
+        case AST_BINARY_OP: {
+            NodeId left = copy_expression(opt, ast_left(ast, node), params, args);
+            NodeId right = copy_expression(opt, ast_right(ast, node), params, args);
+            return ast_new_binary_op(ast, ast_binary_op(ast, node), left, right);
+        }
+        case AST_FUNCTION_CALL: {
+            NodeId call_args = ast_call_args(ast, node);
+            ASTNodeList list = ast_new_node_list(ast);
+            for (uint32_t i = 0; i < ast_list_count(ast, call_args); ++i) {
+                ast_node_list_add(ast, &list, copy_expression(opt, ast_list_item(ast, call_args, i), params, args));
+            }
+            return ast_new_function_call(ast, ast_name(ast, node), ast_new_arg_list(ast, &list));
+        }
+        default:
+            fprintf(stderr, "Optimization Error: Unexpected AST node type in inlined expression: %d\n",
+                    ast_kind(ast, node));
+            exit(1);
+    }
+}
+
+// The expression a call to def can be replaced with, or NODE_NONE
+static NodeId returned_expression(const AST* ast, NodeId def) {
+    NodeId body = ast_body(ast, def);
+    if (ast_list_count(ast, body) == 0) return NODE_NONE;
+    NodeId first = ast_list_item(ast, body, 0);
+    return ast_kind(ast, first) == AST_RETURN_STMT ? ast_expr(ast, first) : NODE_NONE;
+}
+
+// Returns what replaces call: the callee's expression, or call itself when
+// the cost model says no
+static NodeId inline_call(Optimizer* opt, NodeId call) {
+    AST* ast = opt->ast;
+    uint32_t callee = opt->function_of[ast_name(ast, call)];
+    if (callee == 0 || !opt->inlinable[callee - 1]) return call;
+    NodeId def = ast_list_item(ast, opt->program, callee - 1);
+    NodeId expr = returned_expression(ast, def);
+    NodeId params = ast_params(ast, def);
+    NodeId args = ast_call_args(ast, call);
+    uint32_t count = ast_list_count(ast, params);
+    if (expr == NODE_NONE || ast_list_count(ast, args) != count) return call;
+    size_t limit = (size_t)opt->options->inline_limit;
+    size_t size = expression_size(ast, expr, limit);
+    if (size > limit) return call;
+    memset(opt->uses, 0, count * sizeof(uint32_t));
+    if (!count_parameter_uses(opt, expr, params)) return call;
+
+    // An argument with a call in it must run exactly once, and before any
+    // call of the callee's own, so it may only stand for a parameter read
+    // once in a call-free expression. Pure ones may be dropped or repeated.
+    // Growth: the copied expression, plus the argument subtrees that get
+    // repeated, minus the call, its argument list and the arguments dropped.
+    int callee_pure = is_pure(ast, expr);
+    long long growth = (long long)size - 2;
+    for (uint32_t i = 0; i < count; ++i) {
+        NodeId arg = ast_list_item(ast, args, i);
+        int arg_pure = is_pure(ast, arg);
+        if (opt->uses[i] == 1) {
+            if (!arg_pure && !callee_pure) return call;
+        } else {
+            if (!arg_pure) return call;
+            growth += ((long long)opt->uses[i] - 1) * (long long)expression_size(ast, arg, SIZE_MAX);
+        }
+        growth -= opt->uses[i];
+    }
+    if (growth > opt->budget) return call;
+    if (growth > 0) {
+        opt->budget -= growth;
+        opt->inline_growth += (size_t)growth;
+    }
+    opt->inlined_calls++;
+    return copy_expression(opt, expr, params, args);
+}
+
+static NodeId inline_expression(Optimizer* opt, NodeId node) {
+    AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_BINARY_OP:
+            ast_set_left(ast, node, inline_expression(opt, ast_left(ast, node)));
+            ast_set_right(ast, node, inline_expression(opt, ast_right(ast, node)));
+            return node;
+        case AST_FUNCTION_CALL: {
+            NodeId args = ast_call_args(ast, node);
+            for (uint32_t i = 0; i < ast_list_count(ast, args); ++i) {
+                ast_set_list_item(ast, args, i, inline_expression(opt, ast_list_item(ast, args, i)));
+            }
+            return inline_call(opt, node);
+        }
+        default:
+            return node;
+    }
+}
+
+static void inline_statement(Optimizer* opt, NodeId node) {
+    AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_RETURN_STMT:
+        case AST_EXPRESSION_STMT:
+            ast_set_expr(ast, node, inline_expression(opt, ast_expr(ast, node)));
+            break;
+        case AST_BLOCK:
+            for (uint32_t i = 0; i < ast_list_count(ast, node); ++i) {
+                inline_statement(opt, ast_list_item(ast, node, i));
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Dead code elimination. The roots are main and the exported functions, and
+// everything they call, directly or not, is kept; a program with neither is
+// a library and keeps every function. Reachability is taken from the call
+// graph before inlining, so functions that will be dropped are not optimized,
+// and again from the trees at the end, when calls that were inlined no longer
+// count. In between, each function loses the statements after its first
+// return and the expression statements that do nothing. Those are judged
+// callees first, and a function whose statements all do nothing but compute
+// its return value is pure: calls to it do nothing either.
+
+static int is_root(const Optimizer* opt, SymbolId name) {
+    const char* text = symbol_text(opt->names, name);
+    size_t length = symbol_length(opt->names, name);
+    if (length == 4 && memcmp(text, "main", 4) == 0) return 1;
+    for (const char* export = opt->options->exports; export && *export;) {
+        const char* comma = strchr(export, ',');
+        size_t export_length = comma ? (size_t)(comma - export) : strlen(export);
+        if (export_length == length && memcmp(export, text, length) == 0) return 1;
+        export = comma ? comma + 1 : NULL;
+    }
+    return 0;
+}
+
+// Resets reachable to the roots and puts them on stack. Returns how many
+// there are; with none, every function is marked instead.
+static uint32_t mark_roots(Optimizer* opt, uint32_t* stack) {
+    uint32_t count = ast_list_count(opt->ast, opt->program);
+    uint32_t depth = 0;
+    memset(opt->reachable, 0, count);
+    for (uint32_t i = 0; i < count; ++i) {
+        SymbolId name = ast_name(opt->ast, ast_list_item(opt->ast, opt->program, i));
+        if (opt->function_of[name] != i + 1 || !is_root(opt, name)) continue;
+        opt->reachable[i] = 1;
+        stack[depth++] = i;
+    }
+    if (depth == 0) memset(opt->reachable, 1, count);
+    return depth;
+}
+
+static void mark_reachable_in_graph(Optimizer* opt, const CallGraph* graph) {
+    uint32_t* stack = (uint32_t*)allocate(graph->function_count, sizeof(uint32_t));
+    uint32_t depth = mark_roots(opt, stack);
+    while (depth > 0) {
+        uint32_t function = stack[--depth];
+        for (uint32_t e = graph->first_edge[function]; e < graph->first_edge[function + 1]; ++e) {
+            uint32_t callee = graph->edges[e];
+            if (opt->reachable[callee]) continue;
+            opt->reachable[callee] = 1;
+            stack[depth++] = callee;
+        }
+    }
+    free(stack);
+}
+
+// Marks the functions called in the tree at node and puts them on stack
+static void mark_calls(Optimizer* opt, NodeId node, uint32_t* stack, uint32_t* depth) {
+    const AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_BINARY_OP:
+            mark_calls(opt, ast_left(ast, node), stack, depth);
+            mark_calls(opt, ast_right(ast, node), stack, depth);
+            break;
+        case AST_FUNCTION_CALL: {
+            NodeId args = ast_call_args(ast, node);
+            uint32_t callee = opt->function_of[ast_name(ast, node)];
+            for (uint32_t i = 0; i < ast_list_count(ast, args); ++i) {
+                mark_calls(opt, ast_list_item(ast, args, i), stack, depth);
+            }
+            if (callee != 0 && !opt->reachable[callee - 1]) {
+                opt->reachable[callee - 1] = 1;
+                stack[(*depth)++] = callee - 1;
+            }
+            break;
+        }
+        case AST_RETURN_STMT:
+        case AST_EXPRESSION_STMT:
+            mark_calls(opt, ast_expr(ast, node), stack, depth);
+            break;
+        case AST_BLOCK:
+            for (uint32_t i = 0; i < ast_list_count(ast, node); ++i) {
+                mark_calls(opt, ast_list_item(ast, node, i), stack, depth);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Drops the functions nothing reachable calls any more from the program list.
+// A second definition of a name goes with the first, so the assembler still
+// sees both.
+static void remove_unreachable_functions(Optimizer* opt) {
+    AST* ast = opt->ast;
+    uint32_t count = ast_list_count(ast, opt->program);
+    uint32_t* stack = (uint32_t*)allocate(count, sizeof(uint32_t));
+    uint32_t depth = mark_roots(opt, stack);
+    while (depth > 0) {
+        uint32_t function = stack[--depth];
+        mark_calls(opt, ast_body(ast, ast_list_item(ast, opt->program, function)), stack, &depth);
+    }
+    free(stack);
+    uint32_t kept = 0;
+    for (uint32_t i = 0; i < count; ++i) {
+        NodeId def = ast_list_item(ast, opt->program, i);
+        if (!opt->reachable[opt->function_of[ast_name(ast, def)] - 1]) {
+            opt->removed_functions++;
+            continue;
+        }
+        ast_set_list_item(ast, opt->program, kept++, def);
+    }
+    ast_set_list_count(ast, opt->program, kept);
+}
+
+// Whether evaluating node can do anything but produce its value: call a
+// function that is not known to be pure, or divide by something that may be
+// zero
+static int has_effect(const Optimizer* opt, NodeId node) {
+    const AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_BINARY_OP: {
+            NodeId right = ast_right(ast, node);
+            if (ast_binary_op(ast, node) == TOKEN_DIVIDE &&
+                (ast_kind(ast, right) != AST_NUMBER || ast_number_value(ast, right) == 0)) return 1;
+            return has_effect(opt, ast_left(ast, node)) || has_effect(opt, right);
+        }
+        case AST_FUNCTION_CALL: {
+            NodeId args = ast_call_args(ast, node);
+            uint32_t callee = opt->function_of[ast_name(ast, node)];
+            if (callee == 0 || !opt->pure[callee - 1]) return 1;
+            for (uint32_t i = 0; i < ast_list_count(ast, args); ++i) {
+                if (has_effect(opt, ast_list_item(ast, args, i))) return 1;
+            }
+            return 0;
+        }
+        default:
+            return 0;
+    }
+}
+
+// Removes the statements after a return and the expression statements
+// without effect. Returns whether the block always returns.
+static int remove_dead_statements(Optimizer* opt, NodeId block) {
+    AST* ast = opt->ast;
+    uint32_t kept = 0;
+    int returns = 0;
+    for (uint32_t i = 0; i < ast_list_count(ast, block); ++i) {
+        NodeId stmt = ast_list_item(ast, block, i);
+        if (returns || (ast_kind(ast, stmt) == AST_EXPRESSION_STMT && !has_effect(opt, ast_expr(ast, stmt)))) {
+            opt->removed_statements++;
+            continue;
+        }
+        if (ast_kind(ast, stmt) == AST_RETURN_STMT) returns = 1;
+        if (ast_kind(ast, stmt) == AST_BLOCK) returns = remove_dead_statements(opt, stmt);
+        ast_set_list_item(ast, block, kept++, stmt);
+    }
+    ast_set_list_count(ast, block, kept);
+    return returns;
+}
+
+static int statements_have_effect(const Optimizer* opt, NodeId node) {
+    const AST* ast = opt->ast;
+    switch (ast_kind(ast, node)) {
+        case AST_RETURN_STMT:
+        case AST_EXPRESSION_STMT:
+            return has_effect(opt, ast_expr(ast, node));
+        case AST_BLOCK:
+            for (uint32_t i = 0; i < ast_list_count(ast, node); ++i) {
+                if (statements_have_effect(opt, ast_list_item(ast, node, i))) return 1;
+            }
+            return 0;
+        default:
+            return 1;
+    }
+}
+
+// Sets up function_of, inlinable, reachable and the scratch arrays. Returns
+// the order to visit the functions in.
+static uint32_t* prepare_call_graph(Optimizer* opt) {
+    const AST* ast = opt->ast;
+    uint32_t count = ast_list_count(ast, opt->program);
+    uint32_t max_params = 0;
+    opt->function_of = (uint32_t*)allocate(opt->names->symbol_count + 1, sizeof(uint32_t));
+    opt->inlinable = (uint8_t*)allocate(count, 1);
+    for (uint32_t i = 0; i < count; ++i) {
+        NodeId def = ast_list_item(ast, opt->program, i);
+        SymbolId name = ast_name(ast, def);
+        uint32_t params = ast_list_count(ast, ast_params(ast, def));
+        if (params > max_params) max_params = params;
+        if (opt->function_of[name]) {
+            opt->inlinable[opt->function_of[name] - 1] = 0; // defined twice: leave it to the assembler
+            continue;
+        }
+        opt->function_of[name] = i + 1;
+        opt->inlinable[i] = 1;
+    }
+    opt->uses = (uint32_t*)allocate(max_params, sizeof(uint32_t));
+
+    CallGraph graph;
+    build_call_graph(opt, &graph);
+    uint32_t* order = order_callees_first(opt, &graph);
+    if (opt->options->eliminate_dead_code) {
+        opt->reachable = (uint8_t*)allocate(count, 1);
+        opt->pure = (uint8_t*)allocate(count, 1);
+        mark_reachable_in_graph(opt, &graph);
+    }
+    opt->first_edge = graph.first_edge;
+    free(graph.edges);
+    return order;
+}
+
+int optimize_program(AST* ast, NodeId program, const Interner* names, const OptimizeOptions* options,
+                     OptimizeReport* report) {
+    Optimizer state = {ast, 0, SYMBOL_NONE, 0, names, options, program, NULL, NULL, NULL, NULL, ast->node_count,
+                       (long long)ast->node_count * options->inline_growth / 100, 0, 0, NULL, NULL, 0, 0};
+    Optimizer* opt = &state;
+    int inlining = options->inline_limit > 0;
+    int eliminating = options->eliminate_dead_code;
+    uint32_t* order = inlining || eliminating ? prepare_call_graph(opt) : NULL;
+
+    if (inlining || eliminating || options->fold_constants) {
+        for (uint32_t i = 0; i < ast_list_count(ast, program); ++i) {
+            uint32_t function = order ? order[i] : i;
+            NodeId func_def = ast_list_item(ast, program, function);
+            NodeId body = ast_body(ast, func_def);
+            if (eliminating && !opt->reachable[function]) continue;
+            opt->current_function = ast_name(ast, func_def);
+            if (inlining && opt->first_edge[function] != opt->first_edge[function + 1]) {
+                inline_statement(opt, body);
+            }
+            if (options->fold_constants) fold_statement(opt, body);
+            if (eliminating) {
+                remove_dead_statements(opt, body);
+                opt->pure[function] = opt->inlinable[function] && !statements_have_effect(opt, body);
+            }
+        }
+    }
+    if (eliminating) remove_unreachable_functions(opt);
+    free(order);
+    free(opt->function_of);
+    free(opt->inlinable);
+    free(opt->first_edge);
+    free(opt->uses);
+    free(opt->reachable);
+    free(opt->pure);
+    report->simplifications = opt->simplifications;
+    report->inlined_calls = opt->inlined_calls;
+    report->inline_growth = opt->inline_growth;
+    report->removed_functions = opt->removed_functions;
+    report->removed_statements = opt->removed_statements;
+    return opt->errors ? -1 : 0;
+}
@@ -0,0 +1,39 @@
+#ifndef OPTIMIZE_H
+#define OPTIMIZE_H
+
+#include "ast.h"
+
+// AST-level optimizations run between parse_program and generate_code, and
+// the switches for those done by the code generator and emitter
+typedef struct OptimizeOptions {
+    int fold_constants;  // fold constant arithmetic and apply algebraic identities
+    int peephole;        // rewrite the emitted instructions (see peephole.h)
+    int strength_reduce; // multiply and divide by constants with shifts, lea and multiply-high
+    int inline_limit;    // largest callee inlined, in AST nodes of its return expression; 0: no inlining
+    int inline_growth;   // percent by which inlining may grow the program's AST
+    int eliminate_dead_code; // drop functions main cannot reach and statements that do nothing
+    int tail_calls;          // `return f(...);` jumps to f; in f itself, loops back to the top
+    const char* exports;     // comma-separated functions kept besides main, NULL for none
+} OptimizeOptions;
+
+// What optimize_program did, for --stats and the log
+typedef struct OptimizeReport {
+    size_t simplifications; // folds and algebraic identities
+    size_t inlined_calls;
+    size_t inline_growth;   // AST nodes added by inlining
+    size_t removed_functions;  // unreachable from main and the exports
+    size_t removed_statements; // after a return, or without effect
+} OptimizeReport;
+
+// Options for -O<level>: 0 disables every pass, 1 and above enable them
+void optimize_options_for_level(OptimizeOptions* options, int level);
+
+// Rewrites the program in place and fills report. Division by a constant zero
+// in the source is reported as an error; one that only appears once a call
+// has been inlined is left to trap at run time, as the call would have.
+// With dead code elimination, functions that are dropped are not looked at.
+// Returns 0, or -1 after reporting errors; the pass still runs to the end.
+int optimize_program(AST* ast, NodeId program, const Interner* names, const OptimizeOptions* options,
+                     OptimizeReport* report);
+
+#endif
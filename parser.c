@@ -1,159 +1,320 @@
-// parser.c
-#include <stdio.h>
-#include <stdlib.h>
-
-#include <string.h>
-#include "parser.h"
-#include "ast.h"
-
-Token current_token;
-
-
-void advance() {
-    // Free previous string_value if it was dynamically allocated
-    if (current_token.type == TOKEN_IDENTIFIER ||
-        current_token.type == TOKEN_RETURN ||
-        current_token.type == TOKEN_INT) { // Add other keywords if they allocate string_value
-        if (current_token.value.string_value) {
-            free(current_token.value.string_value);
-            current_token.value.string_value = NULL; // Prevent double free
-        }
-    }
-   current_token = getNextToken();
-}
-void match(TokenType expected_type){
-    if (current_token.type==expected_type){
-        advance();
-    }
-    else{
-        fprintf(stderr,"Parser Error: Expected token type %d, got %d\n");
-        exit(1);
-    }
-}
-// parsing functions for arithmetic expressions:
-ASTNode* parse_factor(){
-    ASTNode* node = NULL;
-    if (current_token.type == TOKEN_NUMBER){
-        node =ast_new_number(current_token.value.int_value);
-        match(TOKEN_NUMBER);
-    }else if(current_token.type == TOKEN_IDENTIFIER){
-        char* id_name = strdup(current_token.value.string_value);
-        node = ast_new_identifier(id_name);
-        match(TOKEN_IDENTIFIER);
-        if (current_token.type==TOKEN_LPAREN){
-            node = parse_function_call_from_id(node);
-        }
-    }
-    else if(current_token.type==TOKEN_LPAREN){
-        match(TOKEN_LPAREN);
-        node = parse_expression();
-        match(TOKEN_RPAREN);
-        }
-    else{
-        fprintf(stderr,"Parser Error: Unexpected token in factor: %d\n",current_token.type);
-        exit(1);
-    }
-    return node;
-    }
-ASTNode* parse_term(){
-    ASTNode* left= parse_factor();
-    while (current_token.type==TOKEN_MULTIPLY || current_token.type==TOKEN_DIVIDE){
-        TokenType op_type=current_token.type;
-        match(op_type);
-        ASTNode* right = parse_factor();
-        left =ast_new_binary_op(op_type,left,right);
-    }
-    return left;
-}
-ASTNode* parse_expression() {
-    ASTNode* left = parse_term();
-    while (current_token.type == TOKEN_PLUS || current_token.type == TOKEN_MINUS) {
-        TokenType op_type = current_token.type;
-        match(op_type);
-        ASTNode* right = parse_term();
-        left = ast_new_binary_op(op_type, left, right);
-    }
-    return left;
-}
-// Helper for function call parsing (called from parse_factor)
-ASTNode* parse_function_call_from_id(ASTNode* id_node) {
-    match(TOKEN_LPAREN);
-    ASTNode* args = parse_argument_list(); // This will return an AST_ARG_LIST
-    match(TOKEN_RPAREN);
-    char* func_name = strdup(id_node->data.identifier.name); // Duplicate name from ID node
-    ast_free(id_node); // Free the temporary ID node
-    return ast_new_function_call(func_name, args);
-}
-// Parsing for argument list
-ASTNode* parse_argument_list() {
-    ASTNodeList* args_list = ast_new_node_list();
-    if (current_token.type!= TOKEN_RPAREN) { // Check if there are arguments
-        ast_node_list_add(args_list, parse_expression());
-        while (current_token.type == TOKEN_COMMA) {
-            match(TOKEN_COMMA);
-            ast_node_list_add(args_list, parse_expression());
-        }
-    }
-    return ast_new_arg_list(args_list); // Wrap in an AST_ARG_LIST node
-}
-ASTNode* parse_statement() {
-    if (current_token.type == TOKEN_RETURN) {
-        match(TOKEN_RETURN);
-        ASTNode* expr = parse_expression();
-        match(TOKEN_SEMICOLON);
-        return ast_new_return_stmt(expr);
-    } else { // Assume it's an expression statement for now
-        ASTNode* expr = parse_expression();
-        match(TOKEN_SEMICOLON);
-        return ast_new_expression_stmt(expr);
-    }
-}
-ASTNode* parse_statement_list() {
-    ASTNodeList* stmt_list = ast_new_node_list();
-    while (current_token.type!= TOKEN_RBRACE && current_token.type!= TOKEN_EOF) {
-        ast_node_list_add(stmt_list, parse_statement());
-    }
-    return ast_new_block(stmt_list); // Wrap in an AST_BLOCK node
-}
-ASTNode* parse_parameter_list() {
-    ASTNodeList* param_list = ast_new_node_list();
-    if (current_token.type == TOKEN_INT) { // Only 'int' type parameters for now
-        match(TOKEN_INT);
-        char* param_name = strdup(current_token.value.string_value); // Duplicate name
-        ASTNode* param_id = ast_new_identifier(param_name);
-        ast_node_list_add(param_list, param_id);
-        match(TOKEN_IDENTIFIER);
-        while (current_token.type == TOKEN_COMMA) {
-            match(TOKEN_COMMA);
-            match(TOKEN_INT); // Only 'int' type parameters
-            param_name = strdup(current_token.value.string_value); // Duplicate name
-            param_id = ast_new_identifier(param_name);
-            ast_node_list_add(param_list, param_id);
-            match(TOKEN_IDENTIFIER);
-        }
-    }
-    return ast_new_param_list(param_list); // Wrap in an AST_PARAM_LIST node
-}
-
-ASTNode* parse_function_definition() {
-    match(TOKEN_INT); // Return type is always int for now
-    char* func_name = strdup(current_token.value.string_value);
-    match(TOKEN_IDENTIFIER);
-    match(TOKEN_LPAREN);
-    ASTNode* params = parse_parameter_list();
-    match(TOKEN_RPAREN);
-    match(TOKEN_LBRACE);
-    ASTNode* body = parse_statement_list();
-    match(TOKEN_RBRACE);
-    return ast_new_function_def(func_name, params, body);
-}
-
-ASTNode* parse_program() {
-    // lexer_init must be called externally before parse_program is called
-    // advance() must be called externally once to get the first token
-    ASTNodeList* func_list = ast_new_node_list();
-    while (current_token.type!= TOKEN_EOF) {
-        ast_node_list_add(func_list, parse_function_definition());
-    }
-    return ast_new_program(func_list); // Wrap in an AST_PROGRAM node
-}
+// parser.c
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+
+#include <string.h>
+#include "parser.h"
+#include "ast.h"
+
+void parser_init(Parser* parser, Lexer* lexer, AST* ast) {
+    parser->lexer = lexer;
+    parser->tokens = NULL;
+    parser->position = 0;
+    parser->ast = ast;
+    parser->failed = 0;
+    advance(parser); // prime the lookahead
+}
+
+void parser_init_tokens(Parser* parser, const TokenArray* tokens, AST* ast) {
+    parser->lexer = NULL;
+    parser->tokens = tokens;
+    parser->position = 0;
+    parser->ast = ast;
+    parser->failed = tokens->kinds[0] == TOKEN_EOF && tokens->lengths[0] != 0; // lex_tokens reported it
+    parser->current_token.type = (TokenType)tokens->kinds[0];
+    parser->current_token.value = tokens->values[0];
+}
+
+void advance(Parser* parser) {
+    if (parser->failed) return; // stays on the TOKEN_EOF the error left
+    if (parser->tokens) {
+        // Stays on the final TOKEN_EOF, as the lexer keeps returning it
+        const TokenArray* tokens = parser->tokens;
+        if (tokens->kinds[parser->position] != TOKEN_EOF) parser->position++;
+        parser->current_token.type = (TokenType)tokens->kinds[parser->position];
+        parser->current_token.value = tokens->values[parser->position];
+        // An unknown character ends the tokens; lex_tokens has reported it
+        if (parser->current_token.type == TOKEN_EOF && tokens->lengths[parser->position] != 0) parser->failed = 1;
+        return;
+    }
+    // Tokens own no memory (identifiers are interned), so the old one is simply overwritten
+    parser->current_token = getNextToken(parser->lexer);
+    if (parser->lexer->failed) parser->failed = 1; // the lexer has reported it
+}
+
+// Source position of the current token for error messages
+static void current_position(const Parser* parser, uint32_t* line, uint32_t* column) {
+    if (parser->tokens) {
+        token_array_position(parser->tokens, parser->tokens->offsets[parser->position], line, column);
+    } else {
+        *line = parser->current_token.line;
+        *column = parser->current_token.column;
+    }
+}
+
+// Reports a syntax error at the current token, unless one was reported
+// already, and makes the rest of the input look empty
+static void syntax_error(Parser* parser, const char* fmt, ...) {
+    if (!parser->failed) {
+        uint32_t line, column;
+        va_list args;
+        current_position(parser, &line, &column);
+        fprintf(stderr, "Parser Error: %u:%u: ", line, column);
+        va_start(args, fmt);
+        vfprintf(stderr, fmt, args);
+        va_end(args);
+        fprintf(stderr, "\n");
+    }
+    parser->failed = 1;
+    parser->current_token.type = TOKEN_EOF;
+}
+
+void match(Parser* parser, TokenType expected_type){
+    if (parser->current_token.type==expected_type){
+        advance(parser);
+    }
+    else{
+        syntax_error(parser, "Expected token type %d, got %d", expected_type, parser->current_token.type);
+    }
+}
+// Expressions are parsed by precedence climbing over an explicit stack, so
+// nesting depth (parentheses, calls inside arguments) costs heap, not native stack.
+
+// Binary operators by token type: binding power (0 = not a binary operator)
+// and associativity. Adding an operator is adding a row here.
+typedef struct {
+    unsigned char precedence;
+    unsigned char right_assoc;
+} BinaryOperator;
+
+static const BinaryOperator binary_operators[] = {
+    [TOKEN_PLUS]     = { 10, 0 },
+    [TOKEN_MINUS]    = { 10, 0 },
+    [TOKEN_MULTIPLY] = { 20, 0 },
+    [TOKEN_DIVIDE]   = { 20, 0 },
+};
+
+static int binary_precedence(TokenType type) {
+    if ((size_t)type >= sizeof(binary_operators) / sizeof(binary_operators[0])) return 0;
+    return binary_operators[type].precedence;
+}
+
+// What is waiting on the operator stack: a binary operator whose right
+// operand is being parsed, an open parenthesis, or a call collecting arguments
+typedef enum { FRAME_OPERATOR, FRAME_GROUP, FRAME_CALL } FrameKind;
+
+typedef struct {
+    FrameKind kind;
+    TokenType op;       // FRAME_OPERATOR
+    SymbolId name;      // FRAME_CALL
+    ASTNodeList args;   // FRAME_CALL
+} ExprFrame;
+
+// Both stacks start in fixed storage inside the struct and move to the heap
+// only for expressions nested deeper than that
+#define EXPR_STACK_INLINE 64
+
+typedef struct {
+    ExprFrame* frames;
+    size_t frame_count, frame_capacity;
+    NodeId* operands;
+    size_t operand_count, operand_capacity;
+    ExprFrame frame_storage[EXPR_STACK_INLINE];
+    NodeId operand_storage[EXPR_STACK_INLINE];
+} ExprStack;
+
+static void expr_stack_init(ExprStack* stack) {
+    stack->frames = stack->frame_storage;
+    stack->frame_count = 0;
+    stack->frame_capacity = EXPR_STACK_INLINE;
+    stack->operands = stack->operand_storage;
+    stack->operand_count = 0;
+    stack->operand_capacity = EXPR_STACK_INLINE;
+}
+
+static void expr_stack_free(ExprStack* stack) {
+    if (stack->frames != stack->frame_storage) free(stack->frames);
+    if (stack->operands != stack->operand_storage) free(stack->operands);
+}
+
+// Doubles a stack, copying out of the inline storage on the first growth
+static void* grow_stack(void* items, void* inline_storage, size_t* capacity, size_t item_size) {
+    size_t new_capacity = *capacity * 2;
+    void* grown = items == inline_storage ? malloc(new_capacity * item_size)
+                                          : realloc(items, new_capacity * item_size);
+    if (!grown) {
+        fprintf(stderr, "Parser Error: Out of memory for the expression stack\n");
+        exit(1);
+    }
+    if (items == inline_storage) memcpy(grown, inline_storage, *capacity * item_size);
+    *capacity = new_capacity;
+    return grown;
+}
+
+static ExprFrame* push_frame(ExprStack* stack, FrameKind kind) {
+    if (stack->frame_count == stack->frame_capacity)
+        stack->frames = grow_stack(stack->frames, stack->frame_storage, &stack->frame_capacity, sizeof(ExprFrame));
+    ExprFrame* frame = &stack->frames[stack->frame_count++];
+    frame->kind = kind;
+    return frame;
+}
+
+static void push_operand(ExprStack* stack, NodeId node) {
+    if (stack->operand_count == stack->operand_capacity)
+        stack->operands = grow_stack(stack->operands, stack->operand_storage, &stack->operand_capacity, sizeof(NodeId));
+    stack->operands[stack->operand_count++] = node;
+}
+
+// Folds pending operators that bind at least as tightly as min_precedence
+// into binary_op nodes, stopping at a group, a call or the bottom
+static void reduce(Parser* parser, ExprStack* stack, int min_precedence) {
+    while (stack->frame_count > 0) {
+        ExprFrame* top = &stack->frames[stack->frame_count - 1];
+        if (top->kind != FRAME_OPERATOR || binary_precedence(top->op) < min_precedence) break;
+        NodeId right = stack->operands[--stack->operand_count];
+        NodeId left = stack->operands[stack->operand_count - 1];
+        stack->operands[stack->operand_count - 1] = ast_new_binary_op(parser->ast, top->op, left, right);
+        stack->frame_count--;
+    }
+}
+
+// Operand position: pushes one primary, or opens a group or call and returns
+// 0 when another operand must follow before any operator
+static int parse_operand(Parser* parser, ExprStack* stack) {
+    Token token = parser->current_token;
+    if (token.type == TOKEN_NUMBER) {
+        push_operand(stack, ast_new_number(parser->ast, token.value.int_value));
+        advance(parser);
+    } else if (token.type == TOKEN_IDENTIFIER) {
+        advance(parser);
+        if (parser->current_token.type != TOKEN_LPAREN) {
+            push_operand(stack, ast_new_identifier(parser->ast, token.value.symbol));
+            return 1;
+        }
+        advance(parser);
+        if (parser->current_token.type != TOKEN_RPAREN) {
+            ExprFrame* call = push_frame(stack, FRAME_CALL);
+            call->name = token.value.symbol;
+            call->args = ast_new_node_list(parser->ast);
+            return 0; // first argument comes next
+        }
+        advance(parser);
+        ASTNodeList no_args = ast_new_node_list(parser->ast);
+        NodeId args = ast_new_arg_list(parser->ast, &no_args);
+        push_operand(stack, ast_new_function_call(parser->ast, token.value.symbol, args));
+    } else if (token.type == TOKEN_LPAREN) {
+        push_frame(stack, FRAME_GROUP);
+        advance(parser);
+        return 0;
+    } else {
+        syntax_error(parser, "Unexpected token in expression: %d", token.type);
+        push_operand(stack, ast_new_number(parser->ast, 0)); // keeps the stacks balanced while they unwind
+    }
+    return 1;
+}
+
+// Operator position: consumes closing parentheses and argument commas, then
+// returns 1 after pushing a binary operator or 0 at the end of the expression
+static int parse_operator(Parser* parser, ExprStack* stack) {
+    for (;;) {
+        TokenType type = parser->current_token.type;
+        int precedence = binary_precedence(type);
+        if (precedence) {
+            reduce(parser, stack, binary_operators[type].right_assoc ? precedence + 1 : precedence);
+            push_frame(stack, FRAME_OPERATOR)->op = type;
+            advance(parser);
+            return 1;
+        }
+        reduce(parser, stack, 1);
+        if (stack->frame_count == 0) return 0; // the caller decides what may follow
+        ExprFrame* top = &stack->frames[stack->frame_count - 1];
+        if (top->kind == FRAME_CALL) {
+            // Anything but a comma closes the call, or reports it left open;
+            // the argument list is closed either way
+            ast_node_list_add(parser->ast, &top->args, stack->operands[--stack->operand_count]);
+            if (type == TOKEN_COMMA) {
+                advance(parser);
+                return 1;
+            }
+            match(parser, TOKEN_RPAREN);
+            NodeId args = ast_new_arg_list(parser->ast, &top->args);
+            stack->frame_count--;
+            push_operand(stack, ast_new_function_call(parser->ast, top->name, args));
+        } else {
+            match(parser, TOKEN_RPAREN); // closes the group, or reports it left open
+            stack->frame_count--;
+        }
+    }
+}
+
+NodeId parse_expression(Parser* parser) {
+    ExprStack stack;
+    expr_stack_init(&stack);
+    do {
+        while (!parse_operand(parser, &stack)) {}
+    } while (parse_operator(parser, &stack));
+    NodeId result = stack.operands[0];
+    expr_stack_free(&stack);
+    return result;
+}
+NodeId parse_statement(Parser* parser) {
+    if (parser->current_token.type == TOKEN_RETURN) {
+        match(parser, TOKEN_RETURN);
+        NodeId expr = parse_expression(parser);
+        match(parser, TOKEN_SEMICOLON);
+        return ast_new_return_stmt(parser->ast, expr);
+    } else { // Assume it's an expression statement for now
+        NodeId expr = parse_expression(parser);
+        match(parser, TOKEN_SEMICOLON);
+        return ast_new_expression_stmt(parser->ast, expr);
+    }
+}
+NodeId parse_statement_list(Parser* parser) {
+    ASTNodeList stmt_list = ast_new_node_list(parser->ast);
+    while (parser->current_token.type!= TOKEN_RBRACE && parser->current_token.type!= TOKEN_EOF) {
+        ast_node_list_add(parser->ast, &stmt_list, parse_statement(parser));
+    }
+    return ast_new_block(parser->ast, &stmt_list); // Wrap in an AST_BLOCK node
+}
+NodeId parse_parameter_list(Parser* parser) {
+    ASTNodeList param_list = ast_new_node_list(parser->ast);
+    if (parser->current_token.type == TOKEN_INT) { // Only 'int' type parameters for now
+        match(parser, TOKEN_INT);
+        SymbolId param_name = parser->current_token.value.symbol;
+        NodeId param_id = ast_new_identifier(parser->ast, param_name);
+        ast_node_list_add(parser->ast, &param_list, param_id);
+        match(parser, TOKEN_IDENTIFIER);
+        while (parser->current_token.type == TOKEN_COMMA) {
+            match(parser, TOKEN_COMMA);
+            match(parser, TOKEN_INT); // Only 'int' type parameters
+            param_name = parser->current_token.value.symbol;
+            param_id = ast_new_identifier(parser->ast, param_name);
+            ast_node_list_add(parser->ast, &param_list, param_id);
+            match(parser, TOKEN_IDENTIFIER);
+        }
+    }
+    return ast_new_param_list(parser->ast, &param_list); // Wrap in an AST_PARAM_LIST node
+}
+
+NodeId parse_function_definition(Parser* parser) {
+    match(parser, TOKEN_INT); // Return type is always int for now
+    SymbolId func_name = parser->current_token.value.symbol;
+    match(parser, TOKEN_IDENTIFIER);
+    match(parser, TOKEN_LPAREN);
+    NodeId params = parse_parameter_list(parser);
+    match(parser, TOKEN_RPAREN);
+    match(parser, TOKEN_LBRACE);
+    NodeId body = parse_statement_list(parser);
+    match(parser, TOKEN_RBRACE);
+    return ast_new_function_def(parser->ast, func_name, params, body);
+}
+
+NodeId parse_program(Parser* parser) {
+    // parser_init must be called first; it reads the first token
+    ASTNodeList func_list = ast_new_node_list(parser->ast);
+    while (parser->current_token.type!= TOKEN_EOF) {
+        ast_node_list_add(parser->ast, &func_list, parse_function_definition(parser));
+    }
+    return ast_new_program(parser->ast, &func_list); // Wrap in an AST_PROGRAM node
+}
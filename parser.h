@@ -1,43 +1,56 @@
-#ifndef PARSER_H
-#define parser_h
-
-#include "token.h"
-#include "ast.h"
-
-//global token for current parser lookahead
-extern Token current_token;
-
-//function to move to next token
-void advance();
-
-//function to match an expected token type
-void match(TokenType expected_type);
-
-
-// Parsing functions for our grammar rules:
-ASTNode* parse_program();
-ASTNode* parse_function_definition();
-ASTNode* parse_parameter_list(); // Returns an AST_PARAM_LIST node
-ASTNode* parse_statement_list();// Returns an AST_BLOCK node
-ASTNode* parse_statement();
-ASTNode* parse_expression();
-ASTNode* parse_term();
-ASTNode* parse_factor();
-ASTNode* parse_function_call_from_id(ASTNode* id_node); // Helper for function calls
-ASTNode* parse_argument_list(); // Returns an AST_ARG_LIST node
-
-// grammar for c lang: 
-/* program    -> function_definition+
-function_definition -> TOKEN_INT TOKEN_IDENTIFIER TOKEN_LPAREN parameter_list TOKEN_RPAREN TOKEN_LBRACE statement_list TOKEN_RBRACE
-parameter_list -> (TOKEN_INT TOKEN_IDENTIFIER (TOKEN_COMMA TOKEN_INT TOKEN_IDENTIFIER)*)?
-statement_list -> statement*
-statement  -> TOKEN_RETURN expression TOKEN_SEMICOLON
-| expression TOKEN_SEMICOLON
-expression -> term ( (TOKEN_PLUS | TOKEN_MINUS) term )*
-term       -> factor ( (TOKEN_MULTIPLY | TOKEN_DIVIDE) factor )*
-factor     -> TOKEN_NUMBER
-| TOKEN_IDENTIFIER (TOKEN_LPAREN argument_list TOKEN_RPAREN)? // Handles identifiers and function calls
-| TOKEN_LPAREN expression TOKEN_RPAREN
-argument_list -> (expression (TOKEN_COMMA expression)*)? */
-
+#ifndef PARSER_H
+#define parser_h
+
+#include "token.h"
+#include "lexer.h"
+#include "ast.h"
+
+// Parsing state: the token source, one token of lookahead and where nodes go.
+// Tokens come either from a lexer, one at a time, or from a pre-lexed array
+// walked by index; current_token.line and .column are only set in the first case.
+typedef struct Parser {
+    Lexer* lexer;              // NULL when parsing from tokens
+    const TokenArray* tokens;  // NULL when parsing from lexer
+    size_t position;           // index of current_token in tokens
+    Token current_token;
+    AST* ast;
+    int failed; // an error was reported (by the parser or the lexer); the tree is incomplete
+} Parser;
+
+//function to set up a parser and read the first token
+void parser_init(Parser* parser, Lexer* lexer, AST* ast);
+void parser_init_tokens(Parser* parser, const TokenArray* tokens, AST* ast);
+
+//function to move to next token
+void advance(Parser* parser);
+
+//function to match an expected token type
+void match(Parser* parser, TokenType expected_type);
+
+
+// Parsing functions for our grammar rules. The first syntax error is reported
+// and sets parser->failed; parsing then runs on to the end as if the input had
+// ended there, so the caller gets a well-formed but incomplete tree to discard.
+NodeId parse_program(Parser* parser);
+NodeId parse_function_definition(Parser* parser);
+NodeId parse_parameter_list(Parser* parser); // Returns an AST_PARAM_LIST node
+NodeId parse_statement_list(Parser* parser);// Returns an AST_BLOCK node
+NodeId parse_statement(Parser* parser);
+NodeId parse_expression(Parser* parser); // Precedence climbing, no recursion
+
+// grammar for c lang: 
+/* program    -> function_definition+
+function_definition -> TOKEN_INT TOKEN_IDENTIFIER TOKEN_LPAREN parameter_list TOKEN_RPAREN TOKEN_LBRACE statement_list TOKEN_RBRACE
+parameter_list -> (TOKEN_INT TOKEN_IDENTIFIER (TOKEN_COMMA TOKEN_INT TOKEN_IDENTIFIER)*)?
+statement_list -> statement*
+statement  -> TOKEN_RETURN expression TOKEN_SEMICOLON
+| expression TOKEN_SEMICOLON
+expression -> primary ( binary_operator primary )*   // precedence and associativity from binary_operators in parser.c
+binary_operator -> TOKEN_PLUS | TOKEN_MINUS          // lowest
+| TOKEN_MULTIPLY | TOKEN_DIVIDE                      // binds tighter
+primary    -> TOKEN_NUMBER
+| TOKEN_IDENTIFIER (TOKEN_LPAREN argument_list TOKEN_RPAREN)? // Handles identifiers and function calls
+| TOKEN_LPAREN expression TOKEN_RPAREN
+argument_list -> (expression (TOKEN_COMMA expression)*)? */
+
 #endif
\ No newline at end of file
@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "peephole.h"
+
+#define PEEPHOLE_WINDOW 64 // most instructions between a push and the pop it pairs with
+
+typedef uint32_t RegSet;
+
+// The instructions being rewritten, and the registers live after each of
+// them. A rule that changes or deletes an instruction after the one it
+// matched at records the furthest one in `resume`: liveness from there on
+// back is stale until the walk has been over it again.
+typedef struct Peephole {
+    Instr* code;
+    size_t count;
+    RegSet* live;
+    size_t resume;
+} Peephole;
+#define REG_BIT(reg) ((RegSet)1 << (reg))
+
+#define CALLEE_SAVED (REG_BIT(REG_RBX) | REG_BIT(REG_RBP) | REG_BIT(REG_R12) | REG_BIT(REG_R13) | \
+                      REG_BIT(REG_R14) | REG_BIT(REG_R15))
+#define CALLER_SAVED (REG_BIT(REG_RAX) | REG_BIT(REG_RCX) | REG_BIT(REG_RDX) | REG_BIT(REG_RSI) | \
+                      REG_BIT(REG_RDI) | REG_BIT(REG_R8) | REG_BIT(REG_R9) | REG_BIT(REG_R10) | REG_BIT(REG_R11))
+
+static const Reg argument_regs[] = {REG_RDI, REG_RSI, REG_RDX, REG_RCX, REG_R8, REG_R9};
+
+static const char* const rule_names[PEEPHOLE_RULE_COUNT] = {
+    "push-pop", "self-mov", "identity", "imm-forward", "copy-forward", "copy-back", "frame-restore", "dead-write",
+};
+
+const char* peephole_rule_name(PeepholeRule rule) {
+    return rule_names[rule];
+}
+
+static int is_ret(const Instr* instr) {
+    return instr->shape == INSTR_OP && instr->op == OP_RET;
+}
+
+// ret and jmp: nothing after them runs next
+static int ends_flow(const Instr* instr) {
+    return is_ret(instr) || instr->shape == INSTR_JUMP;
+}
+
+// Registers an instruction reads. A ret reads the return value and
+// everything its caller expects preserved; a jump, a tail call or a loop
+// back to the top, the arguments instead of the return value.
+static RegSet instr_reads(const Instr* instr) {
+    switch ((InstrShape)instr->shape) {
+        case INSTR_OP:
+            if (instr->op == OP_CQO) return REG_BIT(REG_RAX);
+            return REG_BIT(REG_RAX) | REG_BIT(REG_RSP) | CALLEE_SAVED;
+        case INSTR_REG:
+            switch (instr->op) {
+                case OP_PUSH: return REG_BIT(instr->dst) | REG_BIT(REG_RSP);
+                case OP_POP: return REG_BIT(REG_RSP);
+                case OP_NEG: return REG_BIT(instr->dst);
+                case OP_IMUL: return REG_BIT(instr->dst) | REG_BIT(REG_RAX);
+                default: return REG_BIT(instr->dst) | REG_BIT(REG_RAX) | REG_BIT(REG_RDX); // idiv
+            }
+        case INSTR_REG_REG:
+            if (instr->op == OP_MOV || instr->op == OP_MOVSXD || instr->op == OP_LEA) return REG_BIT(instr->src);
+            return REG_BIT(instr->dst) | REG_BIT(instr->src);
+        case INSTR_REG_IMM:
+            return instr->op == OP_MOV ? 0 : REG_BIT(instr->dst);
+        case INSTR_CALL: {
+            RegSet reads = REG_BIT(REG_RSP);
+            for (int i = 0; i < instr->src && i < 6; ++i) reads |= REG_BIT(argument_regs[i]);
+            return reads;
+        }
+        case INSTR_JUMP: {
+            RegSet reads = REG_BIT(REG_RSP) | CALLEE_SAVED;
+            for (int i = 0; i < instr->src && i < 6; ++i) reads |= REG_BIT(argument_regs[i]);
+            return reads;
+        }
+        case INSTR_LOAD:
+            return REG_BIT(instr->src);
+        case INSTR_STORE:
+            return REG_BIT(instr->dst) | REG_BIT(instr->src);
+        default:
+            return 0;
+    }
+}
+
+// Registers an instruction overwrites. A call counts as overwriting every
+// caller-saved register.
+static RegSet instr_writes(const Instr* instr) {
+    switch ((InstrShape)instr->shape) {
+        case INSTR_OP:
+            return instr->op == OP_CQO ? REG_BIT(REG_RDX) : REG_BIT(REG_RSP);
+        case INSTR_REG:
+            switch (instr->op) {
+                case OP_PUSH: return REG_BIT(REG_RSP);
+                case OP_POP: return REG_BIT(instr->dst) | REG_BIT(REG_RSP);
+                case OP_NEG: return REG_BIT(instr->dst);
+                default: return REG_BIT(REG_RAX) | REG_BIT(REG_RDX); // idiv, widening imul
+            }
+        case INSTR_REG_REG:
+        case INSTR_REG_IMM:
+        case INSTR_LOAD:
+            return REG_BIT(instr->dst);
+        case INSTR_CALL:
+            return CALLER_SAVED;
+        default:
+            return 0;
+    }
+}
+
+static int is_reg_reg(const Instr* instr, Opcode op) {
+    return instr->shape == INSTR_REG_REG && instr->op == op;
+}
+
+static int is_reg_imm(const Instr* instr, Opcode op) {
+    return instr->shape == INSTR_REG_IMM && instr->op == op;
+}
+
+static int fits_imm32(long long imm) {
+    return imm >= INT32_MIN && imm <= INT32_MAX;
+}
+
+static void make_nop(Instr* instr) {
+    instr->shape = INSTR_NOP;
+}
+
+static void make_mov(Instr* instr, Reg dst, Reg src) {
+    if (dst == src) {
+        make_nop(instr);
+        return;
+    }
+    instr->shape = INSTR_REG_REG;
+    instr->op = OP_MOV;
+    instr->dst = (uint8_t)dst;
+    instr->src = (uint8_t)src;
+    instr->dword = 0;
+}
+
+// Index of the first instruction after `at` that was not deleted, or count
+static size_t next_instr(const Instr* code, size_t count, size_t at) {
+    size_t i = at + 1;
+    while (i < count && code[i].shape == INSTR_NOP) ++i;
+    return i;
+}
+
+// Registers live just before an instruction, given those live after it.
+// After a ret or jmp nothing is.
+static RegSet live_before(const Instr* instr, RegSet live_after) {
+    if (ends_flow(instr)) return instr_reads(instr);
+    return (live_after & ~instr_writes(instr)) | instr_reads(instr);
+}
+
+// Whether the value in `reg` right after code[at] is never read
+static int dead_after(const Peephole* p, size_t at, Reg reg) {
+    return !(p->live[at] & REG_BIT(reg));
+}
+
+// push x; ...; pop y  ->  mov y, x
+// The instructions in between must leave rsp alone. The move goes where the
+// push was if nothing in between touches y, or where the pop was if nothing
+// in between changes x or reads y.
+static int rule_push_pop(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    size_t count = p->count;
+    const Instr* push = &code[at];
+    if (push->shape != INSTR_REG || push->op != OP_PUSH || push->dst == REG_RSP) return 0;
+    Reg x = (Reg)push->dst;
+    RegSet reads = 0, writes = 0;
+    int seen = 0;
+    for (size_t i = next_instr(code, count, at); i < count && seen < PEEPHOLE_WINDOW; i = next_instr(code, count, i)) {
+        Instr* instr = &code[i];
+        if (instr->shape == INSTR_REG && instr->op == OP_POP) {
+            Reg y = (Reg)instr->dst;
+            if (y == REG_RSP) return 0;
+            if (!((reads | writes) & REG_BIT(y))) {
+                make_mov(&code[at], y, x);
+                make_nop(instr);
+                p->resume = i;
+                return 1;
+            }
+            if (!(writes & REG_BIT(x)) && !(reads & REG_BIT(y))) {
+                make_nop(&code[at]);
+                make_mov(instr, y, x);
+                p->resume = i;
+                return 1;
+            }
+            return 0;
+        }
+        if (ends_flow(instr) || instr->shape == INSTR_CALL || (instr->shape == INSTR_REG && instr->op == OP_PUSH)) return 0;
+        RegSet instr_read = instr_reads(instr), instr_write = instr_writes(instr);
+        if ((instr_read | instr_write) & REG_BIT(REG_RSP)) return 0;
+        reads |= instr_read;
+        writes |= instr_write;
+        ++seen;
+    }
+    return 0;
+}
+
+// mov r, r  ->  (nothing)
+static int rule_self_mov(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    if (!is_reg_reg(&code[at], OP_MOV) || code[at].dst != code[at].src) return 0;
+    make_nop(&code[at]);
+    return 1;
+}
+
+// add r, 0 / sub r, 0 / imul r, 1  ->  (nothing). Nothing we emit reads flags.
+static int rule_identity(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    const Instr* instr = &code[at];
+    if (instr->shape != INSTR_REG_IMM) return 0;
+    if (((instr->op == OP_ADD || instr->op == OP_SUB) && instr->imm == 0) || (instr->op == OP_IMUL && instr->imm == 1)) {
+        make_nop(&code[at]);
+        return 1;
+    }
+    return 0;
+}
+
+// mov t, imm; op d, t  ->  op d, imm   when t is dead afterwards
+static int rule_imm_forward(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    size_t count = p->count;
+    const Instr* load = &code[at];
+    if (!is_reg_imm(load, OP_MOV)) return 0;
+    size_t next = next_instr(code, count, at);
+    if (next == count) return 0;
+    Instr* use = &code[next];
+    if (use->shape != INSTR_REG_REG || use->src != load->dst || use->dst == load->dst) return 0;
+    if (use->op != OP_MOV && use->op != OP_ADD && use->op != OP_SUB && use->op != OP_IMUL) return 0;
+    if (use->op != OP_MOV && !fits_imm32(load->imm)) return 0;
+    if (!dead_after(p, next, (Reg)load->dst)) return 0;
+    use->shape = INSTR_REG_IMM;
+    use->imm = load->imm;
+    use->src = 0;
+    make_nop(&code[at]);
+    p->resume = next;
+    return 1;
+}
+
+// mov t, s; op d, t  ->  op d, s     when t is dead afterwards
+// mov t, s; push t   ->  push s
+static int rule_copy_forward(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    size_t count = p->count;
+    const Instr* copy = &code[at];
+    if (!is_reg_reg(copy, OP_MOV) || copy->dst == copy->src) return 0;
+    size_t next = next_instr(code, count, at);
+    if (next == count) return 0;
+    Instr* use = &code[next];
+    if (use->shape == INSTR_REG_REG) {
+        if (use->src != copy->dst || use->dst == copy->dst) return 0;
+    } else if (use->shape == INSTR_REG && use->op == OP_PUSH) {
+        if (use->dst != copy->dst) return 0;
+    } else {
+        return 0;
+    }
+    if (!dead_after(p, next, (Reg)copy->dst)) return 0;
+    if (use->shape == INSTR_REG_REG) use->src = copy->src;
+    else use->dst = copy->src;
+    make_nop(&code[at]);
+    p->resume = next;
+    return 1;
+}
+
+// mov t, s; mov s, t  ->  mov t, s
+// add t, s; mov s, t  ->  add s, t   when t is dead afterwards (imul alike)
+static int rule_copy_back(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    size_t count = p->count;
+    Instr* op = &code[at];
+    if (op->shape != INSTR_REG_REG || op->dst == op->src) return 0;
+    if (op->op != OP_MOV && op->op != OP_ADD && op->op != OP_IMUL) return 0;
+    size_t next = next_instr(code, count, at);
+    if (next == count) return 0;
+    Instr* copy = &code[next];
+    if (!is_reg_reg(copy, OP_MOV) || copy->dst != op->src || copy->src != op->dst) return 0;
+    if (op->op != OP_MOV) {
+        if (op->dst == REG_RSP || op->src == REG_RSP) return 0;
+        if (!dead_after(p, next, (Reg)op->dst)) return 0;
+        uint8_t t = op->dst;
+        op->dst = op->src;
+        op->src = t;
+    }
+    make_nop(copy);
+    p->resume = next;
+    return 1;
+}
+
+// mov rsp, rbp  ->  (nothing)   when rsp already equals rbp: since the
+// prologue's mov rbp, rsp, pushes and pops balance, immediate adjustments of
+// rsp cancel out, and rbp was not touched
+static int rule_frame_restore(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    const Instr* restore = &code[at];
+    if (!is_reg_reg(restore, OP_MOV) || restore->dst != REG_RSP || restore->src != REG_RBP) return 0;
+    size_t frame = at;
+    for (;;) {
+        if (frame == 0) return 0;
+        const Instr* instr = &code[--frame];
+        if (is_reg_reg(instr, OP_MOV) && instr->dst == REG_RBP && instr->src == REG_RSP) break;
+        if (ends_flow(instr) || (instr_writes(instr) & REG_BIT(REG_RBP))) return 0;
+    }
+    long long delta = 0;
+    for (size_t i = frame + 1; i < at; ++i) {
+        const Instr* instr = &code[i];
+        if (instr->shape == INSTR_NOP || instr->shape == INSTR_CALL) continue; // a callee leaves rsp as it found it
+        if (instr->shape == INSTR_REG && instr->op == OP_PUSH) {
+            delta -= 8;
+        } else if (instr->shape == INSTR_REG && instr->op == OP_POP && instr->dst != REG_RSP) {
+            delta += 8;
+        } else if (instr_writes(instr) & REG_BIT(REG_RSP)) {
+            if (is_reg_imm(instr, OP_ADD) && instr->dst == REG_RSP) delta += instr->imm;
+            else if (is_reg_imm(instr, OP_SUB) && instr->dst == REG_RSP) delta -= instr->imm;
+            else return 0;
+        }
+    }
+    if (delta != 0) return 0;
+    make_nop(&code[at]);
+    return 1;
+}
+
+// An arithmetic result, copy or reload nobody reads  ->  (nothing)
+static int rule_dead_write(Peephole* p, size_t at) {
+    Instr* code = p->code;
+    const Instr* instr = &code[at];
+    if (instr->shape != INSTR_REG_REG && instr->shape != INSTR_REG_IMM && instr->shape != INSTR_LOAD) return 0;
+    if (instr->dst == REG_RSP) return 0;
+    if (!dead_after(p, at, (Reg)instr->dst)) return 0;
+    make_nop(&code[at]);
+    return 1;
+}
+
+// Each rule with the instruction shapes it can match at, so the driver only
+// calls the ones that stand a chance
+typedef struct PeepholeRuleDef {
+    int (*apply)(Peephole* p, size_t at);
+    unsigned shapes; // bit per InstrShape
+} PeepholeRuleDef;
+
+#define SHAPE(shape) (1u << (shape))
+
+static const PeepholeRuleDef rules[PEEPHOLE_RULE_COUNT] = {
+    {rule_push_pop, SHAPE(INSTR_REG)},
+    {rule_self_mov, SHAPE(INSTR_REG_REG)},
+    {rule_identity, SHAPE(INSTR_REG_IMM)},
+    {rule_imm_forward, SHAPE(INSTR_REG_IMM)},
+    {rule_copy_forward, SHAPE(INSTR_REG_REG)},
+    {rule_copy_back, SHAPE(INSTR_REG_REG)},
+    {rule_frame_restore, SHAPE(INSTR_REG_REG)},
+    {rule_dead_write, SHAPE(INSTR_REG_REG) | SHAPE(INSTR_REG_IMM) | SHAPE(INSTR_LOAD)},
+};
+
+size_t peephole_optimize(Instr* code, size_t count, size_t hits[PEEPHOLE_RULE_COUNT]) {
+    if (count == 0) return 0;
+    RegSet* live = (RegSet*)malloc(count * sizeof(RegSet));
+    if (!live) {
+        fprintf(stderr, "Memory allocation failed for peephole liveness.\n");
+        exit(1);
+    }
+    // One walk backwards: rules look forward, so everything after the current
+    // instruction is already as good as it gets, and liveness can be worked
+    // out on the way. A rule that rewrote a later instruction makes the walk
+    // resume from there.
+    Peephole p = {code, count, live, 0};
+    size_t after = count; // first instruction after i that was not deleted
+    size_t i = count;
+    while (i-- > 0) {
+        if (code[i].shape == INSTR_NOP) continue;
+        live[i] = after == count ? ~(RegSet)0 : live_before(&code[after], live[after]); // past the end, all live
+        for (int rule = 0; rule < PEEPHOLE_RULE_COUNT && code[i].shape != INSTR_NOP; ++rule) {
+            if (!(rules[rule].shapes & SHAPE(code[i].shape)) || !rules[rule].apply(&p, i)) continue;
+            hits[rule]++;
+            rule = -1; // the instruction changed, so try every rule on it again
+            if (p.resume) break;
+        }
+        if (p.resume) {
+            after = next_instr(code, count, p.resume);
+            i = p.resume + 1;
+            p.resume = 0;
+        } else if (code[i].shape != INSTR_NOP) {
+            after = i;
+        }
+    }
+    free(live);
+    size_t kept = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (code[i].shape != INSTR_NOP) code[kept++] = code[i];
+    }
+    return kept;
+}
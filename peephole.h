@@ -0,0 +1,24 @@
+#ifndef PEEPHOLE_H
+#define PEEPHOLE_H
+
+#include <stddef.h>
+#include "emit.h"
+
+// Rule-driven window optimizer over the emitter's instruction IR. Each rule
+// looks at one instruction and the few after it, and may rewrite them or turn
+// them into INSTR_NOP. The rules run to a fixed point; a hit is counted in
+// hits[rule] every time one fires.
+//
+// The input is straight-line code, normally one whole function up to its ret
+// (that is what the code generator flushes). Rules that drop a value check
+// that its register is dead, from liveness worked out backwards as the pass
+// goes: a ret reads only rax, rsp and the callee-saved registers, and a call
+// reads its argument registers and clobbers the caller-saved ones. Past the
+// end of the input every register counts as live, so flushing in the middle
+// of a function is safe, only less effective.
+
+// Optimizes code[0..count) in place and returns the new count
+size_t peephole_optimize(Instr* code, size_t count, size_t hits[PEEPHOLE_RULE_COUNT]);
+const char* peephole_rule_name(PeepholeRule rule);
+
+#endif
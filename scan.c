@@ -0,0 +1,269 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "scan.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && defined(__SSE2__)
+#define SCAN_HAVE_SSE2 1
+#include <immintrin.h>
+#endif
+
+#define S CC_SPACE
+#define D (CC_DIGIT | CC_IDENT)
+#define L (CC_IDENT_START | CC_IDENT)
+const uint8_t char_class[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, S, S, S, S, S, 0, 0, // 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x10
+    S, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, // 0x20
+    D, D, D, D, D, D, D, D, D, D, 0, 0, 0, 0, 0, 0, // 0x30
+    0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L, // 0x40
+    L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, L, // 0x50
+    0, L, L, L, L, L, L, L, L, L, L, L, L, L, L, L, // 0x60
+    L, L, L, L, L, L, L, L, L, L, L, 0, 0, 0, 0, 0, // 0x70
+    // bytes 0x80-0xff are all 0
+};
+#undef S
+#undef D
+#undef L
+
+// ---- Scalar fallback ----
+
+static const char* scan_whitespace_scalar(const char* p, ScanLines* lines) {
+    while (CHAR_IS(*p, CC_SPACE)) {
+        if (*p == '\n') {
+            lines->line++;
+            lines->line_start = p + 1;
+        }
+        p++;
+    }
+    return p;
+}
+
+static const char* scan_line_comment_scalar(const char* p) {
+    while (*p != '\n' && *p != '\0') p++;
+    return p;
+}
+
+static const char* scan_block_comment_scalar(const char* p, ScanLines* lines) {
+    for (;;) {
+        if (*p == '\0') return p;
+        if (*p == '*' && p[1] == '/') return p + 2;
+        if (*p == '\n') {
+            lines->line++;
+            lines->line_start = p + 1;
+        }
+        p++;
+    }
+}
+
+#ifdef SCAN_HAVE_SSE2
+// The vector loops only issue aligned loads. An aligned block never crosses a
+// page boundary, so reading the whole block around the '\0' is safe no matter
+// where the buffer ends; bits for bytes before the start pointer are masked off
+// through `live`.
+
+static inline unsigned first_bit(uint32_t mask) {
+    return (unsigned)__builtin_ctz(mask);
+}
+
+// Records the newlines a routine stepped over: `mask` has bit i set when
+// block[i] is a consumed '\n'.
+static inline void note_newlines(ScanLines* lines, const char* block, uint32_t mask) {
+    if (!mask) return;
+    lines->line += (uint32_t)__builtin_popcount(mask);
+    lines->line_start = block + (31 - __builtin_clz(mask)) + 1;
+}
+
+// Bits strictly below the lowest set bit of stop (stop != 0)
+static inline uint32_t below_first(uint32_t stop) {
+    return (1u << first_bit(stop)) - 1;
+}
+
+// Bit i set if byte i is whitespace: ' ' or \t..\r (9..13)
+static inline uint32_t whitespace_mask_sse2(__m128i v) {
+    __m128i shifted = _mm_sub_epi8(v, _mm_set1_epi8(9));
+    __m128i in_range = _mm_cmpeq_epi8(_mm_min_epu8(shifted, _mm_set1_epi8(4)), shifted);
+    __m128i space = _mm_cmpeq_epi8(v, _mm_set1_epi8(' '));
+    return (uint32_t)_mm_movemask_epi8(_mm_or_si128(in_range, space));
+}
+
+static inline uint32_t byte_mask_sse2(__m128i v, char a) {
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(a)));
+}
+
+static const char* scan_whitespace_sse2(const char* p, ScanLines* lines) {
+    size_t misalign = (uintptr_t)p & 15;
+    const char* block = p - misalign;
+    uint32_t live = (0xFFFFu << misalign) & 0xFFFFu;
+    for (;;) {
+        __m128i v = _mm_load_si128((const __m128i*)block);
+        uint32_t stop = ~whitespace_mask_sse2(v) & live;
+        uint32_t newlines = byte_mask_sse2(v, '\n') & live;
+        if (stop) {
+            note_newlines(lines, block, newlines & below_first(stop));
+            return block + first_bit(stop);
+        }
+        note_newlines(lines, block, newlines);
+        block += 16;
+        live = 0xFFFFu;
+    }
+}
+
+static const char* scan_line_comment_sse2(const char* p) {
+    size_t misalign = (uintptr_t)p & 15;
+    const char* block = p - misalign;
+    uint32_t live = (0xFFFFu << misalign) & 0xFFFFu;
+    for (;;) {
+        __m128i v = _mm_load_si128((const __m128i*)block);
+        uint32_t stop = (byte_mask_sse2(v, '\n') | byte_mask_sse2(v, '\0')) & live;
+        if (stop) return block + first_bit(stop);
+        block += 16;
+        live = 0xFFFFu;
+    }
+}
+
+static const char* scan_block_comment_sse2(const char* p, ScanLines* lines) {
+    for (;;) {
+        size_t misalign = (uintptr_t)p & 15;
+        const char* block = p - misalign;
+        uint32_t live = (0xFFFFu << misalign) & 0xFFFFu;
+        for (;;) {
+            __m128i v = _mm_load_si128((const __m128i*)block);
+            uint32_t stop = (byte_mask_sse2(v, '*') | byte_mask_sse2(v, '\0')) & live;
+            uint32_t newlines = byte_mask_sse2(v, '\n') & live;
+            if (stop) {
+                note_newlines(lines, block, newlines & below_first(stop));
+                p = block + first_bit(stop);
+                break;
+            }
+            note_newlines(lines, block, newlines);
+            block += 16;
+            live = 0xFFFFu;
+        }
+        if (*p == '\0') return p;
+        if (p[1] == '/') return p + 2;
+        p++; // a lone '*', keep looking
+    }
+}
+
+// AVX2 variants: same loops over 32-byte blocks, compiled for AVX2 only
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static inline uint32_t whitespace_mask_avx2(__m256i v) {
+    __m256i shifted = _mm256_sub_epi8(v, _mm256_set1_epi8(9));
+    __m256i in_range = _mm256_cmpeq_epi8(_mm256_min_epu8(shifted, _mm256_set1_epi8(4)), shifted);
+    __m256i space = _mm256_cmpeq_epi8(v, _mm256_set1_epi8(' '));
+    return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(in_range, space));
+}
+
+AVX2_TARGET static inline uint32_t byte_mask_avx2(__m256i v, char a) {
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(a)));
+}
+
+AVX2_TARGET static const char* scan_whitespace_avx2(const char* p, ScanLines* lines) {
+    size_t misalign = (uintptr_t)p & 31;
+    const char* block = p - misalign;
+    uint32_t live = 0xFFFFFFFFu << misalign;
+    for (;;) {
+        __m256i v = _mm256_load_si256((const __m256i*)block);
+        uint32_t stop = ~whitespace_mask_avx2(v) & live;
+        uint32_t newlines = byte_mask_avx2(v, '\n') & live;
+        if (stop) {
+            note_newlines(lines, block, newlines & below_first(stop));
+            return block + first_bit(stop);
+        }
+        note_newlines(lines, block, newlines);
+        block += 32;
+        live = 0xFFFFFFFFu;
+    }
+}
+
+AVX2_TARGET static const char* scan_line_comment_avx2(const char* p) {
+    size_t misalign = (uintptr_t)p & 31;
+    const char* block = p - misalign;
+    uint32_t live = 0xFFFFFFFFu << misalign;
+    for (;;) {
+        __m256i v = _mm256_load_si256((const __m256i*)block);
+        uint32_t stop = (byte_mask_avx2(v, '\n') | byte_mask_avx2(v, '\0')) & live;
+        if (stop) return block + first_bit(stop);
+        block += 32;
+        live = 0xFFFFFFFFu;
+    }
+}
+
+AVX2_TARGET static const char* scan_block_comment_avx2(const char* p, ScanLines* lines) {
+    for (;;) {
+        size_t misalign = (uintptr_t)p & 31;
+        const char* block = p - misalign;
+        uint32_t live = 0xFFFFFFFFu << misalign;
+        for (;;) {
+            __m256i v = _mm256_load_si256((const __m256i*)block);
+            uint32_t stop = (byte_mask_avx2(v, '*') | byte_mask_avx2(v, '\0')) & live;
+            uint32_t newlines = byte_mask_avx2(v, '\n') & live;
+            if (stop) {
+                note_newlines(lines, block, newlines & below_first(stop));
+                p = block + first_bit(stop);
+                break;
+            }
+            note_newlines(lines, block, newlines);
+            block += 32;
+            live = 0xFFFFFFFFu;
+        }
+        if (*p == '\0') return p;
+        if (p[1] == '/') return p + 2;
+        p++;
+    }
+}
+#endif
+
+// ---- Dispatch ----
+
+typedef struct {
+    const char* (*whitespace)(const char*, ScanLines*);
+    const char* (*line_comment)(const char*);
+    const char* (*block_comment)(const char*, ScanLines*);
+    const char* name;
+} ScanImpl;
+
+static ScanImpl scan_impl = {
+    scan_whitespace_scalar, scan_line_comment_scalar, scan_block_comment_scalar, "scalar",
+};
+
+void scan_init() {
+#ifdef SCAN_HAVE_SSE2
+    static int initialized = 0;
+    if (initialized) return;
+    initialized = 1;
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        scan_impl = (ScanImpl){ scan_whitespace_avx2, scan_line_comment_avx2, scan_block_comment_avx2, "avx2" };
+    } else {
+        scan_impl = (ScanImpl){ scan_whitespace_sse2, scan_line_comment_sse2, scan_block_comment_sse2, "sse2" };
+    }
+#endif
+}
+
+// Most whitespace runs are a single space or newline plus indentation; a lone
+// whitespace byte is handled inline before paying for the vector setup.
+const char* scan_whitespace(const char* p, ScanLines* lines) {
+    if (!CHAR_IS(p[0], CC_SPACE)) return p;
+    if (!CHAR_IS(p[1], CC_SPACE)) {
+        if (p[0] == '\n') {
+            lines->line++;
+            lines->line_start = p + 1;
+        }
+        return p + 1;
+    }
+    return scan_impl.whitespace(p, lines);
+}
+
+const char* scan_line_comment(const char* p) {
+    return scan_impl.line_comment(p);
+}
+
+const char* scan_block_comment(const char* p, ScanLines* lines) {
+    return scan_impl.block_comment(p, lines);
+}
+
+const char* scan_isa_name() {
+    return scan_impl.name;
+}
@@ -0,0 +1,33 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stdint.h>
+
+// Character classes for the lexer, one table lookup per byte instead of the
+// locale-dependent <ctype.h> calls
+#define CC_SPACE       0x01 // ' ', \t, \n, \v, \f, \r
+#define CC_DIGIT       0x02 // 0-9
+#define CC_IDENT_START 0x04 // a-z, A-Z, _
+#define CC_IDENT       0x08 // a-z, A-Z, 0-9, _
+
+extern const uint8_t char_class[256];
+#define CHAR_IS(c, cls) (char_class[(unsigned char)(c)] & (cls))
+
+// Line bookkeeping for source locations: routines that step over newlines
+// bump `line` and point `line_start` just past the last '\n' they consumed.
+typedef struct ScanLines {
+    uint32_t line;
+    const char* line_start;
+} ScanLines;
+
+// Bulk skipping over the NUL-terminated source. Each routine stops at the
+// terminating '\0', so it never runs past the end of the buffer.
+// SSE2 or AVX2 loops are used where the CPU has them (picked once, at the
+// first call of scan_init), with a scalar fallback elsewhere.
+void scan_init();
+const char* scan_whitespace(const char* p, ScanLines* lines);    // first byte that is not whitespace
+const char* scan_line_comment(const char* p);                    // the '\n' (or '\0') ending the line
+const char* scan_block_comment(const char* p, ScanLines* lines); // just past the next "*/" (or at '\0')
+const char* scan_isa_name();                   // "avx2", "sse2" or "scalar"
+
+#endif
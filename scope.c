@@ -0,0 +1,98 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "scope.h"
+
+// Symbol ids are dense, so a multiplicative hash spreads them well
+static uint32_t hash_symbol(SymbolId name, uint32_t mask) {
+    return (name * 2654435769u >> 8) & mask;
+}
+
+static void* grow(void* items, uint32_t* capacity, size_t item_size) {
+    uint32_t new_capacity = *capacity ? *capacity * 2 : 64;
+    void* grown = realloc(items, (size_t)new_capacity * item_size);
+    if (!grown) {
+        fprintf(stderr, "Memory allocation failed for the scope table.\n");
+        exit(1);
+    }
+    *capacity = new_capacity;
+    return grown;
+}
+
+void scope_init(ScopeTable* scopes) {
+    memset(scopes, 0, sizeof(*scopes));
+}
+
+void scope_free(ScopeTable* scopes) {
+    free(scopes->heads);
+    free(scopes->bindings);
+    free(scopes->scope_starts);
+    scope_init(scopes);
+}
+
+void scope_push(ScopeTable* scopes) {
+    if (scopes->depth == scopes->depth_capacity) {
+        scopes->scope_starts = (uint32_t*)grow(scopes->scope_starts, &scopes->depth_capacity, sizeof(uint32_t));
+    }
+    scopes->scope_starts[scopes->depth++] = scopes->binding_count;
+}
+
+void scope_pop(ScopeTable* scopes) {
+    uint32_t start = scopes->scope_starts[--scopes->depth];
+    uint32_t mask = scopes->head_capacity - 1;
+    while (scopes->binding_count > start) {
+        const Binding* binding = &scopes->bindings[--scopes->binding_count];
+        scopes->heads[hash_symbol(binding->name, mask)] = binding->next;
+    }
+}
+
+// Doubles the chain heads and relinks every binding, oldest first, so each
+// chain keeps its newest binding at the head
+static void grow_heads(ScopeTable* scopes) {
+    uint32_t capacity = scopes->head_capacity ? scopes->head_capacity * 2 : 64;
+    uint32_t* heads = (uint32_t*)calloc(capacity, sizeof(uint32_t));
+    if (!heads) {
+        fprintf(stderr, "Memory allocation failed for the scope table.\n");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < scopes->binding_count; ++i) {
+        uint32_t h = hash_symbol(scopes->bindings[i].name, capacity - 1);
+        scopes->bindings[i].next = heads[h];
+        heads[h] = i + 1;
+    }
+    free(scopes->heads);
+    scopes->heads = heads;
+    scopes->head_capacity = capacity;
+}
+
+int scope_define(ScopeTable* scopes, SymbolId name, uint32_t value) {
+    uint32_t start = scopes->depth ? scopes->scope_starts[scopes->depth - 1] : 0;
+    if (scopes->head_capacity) {
+        for (uint32_t i = scopes->heads[hash_symbol(name, scopes->head_capacity - 1)]; i > start; i = scopes->bindings[i - 1].next) {
+            if (scopes->bindings[i - 1].name == name) return 0;
+        }
+    }
+    if (scopes->binding_count == scopes->binding_capacity) {
+        scopes->bindings = (Binding*)grow(scopes->bindings, &scopes->binding_capacity, sizeof(Binding));
+    }
+    // Keep chains at about one binding each
+    if (scopes->binding_count + 1 > scopes->head_capacity) grow_heads(scopes);
+    uint32_t h = hash_symbol(name, scopes->head_capacity - 1);
+    Binding* binding = &scopes->bindings[scopes->binding_count++];
+    binding->name = name;
+    binding->value = value;
+    binding->next = scopes->heads[h];
+    scopes->heads[h] = scopes->binding_count;
+    return 1;
+}
+
+int scope_lookup(const ScopeTable* scopes, SymbolId name, uint32_t* value) {
+    if (scopes->head_capacity == 0) return 0;
+    for (uint32_t i = scopes->heads[hash_symbol(name, scopes->head_capacity - 1)]; i; i = scopes->bindings[i - 1].next) {
+        if (scopes->bindings[i - 1].name == name) {
+            *value = scopes->bindings[i - 1].value;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,40 @@
+#ifndef SCOPE_H
+#define SCOPE_H
+
+#include <stdint.h>
+#include "intern.h"
+
+// Scoped symbol table: what each name stands for at one point of a function,
+// parameters now and block-local variables later. Inner scopes shadow outer
+// ones, and leaving a scope forgets everything bound in it.
+//
+// Bindings are a stack, innermost last, hashed by SymbolId into chains. A new
+// binding always goes to the head of its chain, so lookups find the innermost
+// one first and leaving a scope only has to pop from the heads.
+typedef struct Binding {
+    SymbolId name;
+    uint32_t value;
+    uint32_t next; // older binding in the same chain, index + 1, 0 at the end
+} Binding;
+
+typedef struct ScopeTable {
+    uint32_t* heads; // by hash: index + 1 of the newest binding in the chain, 0 if empty
+    uint32_t head_capacity; // power of two
+    Binding* bindings;
+    uint32_t binding_count;
+    uint32_t binding_capacity;
+    uint32_t* scope_starts; // binding_count when each open scope began
+    uint32_t depth;
+    uint32_t depth_capacity;
+} ScopeTable;
+
+void scope_init(ScopeTable* scopes);
+void scope_free(ScopeTable* scopes);
+void scope_push(ScopeTable* scopes);
+void scope_pop(ScopeTable* scopes);
+// Binds name in the innermost scope. Returns 0 if it is already bound there.
+int scope_define(ScopeTable* scopes, SymbolId name, uint32_t value);
+// The innermost binding of name into *value. Returns 0 if there is none.
+int scope_lookup(const ScopeTable* scopes, SymbolId name, uint32_t* value);
+
+#endif
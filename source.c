@@ -0,0 +1,110 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+#include "source.h"
+
+#define SOURCE_READ_CHUNK (64 * 1024) // initial buffer size for streamed input
+
+// Reads everything from fd into a heap buffer, doubling it as needed.
+static int read_stream(int fd, const char* path, SourceBuffer* source) {
+    size_t capacity = SOURCE_READ_CHUNK;
+    size_t length = 0;
+    char* buffer = (char*)malloc(capacity + SOURCE_PADDING);
+    if (!buffer) {
+        fprintf(stderr, "Memory allocation failed for source code.\n");
+        return -1;
+    }
+    for (;;) {
+        if (length == capacity) {
+            capacity *= 2;
+            char* grown = (char*)realloc(buffer, capacity + SOURCE_PADDING);
+            if (!grown) {
+                fprintf(stderr, "Memory reallocation failed for source code.\n");
+                free(buffer);
+                return -1;
+            }
+            buffer = grown;
+        }
+        ssize_t n = read(fd, buffer + length, capacity - length);
+        if (n == 0) break;
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "Error: Could not read source file '%s': %s\n", path, strerror(errno));
+            free(buffer);
+            return -1;
+        }
+        length += (size_t)n;
+    }
+    memset(buffer + length, 0, SOURCE_PADDING);
+    source->data = buffer;
+    source->length = length;
+    source->is_mapped = 0;
+    source->mapping_size = 0;
+    return 0;
+}
+
+#ifndef _WIN32
+// Maps a regular file read-only. An anonymous (zero-filled) region large enough
+// for the file plus the padding is reserved first and the file is mapped over
+// its start, so the sentinel bytes exist even when the size is a page multiple.
+static int map_file(int fd, size_t length, SourceBuffer* source) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mapping_size = (length + SOURCE_PADDING + page - 1) & ~(page - 1);
+    char* base = (char*)mmap(NULL, mapping_size, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return -1;
+    if (mmap(base, length, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, 0) == MAP_FAILED) {
+        munmap(base, mapping_size);
+        return -1;
+    }
+    source->data = base;
+    source->length = length;
+    source->is_mapped = 1;
+    source->mapping_size = mapping_size;
+    return 0;
+}
+#endif
+
+int source_open(const char* path, SourceBuffer* source) {
+    if (strcmp(path, "-") == 0) {
+        return read_stream(STDIN_FILENO, "<stdin>", source);
+    }
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Could not open source file '%s'\n", path);
+        return -1;
+    }
+    int status = -1;
+#ifndef _WIN32
+    struct stat st;
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        status = map_file(fd, (size_t)st.st_size, source);
+    }
+#endif
+    // Pipes, FIFOs, empty/special files, or a failed mapping: read it as a stream
+    if (status != 0) {
+        status = read_stream(fd, path, source);
+    }
+    close(fd);
+    return status;
+}
+
+void source_close(SourceBuffer* source) {
+#ifndef _WIN32
+    if (source->is_mapped) {
+        munmap((void*)source->data, source->mapping_size);
+    } else
+#endif
+    {
+        free((void*)source->data);
+    }
+    source->data = NULL;
+    source->length = 0;
+}
@@ -0,0 +1,23 @@
+#ifndef SOURCE_H
+#define SOURCE_H
+
+#include <stddef.h>
+
+// At least this many zero bytes follow the last source byte, so the lexer can
+// stop on the '\0' sentinel (and look a few bytes ahead) without bounds checks.
+#define SOURCE_PADDING 64
+
+typedef struct SourceBuffer {
+    const char* data;    // source text followed by SOURCE_PADDING zero bytes
+    size_t length;       // bytes of source text, excluding the padding
+    int is_mapped;       // 1 if data is a read-only file mapping, 0 if heap-allocated
+    size_t mapping_size; // bytes reserved for the mapping (mapped buffers only)
+} SourceBuffer;
+
+// Loads a source file. Regular files are mmap'ed read-only; stdin ("-"),
+// pipes and other streams are read into a growable heap buffer.
+// Returns 0 on success, -1 after printing a diagnostic.
+int source_open(const char* path, SourceBuffer* source);
+void source_close(SourceBuffer* source);
+
+#endif
@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "stats.h"
+#include "emit.h"
+#include "peephole.h"
+
+static const char* const phase_names[PHASE_COUNT] = {
+    "read", "lex", "parse", "optimize", "codegen", "write", "run",
+};
+
+static const char* const cache_results[] = {"off", "miss", "hit"};
+
+static PhaseTime read_clocks() {
+    struct timespec ts;
+    PhaseTime now;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    now.wall = ts.tv_sec + ts.tv_nsec / 1e9;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    now.cpu = ts.tv_sec + ts.tv_nsec / 1e9;
+    return now;
+}
+
+void stats_init(CompileStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+void stats_phase_begin(CompileStats* stats) {
+    stats->started = read_clocks();
+}
+
+void stats_phase_end(CompileStats* stats, CompilePhase phase) {
+    PhaseTime now = read_clocks();
+    stats->phases[phase].wall += now.wall - stats->started.wall;
+    stats->phases[phase].cpu += now.cpu - stats->started.cpu;
+}
+
+static long process_peak_rss_kb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    return usage.ru_maxrss; // KiB on Linux
+}
+
+static size_t total_nodes(const CompileStats* stats) {
+    size_t total = 0;
+    for (int i = 0; i < AST_NODE_TYPE_COUNT; ++i) total += stats->nodes_by_type[i];
+    return total;
+}
+
+static size_t total_peephole_hits(const CompileStats* stats) {
+    size_t total = 0;
+    for (int i = 0; i < PEEPHOLE_RULE_COUNT; ++i) total += stats->peephole_hits[i];
+    return total;
+}
+
+static void format_table(Emitter* out, const CompileStats* stats, const char* input_path) {
+    PhaseTime total = {0, 0};
+    emit_fmt(out, "--- Time report for %s ---\n", input_path);
+    emit_fmt(out, "  %-10s %12s %12s\n", "phase", "wall ms", "cpu ms");
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        emit_fmt(out, "  %-10s %12.3f %12.3f\n", phase_names[i],
+                 stats->phases[i].wall * 1e3, stats->phases[i].cpu * 1e3);
+        total.wall += stats->phases[i].wall;
+        total.cpu += stats->phases[i].cpu;
+    }
+    emit_fmt(out, "  %-10s %12.3f %12.3f\n", "total", total.wall * 1e3, total.cpu * 1e3);
+    if (stats->prelexed) {
+        emit_fmt(out, "  (lex filled the token array; parse only walked it)\n");
+    } else {
+        emit_fmt(out, "  (lex is a separate pass; parse includes the lexing it drives)\n");
+    }
+    emit_fmt(out, "--- Counters ---\n");
+    emit_fmt(out, "  %-18s %12zu\n", "source bytes", stats->source_bytes);
+    emit_fmt(out, "  %-18s %12zu\n", "tokens", stats->tokens);
+    emit_fmt(out, "  %-18s %12zu\n", "symbols", stats->symbols);
+    emit_fmt(out, "  %-18s %12zu\n", "AST nodes", total_nodes(stats));
+    for (int i = 0; i < AST_NODE_TYPE_COUNT; ++i) {
+        if (stats->nodes_by_type[i]) {
+            emit_fmt(out, "    %-16s %12zu\n", ast_node_type_name((ASTNodeType)i), stats->nodes_by_type[i]);
+        }
+    }
+    emit_fmt(out, "  %-18s %12zu\n", "AST grows", stats->ast_grows);
+    emit_fmt(out, "  %-18s %12zu\n", "AST bytes", stats->ast_bytes);
+    emit_fmt(out, "  %-18s %12zu\n", "simplifications", stats->simplifications);
+    emit_fmt(out, "  %-18s %12zu\n", "inlined calls", stats->inlined_calls);
+    emit_fmt(out, "    %-16s %12zu\n", "nodes added", stats->inline_growth);
+    emit_fmt(out, "  %-18s %12zu\n", "dead functions", stats->removed_functions);
+    emit_fmt(out, "  %-18s %12zu\n", "dead statements", stats->removed_statements);
+    emit_fmt(out, "  %-18s %12zu\n", "instructions", stats->instructions);
+    emit_fmt(out, "  %-18s %12zu\n", "peephole hits", total_peephole_hits(stats));
+    for (int i = 0; i < PEEPHOLE_RULE_COUNT; ++i) {
+        if (stats->peephole_hits[i]) {
+            emit_fmt(out, "    %-16s %12zu\n", peephole_rule_name((PeepholeRule)i), stats->peephole_hits[i]);
+        }
+    }
+    emit_fmt(out, "  %-18s %12zu\n", "assembly bytes", stats->assembly_bytes);
+    emit_fmt(out, "  %-18s %12ld\n", "peak RSS KiB", stats->peak_rss_kb);
+    emit_fmt(out, "  %-18s %12s\n", "cache", cache_results[stats->cache]);
+}
+
+static void format_json(Emitter* out, const CompileStats* stats, const char* input_path) {
+    emit_text(out, "{\"file\":\"", 9);
+    for (const char* p = input_path; *p; ++p) {
+        if (*p == '"' || *p == '\\') emit_text(out, "\\", 1);
+        if ((unsigned char)*p < 0x20) emit_fmt(out, "\\u%04x", *p);
+        else emit_text(out, p, 1);
+    }
+    emit_text(out, "\",\"phases\":{", 12);
+    for (int i = 0; i < PHASE_COUNT; ++i) {
+        emit_fmt(out, "%s\"%s\":{\"wall_ms\":%.4f,\"cpu_ms\":%.4f}", i ? "," : "", phase_names[i],
+                 stats->phases[i].wall * 1e3, stats->phases[i].cpu * 1e3);
+    }
+    emit_fmt(out, "},\"source_bytes\":%zu,\"tokens\":%zu,\"prelexed\":%s,\"symbols\":%zu,\"ast_nodes\":%zu,"
+                  "\"nodes_by_type\":{", stats->source_bytes, stats->tokens, stats->prelexed ? "true" : "false",
+             stats->symbols, total_nodes(stats));
+    for (int i = 0; i < AST_NODE_TYPE_COUNT; ++i) {
+        emit_fmt(out, "%s\"%s\":%zu", i ? "," : "", ast_node_type_name((ASTNodeType)i), stats->nodes_by_type[i]);
+    }
+    emit_fmt(out, "},\"ast_grows\":%zu,\"ast_bytes\":%zu,\"simplifications\":%zu,\"inlined_calls\":%zu,"
+                  "\"inline_growth\":%zu,\"removed_functions\":%zu,\"removed_statements\":%zu,\"instructions\":%zu,"
+                  "\"peephole_hits\":{", stats->ast_grows, stats->ast_bytes, stats->simplifications, stats->inlined_calls,
+             stats->inline_growth, stats->removed_functions, stats->removed_statements, stats->instructions);
+    for (int i = 0; i < PEEPHOLE_RULE_COUNT; ++i) {
+        emit_fmt(out, "%s\"%s\":%zu", i ? "," : "", peephole_rule_name((PeepholeRule)i), stats->peephole_hits[i]);
+    }
+    emit_fmt(out, "},\"assembly_bytes\":%zu,\"peak_rss_kb\":%ld,\"cache\":\"%s\"}\n",
+             stats->assembly_bytes, stats->peak_rss_kb, cache_results[stats->cache]);
+}
+
+void stats_print(const CompileStats* stats, const char* input_path, StatsFormat format, FILE* out) {
+    CompileStats snapshot = *stats;
+    snapshot.peak_rss_kb = process_peak_rss_kb();
+    Emitter text;
+    emitter_init(&text);
+    if (format == STATS_JSON) {
+        format_json(&text, &snapshot, input_path);
+    } else {
+        format_table(&text, &snapshot, input_path);
+    }
+    fwrite(text.data, 1, text.length, out);
+    fflush(out);
+    emitter_free(&text);
+}
@@ -0,0 +1,73 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "ast.h"
+#include "emit.h"
+
+// --stats / --time-report: per-phase timings and counters for one file.
+// The counters themselves (tokens, nodes, AST grows, instructions, peephole
+// hits) are plain increments kept by the lexer, AST and emitter at all times; a
+// Compiler only owns a CompileStats, and only reads the clocks, when a
+// report was asked for.
+
+typedef enum {
+    STATS_OFF,
+    STATS_TABLE,
+    STATS_JSON, // one JSON object per line, one line per file
+} StatsFormat;
+
+typedef enum {
+    PHASE_READ,
+    PHASE_LEX,      // a separate lexing pass, the parser lexes again as it goes (unless prelexed)
+    PHASE_PARSE,    // includes the lexing done on demand by the parser (unless prelexed)
+    PHASE_OPTIMIZE,
+    PHASE_CODEGEN,
+    PHASE_WRITE,
+    PHASE_RUN,      // --run: loading and executing the program
+    PHASE_COUNT
+} CompilePhase;
+
+typedef enum {
+    CACHE_OFF,
+    CACHE_MISS,
+    CACHE_HIT, // nothing but read and write ran
+} CacheResult;
+
+typedef struct PhaseTime {
+    double wall; // seconds
+    double cpu;  // seconds of CPU time on the compiling thread
+} PhaseTime;
+
+typedef struct CompileStats {
+    PhaseTime phases[PHASE_COUNT];
+    PhaseTime started; // clock readings at stats_phase_begin
+    size_t source_bytes;
+    size_t tokens;
+    int prelexed; // --prelex: lex filled the token array the parser walked
+    size_t nodes_by_type[AST_NODE_TYPE_COUNT];
+    size_t ast_grows; // AST array reallocations
+    size_t ast_bytes;
+    size_t symbols;
+    size_t simplifications;
+    size_t inlined_calls;
+    size_t inline_growth; // AST nodes added by inlining
+    size_t removed_functions;
+    size_t removed_statements;
+    size_t instructions;
+    size_t peephole_hits[PEEPHOLE_RULE_COUNT];
+    size_t assembly_bytes;
+    CacheResult cache;
+    long peak_rss_kb; // whole process, so shared by files compiled in parallel
+} CompileStats;
+
+void stats_init(CompileStats* stats);
+void stats_phase_begin(CompileStats* stats);
+void stats_phase_end(CompileStats* stats, CompilePhase phase);
+
+// Prints the report for one input file in a single write, so reports of
+// files compiled in parallel do not interleave.
+void stats_print(const CompileStats* stats, const char* input_path, StatsFormat format, FILE* out);
+
+#endif
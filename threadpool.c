@@ -0,0 +1,143 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+#include "threadpool.h"
+
+int threadpool_cpu_count() {
+#ifdef _SC_NPROCESSORS_ONLN
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    if (n > 0) return n > 1024 ? 1024 : (int)n;
+#endif
+    return 1;
+}
+
+#ifdef _WIN32
+
+void parallel_for(size_t count, int thread_count, ParallelTask task, void* context) {
+    (void)thread_count; // no pthreads: run everything on the calling thread
+    for (size_t i = 0; i < count; ++i) task(context, i);
+}
+
+#else
+
+// Indices [next, end) not yet started by any thread. The owner takes from the
+// front, thieves take from the back; the lock is held only to move the bounds.
+typedef struct WorkRange {
+    pthread_mutex_t lock;
+    size_t next;
+    size_t end;
+} WorkRange;
+
+typedef struct WorkPool {
+    WorkRange* ranges;
+    int worker_count;
+    ParallelTask task;
+    void* context;
+} WorkPool;
+
+typedef struct Worker {
+    WorkPool* pool;
+    int id;
+} Worker;
+
+static int take_own(WorkRange* range, size_t* index) {
+    int found = 0;
+    pthread_mutex_lock(&range->lock);
+    if (range->next < range->end) {
+        *index = range->next++;
+        found = 1;
+    }
+    pthread_mutex_unlock(&range->lock);
+    return found;
+}
+
+// Moves the back half of some other worker's range into ours.
+// Returns 0 once every range is empty.
+static int steal(WorkPool* pool, int self) {
+    for (int k = 1; k < pool->worker_count; ++k) {
+        WorkRange* victim = &pool->ranges[(self + k) % pool->worker_count];
+        size_t lo = 0, hi = 0;
+        pthread_mutex_lock(&victim->lock);
+        size_t left = victim->end - victim->next;
+        if (left > 0) {
+            hi = victim->end;
+            lo = hi - (left + 1) / 2; // a single item left is taken whole
+            victim->end = lo;
+        }
+        pthread_mutex_unlock(&victim->lock);
+        if (lo < hi) {
+            WorkRange* own = &pool->ranges[self];
+            pthread_mutex_lock(&own->lock);
+            own->next = lo;
+            own->end = hi;
+            pthread_mutex_unlock(&own->lock);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void* worker_main(void* arg) {
+    Worker* worker = (Worker*)arg;
+    WorkPool* pool = worker->pool;
+    WorkRange* own = &pool->ranges[worker->id];
+    for (;;) {
+        size_t index;
+        while (take_own(own, &index)) {
+            pool->task(pool->context, index);
+        }
+        if (!steal(pool, worker->id)) return NULL;
+    }
+}
+
+void parallel_for(size_t count, int thread_count, ParallelTask task, void* context) {
+    if (thread_count < 1) thread_count = 1;
+    if ((size_t)thread_count > count) thread_count = (int)count;
+    if (thread_count <= 1) {
+        for (size_t i = 0; i < count; ++i) task(context, i);
+        return;
+    }
+
+    WorkPool pool;
+    pool.worker_count = thread_count;
+    pool.task = task;
+    pool.context = context;
+    pool.ranges = (WorkRange*)malloc(sizeof(WorkRange) * thread_count);
+    Worker* workers = (Worker*)malloc(sizeof(Worker) * thread_count);
+    pthread_t* threads = (pthread_t*)malloc(sizeof(pthread_t) * thread_count);
+    if (!pool.ranges || !workers || !threads) {
+        fprintf(stderr, "Memory allocation failed for the thread pool.\n");
+        exit(1);
+    }
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_mutex_init(&pool.ranges[i].lock, NULL);
+        pool.ranges[i].next = count * i / thread_count;
+        pool.ranges[i].end = count * (i + 1) / thread_count;
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+
+    // Worker 0 is the calling thread; if a thread cannot be started its slice
+    // is simply stolen by the others
+    int started = 1;
+    for (int i = 1; i < thread_count; ++i) {
+        if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) break;
+        started++;
+    }
+    worker_main(&workers[0]);
+    for (int i = 1; i < started; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_mutex_destroy(&pool.ranges[i].lock);
+    }
+    free(threads);
+    free(workers);
+    free(pool.ranges);
+}
+
+#endif
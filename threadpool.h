@@ -0,0 +1,20 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <stddef.h>
+
+// One unit of work; index runs over [0, count) of the parallel_for call
+typedef void (*ParallelTask)(void* context, size_t index);
+
+// Online CPUs, at least 1
+int threadpool_cpu_count();
+
+// Runs task(context, i) for every i in [0, count) on up to thread_count
+// threads, the caller being one of them, and returns when all are done.
+// Each thread starts with its own contiguous slice of the indices and takes
+// work from the front of it; a thread whose slice runs dry steals the back
+// half of another thread's slice, so a few slow items do not leave the other
+// threads idle.
+void parallel_for(size_t count, int thread_count, ParallelTask task, void* context);
+
+#endif
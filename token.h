@@ -1,34 +1,54 @@
-#ifndef TOKEN_H
-#define TOKEN_H
-// header file
-typedef enum{
-    TOKEN_EOF = 0, // End of file
-    TOKEN_NUMBER, //REST ALL NUMBERS ARE AUTOMATICALLY ASSUMED
-    TOKEN_PLUS,
-    TOKEN_MINUS,
-    TOKEN_MULTIPLY,
-    TOKEN_DIVIDE,
-    TOKEN_LPAREN, // (
-    TOKEN_RPAREN, // )
-    TOKEN_IDENTIFIER,
-    TOKEN_SEMICOLON, // ;
-    TOKEN_LBRACE,    // {
-    TOKEN_RBRACE,    // }
-    TOKEN_RETURN,    // return keyword
-    TOKEN_INT,       // int keyword
-    TOKEN_COMMA,     // ,
-    TOKEN_ASSIGN
-}TokenType;
-
-// a token has two attributes, type and class
-// so we make a token structure having type and class
-typedef struct{
-    TokenType type; 
-    union{ //uses memory for more efficient management
-    int int_value; // classification of the token
-    char* string_value; // actual text of the token
-    }value;
-}Token;
-// we make two more functions create token to initialse a token and free_token to free up the memory
-Token getNextToken();
-#endif
+#ifndef TOKEN_H
+#define TOKEN_H
+#include <stdint.h>
+#include "intern.h"
+// header file
+typedef enum{
+    TOKEN_EOF = 0, // End of file
+    TOKEN_NUMBER, //REST ALL NUMBERS ARE AUTOMATICALLY ASSUMED
+    TOKEN_PLUS,
+    TOKEN_MINUS,
+    TOKEN_MULTIPLY,
+    TOKEN_DIVIDE,
+    TOKEN_LPAREN, // (
+    TOKEN_RPAREN, // )
+    TOKEN_IDENTIFIER,
+    TOKEN_SEMICOLON, // ;
+    TOKEN_LBRACE,    // {
+    TOKEN_RBRACE,    // }
+    TOKEN_RETURN,    // return keyword
+    TOKEN_INT,       // int keyword
+    TOKEN_COMMA,     // ,
+    TOKEN_ASSIGN
+}TokenType;
+
+typedef union{
+    int int_value; // value of a TOKEN_NUMBER
+    SymbolId symbol; // interned name of a TOKEN_IDENTIFIER (keywords carry no value)
+}TokenValue;
+
+// A token is its type, the span of source text it was read from, and for
+// numbers and identifiers a value. Tokens own no memory: identifier text
+// stays in the source buffer and is referred to by its interned symbol.
+typedef struct{
+    TokenType type;
+    uint32_t offset; // byte offset of the first character in the source buffer
+    uint32_t length; // bytes of source text
+    uint32_t line;   // 1-based
+    uint32_t column; // 1-based, in bytes
+    TokenValue value;
+}Token;
+
+// A whole file lexed up front, one entry per token in parallel arrays so the
+// parser's walk over the kinds touches one byte per token. The last token is
+// always a TOKEN_EOF. Line and column are not stored; see token_array_position.
+typedef struct{
+    uint8_t* kinds;      // TokenType
+    TokenValue* values;
+    uint32_t* offsets;   // as Token.offset
+    uint32_t* lengths;   // as Token.length
+    size_t count;
+    size_t capacity;
+    const char* source;  // the buffer the offsets are relative to
+}TokenArray;
+#endif
@@ -0,0 +1,489 @@
+// Compile-time benchmark: generates synthetic sources in memory and times
+// each phase of the pipeline on them, alone and together.
+//   gcc -O2 -o bench tools/bench.c intern.c scan.c lexer.c parser.c ast.c
+//       optimize.c emit.c encode.c peephole.c ir.c lower.c scope.c codegen.c threadpool.c -lpthread
+//   ./bench [--scale N] [--repeat N] [--workload name] [--json file] [--label text] [--dump dir]
+//           [--lex-threads N]
+// Phases: lex (getNextToken loop), prelex (lex_tokens into a token array on
+// --lex-threads threads), parse (parse_program, which pulls its own tokens),
+// parse_only (parse_program over an already filled token array), codegen
+// (generate_code on an already parsed tree, peephole pass included) and full (lex, parse, optimize and
+// codegen into memory; nothing is written).
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include "../source.h"
+#include "../intern.h"
+#include "../ast.h"
+#include "../lexer.h"
+#include "../parser.h"
+#include "../optimize.h"
+#include "../codegen.h"
+#include "../emit.h"
+#include "../scan.h"
+
+// Heap allocation counter. With glibc the definitions below take the place of
+// malloc/calloc/realloc for the whole program and forward to the real ones.
+static size_t heap_allocs = 0;
+
+#ifdef __GLIBC__
+extern void* __libc_malloc(size_t size);
+extern void* __libc_calloc(size_t count, size_t size);
+extern void* __libc_realloc(void* ptr, size_t size);
+
+void* malloc(size_t size) {
+    heap_allocs++;
+    return __libc_malloc(size);
+}
+void* calloc(size_t count, size_t size) {
+    heap_allocs++;
+    return __libc_calloc(count, size);
+}
+void* realloc(void* ptr, size_t size) {
+    heap_allocs++;
+    return __libc_realloc(ptr, size);
+}
+#define HAVE_HEAP_COUNTS 1
+#else
+#define HAVE_HEAP_COUNTS 0
+#endif
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Resets the kernel's peak RSS mark (Linux 4.0+) so each phase gets its own.
+// Without it the reported peak is that of the process so far.
+static void reset_peak_rss() {
+    int fd = open("/proc/self/clear_refs", O_WRONLY);
+    if (fd < 0) return;
+    if (write(fd, "5", 1) != 1) { /* not supported: keep the process-wide peak */ }
+    close(fd);
+}
+
+// Peak resident set size in KiB
+static long peak_rss_kb() {
+    FILE* status = fopen("/proc/self/status", "r");
+    if (status) {
+        char line[256];
+        long kb = -1;
+        while (fgets(line, sizeof(line), status)) {
+            if (sscanf(line, "VmHWM: %ld kB", &kb) == 1) break;
+        }
+        fclose(status);
+        if (kb >= 0) return kb;
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+// ---- Workload generators ----
+// Each one appends a valid program to an Emitter used as a text buffer.
+// Division only ever uses non-zero constants so -O1 folding accepts them.
+
+static void gen_flat_expression(Emitter* out, size_t scale) {
+    size_t terms = 20000 * scale;
+    emit_fmt(out, "int main() {\n    return 1");
+    for (size_t i = 1; i < terms; ++i) {
+        static const char ops[] = "+-*+/+";
+        char op = ops[i % 6];
+        emit_fmt(out, "%c%zu", op, i % 9 + 1);
+        if (i % 16 == 0) emit_text(out, "\n        ", 9);
+    }
+    emit_fmt(out, ";\n}\n");
+}
+
+static void gen_deep_parens(Emitter* out, size_t scale) {
+    size_t depth = 2000 * scale;
+    emit_fmt(out, "int main() {\n    return ");
+    for (size_t i = 0; i < depth; ++i) emit_fmt(out, "(%zu+", i % 7 + 1);  // right-nested half
+    for (size_t i = 0; i < depth; ++i) emit_text(out, "(", 1);              // left-nested half
+    emit_text(out, "1", 1);
+    for (size_t i = 0; i < depth; ++i) emit_fmt(out, "*%zu)", i % 5 + 1);
+    for (size_t i = 0; i < depth; ++i) emit_text(out, ")", 1);
+    emit_fmt(out, ";\n}\n");
+}
+
+static void gen_many_functions(Emitter* out, size_t scale) {
+    size_t count = 5000 * scale;
+    emit_fmt(out, "int f0() {\n    return 1;\n}\n");
+    for (size_t i = 1; i < count; ++i) {
+        emit_fmt(out, "int f%zu() {\n    return f%zu() + %zu * 3 - (%zu / 2);\n}\n", i, (i * 7) % i, i % 100, i % 50 + 1);
+    }
+    emit_fmt(out, "int main() {\n    return f%zu() - f1();\n}\n", count - 1);
+}
+
+static void gen_wide_calls(Emitter* out, size_t scale) {
+    size_t sites = 2000 * scale;
+    emit_fmt(out, "int w6(int a, int b, int c, int d, int e, int f) {\n    return 6;\n}\n");
+    emit_fmt(out, "int w8(int a, int b, int c, int d, int e, int f, int g, int h) {\n    return 8;\n}\n");
+    emit_fmt(out, "int main() {\n");
+    for (size_t i = 0; i < sites; ++i) {
+        switch (i % 3) {
+            case 0: emit_fmt(out, "    w6(1, 2, 3, 4, 5, %zu);\n", i % 10); break;
+            case 1: emit_fmt(out, "    w8(1, 2, 3, 4, 5, 6, 7, %zu);\n", i % 10); break;
+            default: emit_fmt(out, "    w8(w6(1, 2, 3, 4, 5, 6), 2, 3 * 4, 4, w6(1, 1, 1, 1, 1, 1) + 5, 6, 7, %zu);\n", i % 10); break;
+        }
+    }
+    emit_fmt(out, "    return w8(1, 2, 3, 4, 5, 6, 7, 8);\n}\n");
+}
+
+static void gen_comment_heavy(Emitter* out, size_t scale) {
+    size_t count = 1000 * scale;
+    for (size_t i = 0; i < count; ++i) {
+        emit_fmt(out, "/*\n * Function c%zu.\n * Block comments spanning several lines, with stray * and / inside:\n"
+                      " * a / b * c // not a line comment here\n *******************************/\n", i);
+        emit_fmt(out, "// Line comment before the definition of c%zu, long enough to need a few vector blocks\n", i);
+        emit_fmt(out, "int c%zu() {\n", i);
+        emit_fmt(out, "    // the body returns a constant\n");
+        emit_fmt(out, "    return /* left */ %zu /* op */ + /* right */ 1; // trailing comment\n", i % 100);
+        emit_fmt(out, "}\n\n");
+    }
+    emit_fmt(out, "int main() {\n    return c0();\n}\n");
+}
+
+typedef struct Workload {
+    const char* name;
+    void (*generate)(Emitter* out, size_t scale);
+} Workload;
+
+static const Workload workloads[] = {
+    {"flat_expression", gen_flat_expression},
+    {"deep_parens", gen_deep_parens},
+    {"many_functions", gen_many_functions},
+    {"wide_calls", gen_wide_calls},
+    {"comment_heavy", gen_comment_heavy},
+};
+#define WORKLOAD_COUNT (sizeof(workloads) / sizeof(workloads[0]))
+
+// ---- Phases ----
+
+typedef enum { PHASE_LEX, PHASE_PRELEX, PHASE_PARSE, PHASE_PARSE_ONLY, PHASE_CODEGEN, PHASE_FULL, PHASE_COUNT } Phase;
+static const char* const phase_names[PHASE_COUNT] = {"lex", "prelex", "parse", "parse_only", "codegen", "full"};
+
+typedef struct PhaseResult {
+    double best_seconds;
+    double total_seconds;
+    size_t heap_allocs;  // per run
+    size_t ast_grows; // per run
+    long peak_rss_kb;
+} PhaseResult;
+
+typedef struct WorkloadResult {
+    const char* name;
+    size_t source_bytes;
+    size_t tokens;
+    size_t ast_nodes;
+    size_t assembly_bytes;
+    PhaseResult phases[PHASE_COUNT];
+} WorkloadResult;
+
+typedef struct Run {
+    const char* source; // followed by SOURCE_PADDING zero bytes
+    size_t source_length;
+    int lex_threads;
+    const TokenArray* tokens; // token array for the parse_only phase
+    const AST* parsed_ast; // tree for the codegen phase
+    NodeId parsed;
+    const Interner* parsed_names;
+    const OptimizeOptions* optimize;
+    WorkloadResult* result;
+} Run;
+
+static size_t run_lex(Run* run) {
+    Interner names;
+    Lexer lexer;
+    size_t tokens = 0;
+    interner_init(&names);
+    lexer_init(&lexer, run->source, &names);
+    while (getNextToken(&lexer).type != TOKEN_EOF) {
+        tokens++;
+    }
+    interner_free(&names);
+    run->result->tokens = tokens;
+    return 0;
+}
+
+static size_t run_prelex(Run* run) {
+    Interner names;
+    TokenArray tokens;
+    interner_init(&names);
+    lex_tokens(&tokens, run->source, run->source_length, &names, run->lex_threads);
+    token_array_free(&tokens);
+    interner_free(&names);
+    return 0;
+}
+
+static size_t run_parse(Run* run) {
+    Interner names;
+    AST ast;
+    Lexer lexer;
+    Parser parser;
+    interner_init(&names);
+    ast_init(&ast);
+    lexer_init(&lexer, run->source, &names);
+    parser_init(&parser, &lexer, &ast);
+    parse_program(&parser);
+    size_t ast_grows = ast.grow_count;
+    run->result->ast_nodes = ast.node_count;
+    ast_release(&ast);
+    interner_free(&names);
+    return ast_grows;
+}
+
+static size_t run_parse_only(Run* run) {
+    AST ast;
+    Parser parser;
+    ast_init(&ast);
+    parser_init_tokens(&parser, run->tokens, &ast);
+    parse_program(&parser);
+    size_t ast_grows = ast.grow_count;
+    ast_release(&ast);
+    return ast_grows;
+}
+
+static size_t run_codegen(Run* run) {
+    Emitter assembly;
+    emitter_init(&assembly);
+    assembly.peephole = run->optimize->peephole;
+    generate_code(run->parsed_ast, run->parsed, run->parsed_names, run->optimize, &assembly);
+    run->result->assembly_bytes = assembly.length;
+    emitter_free(&assembly);
+    return 0;
+}
+
+static size_t run_full(Run* run) {
+    Interner names;
+    AST ast;
+    Lexer lexer;
+    Parser parser;
+    Emitter assembly;
+    interner_init(&names);
+    ast_init(&ast);
+    emitter_init(&assembly);
+    assembly.peephole = run->optimize->peephole;
+    lexer_init(&lexer, run->source, &names);
+    parser_init(&parser, &lexer, &ast);
+    NodeId program = parse_program(&parser);
+    OptimizeReport optimized;
+    optimize_program(&ast, program, &names, run->optimize, &optimized);
+    generate_code(&ast, program, &names, run->optimize, &assembly);
+    size_t ast_grows = ast.grow_count;
+    emitter_free(&assembly);
+    ast_release(&ast);
+    interner_free(&names);
+    return ast_grows;
+}
+
+static size_t (*const phase_runners[PHASE_COUNT])(Run* run) = {
+    run_lex, run_prelex, run_parse, run_parse_only, run_codegen, run_full,
+};
+
+static void measure_phase(Run* run, Phase phase, int repeat) {
+    PhaseResult* result = &run->result->phases[phase];
+    result->best_seconds = 0;
+    result->total_seconds = 0;
+    reset_peak_rss();
+    for (int i = 0; i < repeat; ++i) {
+        size_t allocs_before = heap_allocs;
+        double start = now_seconds();
+        result->ast_grows = phase_runners[phase](run);
+        double elapsed = now_seconds() - start;
+        result->heap_allocs = heap_allocs - allocs_before;
+        if (i == 0 || elapsed < result->best_seconds) result->best_seconds = elapsed;
+        result->total_seconds += elapsed;
+    }
+    result->peak_rss_kb = peak_rss_kb();
+}
+
+static void run_workload(const Workload* workload, size_t scale, int repeat, const char* dump_dir,
+                         int lex_threads, WorkloadResult* result) {
+    Emitter text;
+    emitter_init(&text);
+    workload->generate(&text, scale);
+    size_t length = text.length;
+    static const char padding[SOURCE_PADDING] = {0};
+    emit_text(&text, padding, sizeof(padding)); // the lexer's end-of-input sentinel
+
+    memset(result, 0, sizeof(*result));
+    result->name = workload->name;
+    result->source_bytes = length;
+
+    if (dump_dir) {
+        char path[4096];
+        snprintf(path, sizeof(path), "%s/%s.c", dump_dir, workload->name);
+        FILE* file = fopen(path, "wb");
+        if (!file || fwrite(text.data, 1, length, file) != length) {
+            fprintf(stderr, "bench: could not write '%s'\n", path);
+            exit(1);
+        }
+        fclose(file);
+    }
+
+    OptimizeOptions optimize;
+    optimize_options_for_level(&optimize, 1);
+    Run run = {text.data, length, lex_threads, NULL, NULL, NODE_NONE, NULL, &optimize, result};
+
+    measure_phase(&run, PHASE_LEX, repeat);
+    measure_phase(&run, PHASE_PRELEX, repeat);
+    measure_phase(&run, PHASE_PARSE, repeat);
+
+    // parse_only walks one token array, and codegen runs on the unoptimized
+    // tree parsed from it outside the timed region
+    Interner names;
+    TokenArray tokens;
+    AST ast;
+    Parser parser;
+    interner_init(&names);
+    lex_tokens(&tokens, text.data, length, &names, 1);
+    run.tokens = &tokens;
+    measure_phase(&run, PHASE_PARSE_ONLY, repeat);
+    ast_init(&ast);
+    parser_init_tokens(&parser, &tokens, &ast);
+    run.parsed = parse_program(&parser);
+    run.parsed_ast = &ast;
+    run.parsed_names = &names;
+    measure_phase(&run, PHASE_CODEGEN, repeat);
+    ast_release(&ast);
+    token_array_free(&tokens);
+    interner_free(&names);
+
+    measure_phase(&run, PHASE_FULL, repeat);
+    emitter_free(&text);
+}
+
+// ---- Reporting ----
+
+static double mb_per_second(size_t bytes, double seconds) {
+    return seconds > 0 ? bytes / seconds / (1024.0 * 1024.0) : 0.0;
+}
+
+static void print_table(const WorkloadResult* results, size_t count, int repeat) {
+    printf("%-16s %-10s %10s %10s %10s %12s %12s %10s\n",
+           "workload", "phase", "best ms", "mean ms", "MB/s", "heap allocs", "AST grows", "peak KiB");
+    for (size_t w = 0; w < count; ++w) {
+        const WorkloadResult* r = &results[w];
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            const PhaseResult* phase = &r->phases[p];
+            printf("%-16s %-10s %10.3f %10.3f %10.1f %12zu %12zu %10ld\n",
+                   p == 0 ? r->name : "", phase_names[p], phase->best_seconds * 1e3,
+                   phase->total_seconds * 1e3 / repeat,
+                   mb_per_second(r->source_bytes, phase->best_seconds),
+                   phase->heap_allocs, phase->ast_grows, phase->peak_rss_kb);
+        }
+        printf("%-16s %zu bytes, %zu tokens, %zu AST nodes, %zu bytes of assembly\n",
+               "", r->source_bytes, r->tokens, r->ast_nodes, r->assembly_bytes);
+    }
+}
+
+static void print_json_string(FILE* out, const char* text) {
+    fputc('"', out);
+    for (const char* p = text; *p; ++p) {
+        if (*p == '"' || *p == '\\') fputc('\\', out);
+        if ((unsigned char)*p < 0x20) fprintf(out, "\\u%04x", *p);
+        else fputc(*p, out);
+    }
+    fputc('"', out);
+}
+
+static void write_json(FILE* out, const char* label, size_t scale, int repeat,
+                       const WorkloadResult* results, size_t count) {
+    fprintf(out, "{\n  \"label\": ");
+    print_json_string(out, label ? label : "");
+    fprintf(out, ",\n  \"scale\": %zu,\n  \"repeat\": %d,\n  \"scanner\": \"%s\",\n  \"heap_counts\": %s,\n",
+            scale, repeat, scan_isa_name(), HAVE_HEAP_COUNTS ? "true" : "false");
+    fprintf(out, "  \"workloads\": [\n");
+    for (size_t w = 0; w < count; ++w) {
+        const WorkloadResult* r = &results[w];
+        fprintf(out, "    {\n      \"name\": \"%s\",\n      \"source_bytes\": %zu,\n      \"tokens\": %zu,\n"
+                     "      \"ast_nodes\": %zu,\n      \"assembly_bytes\": %zu,\n      \"phases\": {\n",
+                r->name, r->source_bytes, r->tokens, r->ast_nodes, r->assembly_bytes);
+        for (int p = 0; p < PHASE_COUNT; ++p) {
+            const PhaseResult* phase = &r->phases[p];
+            fprintf(out, "        \"%s\": {\"best_ms\": %.4f, \"mean_ms\": %.4f, \"mb_per_s\": %.2f, "
+                         "\"heap_allocs\": %zu, \"ast_grows\": %zu, \"peak_rss_kb\": %ld}%s\n",
+                    phase_names[p], phase->best_seconds * 1e3, phase->total_seconds * 1e3 / repeat,
+                    mb_per_second(r->source_bytes, phase->best_seconds),
+                    phase->heap_allocs, phase->ast_grows, phase->peak_rss_kb,
+                    p + 1 < PHASE_COUNT ? "," : "");
+        }
+        fprintf(out, "      }\n    }%s\n", w + 1 < count ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+static void print_usage(const char* program) {
+    fprintf(stderr, "Usage: %s [--scale N] [--repeat N] [--workload name] [--json file | -] [--label text] [--dump dir]\n"
+                    "       [--lex-threads N]\n", program);
+    fprintf(stderr, "Workloads:");
+    for (size_t i = 0; i < WORKLOAD_COUNT; ++i) fprintf(stderr, " %s", workloads[i].name);
+    fprintf(stderr, "\n");
+}
+
+int main(int argc, char* argv[]) {
+    size_t scale = 1;
+    int repeat = 5;
+    const char* only = NULL;
+    const char* json_path = NULL;
+    const char* label = NULL;
+    const char* dump_dir = NULL;
+    int lex_threads = 1;
+    for (int i = 1; i < argc; ++i) {
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--scale") == 0 && value && atoi(value) > 0) {
+            scale = (size_t)atoi(value);
+        } else if (strcmp(argv[i], "--repeat") == 0 && value && atoi(value) > 0) {
+            repeat = atoi(value);
+        } else if (strcmp(argv[i], "--workload") == 0 && value) {
+            only = value;
+        } else if (strcmp(argv[i], "--json") == 0 && value) {
+            json_path = value;
+        } else if (strcmp(argv[i], "--label") == 0 && value) {
+            label = value;
+        } else if (strcmp(argv[i], "--lex-threads") == 0 && value && atoi(value) > 0) {
+            lex_threads = atoi(value);
+        } else if (strcmp(argv[i], "--dump") == 0 && value) {
+            dump_dir = value;
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+
+    scan_init();
+    WorkloadResult results[WORKLOAD_COUNT];
+    size_t count = 0;
+    for (size_t i = 0; i < WORKLOAD_COUNT; ++i) {
+        if (only && strcmp(only, workloads[i].name) != 0) continue;
+        run_workload(&workloads[i], scale, repeat, dump_dir, lex_threads, &results[count++]);
+    }
+    if (count == 0) {
+        fprintf(stderr, "bench: unknown workload '%s'\n", only);
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    int json_to_stdout = json_path && strcmp(json_path, "-") == 0;
+    if (!json_to_stdout) {
+        printf("--- Benchmark: scale %zu, best of %d runs, %s scanner ---\n", scale, repeat, scan_isa_name());
+        print_table(results, count, repeat);
+    }
+    if (json_path) {
+        FILE* out = json_to_stdout ? stdout : fopen(json_path, "w");
+        if (!out) {
+            fprintf(stderr, "bench: could not open '%s'\n", json_path);
+            return 1;
+        }
+        write_json(out, label, scale, repeat, results, count);
+        if (!json_to_stdout) fclose(out);
+    }
+    return 0;
+}
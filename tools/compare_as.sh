@@ -0,0 +1,79 @@
+#!/bin/sh
+# Checks the object writer against GNU as: every sample is compiled at -O0 and
+# -O1 both straight to an object file (-c) and to assembly that as turns into
+# one, and the two objects must have the same .text bytes, the same
+# relocations (offset, type, symbol and addend, in order) and the same symbols.
+#   tools/compare_as.sh [compiler] [sample.c ...]
+# The compiler defaults to ./razancompiler and the samples to test.c and
+# tools/corpus/*.c. Needs as, objcopy and readelf from binutils; prints each
+# mismatch and exits 1 if there was any.
+rc=${1:-./razancompiler}
+[ $# -gt 0 ] && shift
+if [ $# -eq 0 ]; then
+    set -- test.c tools/corpus/*.c
+fi
+
+if [ ! -x "$rc" ]; then
+    echo "Error: compiler '$rc' not found; build it first (see README)." >&2
+    exit 2
+fi
+
+work=$(mktemp -d) || exit 2
+trap 'rm -rf "$work"' EXIT
+
+relocs() {
+    readelf -rW "$1" | awk '$1 ~ /^[0-9a-f]+$/ {print $1, $3, $5, $6, $7}'
+}
+
+symbols() {
+    readelf -sW "$1" | awk 'NR > 3 {print $2, $4, $5, $7, $8}' | sort
+}
+
+checked=0
+failed=0
+for src in "$@"; do
+    for opt in -O0 -O1; do
+        checked=$((checked + 1))
+        name="$src $opt"
+        if ! "$rc" $opt -c -o "$work/direct.o" "$src" >/dev/null 2>"$work/err" ||
+           ! "$rc" $opt -o "$work/out.s" "$src" >/dev/null 2>>"$work/err"; then
+            echo "$name: compile failed"
+            sed 's/^/    /' "$work/err"
+            failed=$((failed + 1))
+            continue
+        fi
+        if ! as -o "$work/as.o" "$work/out.s" 2>"$work/err"; then
+            echo "$name: as rejected the assembly"
+            sed 's/^/    /' "$work/err"
+            failed=$((failed + 1))
+            continue
+        fi
+
+        bad=0
+        objcopy -O binary -j .text "$work/direct.o" "$work/direct.text"
+        objcopy -O binary -j .text "$work/as.o" "$work/as.text"
+        if ! cmp -s "$work/direct.text" "$work/as.text"; then
+            echo "$name: .text differs"
+            cmp -l "$work/direct.text" "$work/as.text" 2>&1 | head -n 5 | sed 's/^/    /'
+            bad=1
+        fi
+        relocs "$work/direct.o" > "$work/direct.rel"
+        relocs "$work/as.o" > "$work/as.rel"
+        if ! cmp -s "$work/direct.rel" "$work/as.rel"; then
+            echo "$name: relocations differ (< ours, > as)"
+            diff "$work/direct.rel" "$work/as.rel" | head -n 10 | sed 's/^/    /'
+            bad=1
+        fi
+        symbols "$work/direct.o" > "$work/direct.sym"
+        symbols "$work/as.o" > "$work/as.sym"
+        if ! cmp -s "$work/direct.sym" "$work/as.sym"; then
+            echo "$name: symbols differ (< ours, > as)"
+            diff "$work/direct.sym" "$work/as.sym" | head -n 10 | sed 's/^/    /'
+            bad=1
+        fi
+        failed=$((failed + bad))
+    done
+done
+
+echo "$((checked - failed)) of $checked objects match as"
+[ "$failed" -eq 0 ]
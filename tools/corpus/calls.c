@@ -0,0 +1,26 @@
+// Calls: register and stack arguments, arguments that are calls themselves,
+// and calls to functions defined elsewhere, which leave relocations for the
+// linker. value() is defined elsewhere too, so nothing here folds away.
+int pick(int a, int b, int c) {
+    return value(3) + 1;
+}
+
+int eight(int a, int b, int c, int d, int e, int f, int g, int h) {
+    return value(8) * 2;
+}
+
+int nine(int a, int b, int c, int d, int e, int f, int g, int h, int i) {
+    return eight(value(1), value(2), 3, 4, value(5), 6, 7, value(8)) - 1;
+}
+
+int nested() {
+    return pick(pick(value(1), 2, 3), eight(1, 2, 3, 4, 5, 6, 7, 8), pick(value(2), value(3), nine(1, 2, 3, 4, 5, 6, 7, 8, 9)));
+}
+
+int external() {
+    return helper(value(5), 2) + helper(helper(value(3), 3), 7) * 2;
+}
+
+int main() {
+    return nested() + external() - nine(9, 8, 7, 6, 5, 4, 3, 2, 1);
+}
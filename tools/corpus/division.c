@@ -0,0 +1,22 @@
+// Division: by powers of two, by other constants of both signs, by +-1 and
+// the int limits, and by values only known at run time, with many values
+// live at once
+int constants() {
+    return value(1) / 2 + value(2) / 8 + value(3) / (0 - 16) + value(4) / 3 + value(5) / 7 + value(6) / (0 - 7)
+        + value(7) / 641 + value(8) / 1000000007 + value(9) / (0 - 1) + value(10) / 2147483647
+        + value(11) / (0 - 2147483647 - 1);
+}
+
+int variables() {
+    return value(1) / value(2) + value(3) / value(4) - value(5) / value(6) + (value(7) + value(8)) / (value(1) - value(8));
+}
+
+int crowded() {
+    return (value(1) + value(2)) / 3 * (value(3) + value(4)) / 5 + (value(5) - value(6)) / 9 * (value(1) - value(4)) / 11
+        + (value(2) * value(3)) / 13 * (value(5) * value(6)) / 17 + (value(1) * value(6)) / (0 - 19) * (value(2) * value(5)) / 21
+        + (value(3) + value(6)) / 1024 * (value(1) + value(5)) / (0 - 4096);
+}
+
+int main() {
+    return constants() + variables() + crowded() + 100 / 7 + (0 - 100) / 7;
+}
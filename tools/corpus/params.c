@@ -0,0 +1,39 @@
+// Parameters: read in place from their argument registers and from the
+// caller's stack past the sixth, kept across calls, divided by constants and
+// by each other, and passed on in a different order, also in tail position
+int add3(int a, int b, int c) {
+    return a + b + c;
+}
+
+int mix8(int a, int b, int c, int d, int e, int f, int g, int h) {
+    return a * 8 + b * 7 + c * 6 + d * 5 + e * 4 + f * 3 + g * 2 + h;
+}
+
+int swap9(int a, int b, int c, int d, int e, int f, int g, int h, int i) {
+    return mix8(i, h, g, f, e, d, c, b) - a;
+}
+
+int rotate(int a, int b, int c) {
+    return add3(c, a, b) + add3(b, c, a);
+}
+
+int keep(int a, int b, int c, int d) {
+    return a + helper(b, 1) + b * helper(c, 2) + c * helper(d, 3) + d * helper(a, 4) + a * b * c * d;
+}
+
+int divide(int a, int b, int c, int d, int e, int f, int g, int h) {
+    return a / b + c / d - e / f + (g + h) / (a - h) + h / g + a / 3 + b / (0 - 7) + c / 1024;
+}
+
+int count(int n, int total) {
+    return count(n - 1, total + n);
+}
+
+int spin8(int a, int b, int c, int d, int e, int f, int g, int h) {
+    return spin8(h, a, b, c, d, e, f, g + 1);
+}
+
+int main() {
+    return swap9(9, 8, 7, 6, 5, 4, 3, 2, 1) + rotate(1, 2, 3) + keep(value(1), 2, 3, 4)
+        + divide(value(10), 3, 20, 7, 30, 4, 5, 6) + count(value(3), 0) + spin8(1, 2, 3, 4, 5, 6, 7, 8);
+}
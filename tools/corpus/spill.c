@@ -0,0 +1,24 @@
+// Register pressure and immediates: expressions deep enough to spill,
+// values kept across calls, multiplications by small constants, and
+// immediates at the imm8 and imm32 edges
+int leaf() {
+    return value(1) * 3 + value(2) * 5 + value(3) * 9 + value(4) * 10 + value(5) * 45 + value(6) * (0 - 6)
+        + value(7) * 1024 + value(8) * 7;
+}
+
+int edges() {
+    return (value(1) + 127) * (value(2) - 128) + (value(3) + 128) * (value(4) - 129) + value(5) * 2147483647
+        + (value(6) - 2147483647 - 1) + 65535 * value(7);
+}
+
+int deep() {
+    return ((1 + 2) * (3 + 4) + (5 + 6) * (1 + 3)) * ((2 + 4) * (5 + 1) + (6 + 2) * (3 + 5))
+        - ((value(1) * value(2) + value(3) * value(4)) * (value(5) * value(6) + value(1) * value(4))
+           + (value(2) * value(3) + value(5) * value(1)) * (value(6) * value(4) + value(2) * value(5)))
+        * ((value(1) - value(6)) * (value(2) - value(5)) + (value(3) - value(4)) * (value(1) - value(2)))
+        + leaf() * edges() + leaf() * value(9);
+}
+
+int main() {
+    return deep() + leaf() + edges();
+}
@@ -0,0 +1,22 @@
+// Calls in tail position: to other functions, to functions defined
+// elsewhere and to the function itself, also with more arguments than fit
+// in registers
+int count() {
+    return count();
+}
+
+int bounce() {
+    return count();
+}
+
+int remote() {
+    return elsewhere(value(3) * 3, value(4) / 2);
+}
+
+int spin8(int a, int b, int c, int d, int e, int f, int g, int h) {
+    return spin8(value(8), 1, 2, 3, 4, 5, 6, value(7) + 1);
+}
+
+int main() {
+    return bounce() + remote() + spin8(1, 2, 3, 4, 5, 6, 7, 8);
+}
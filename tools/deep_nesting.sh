@@ -0,0 +1,85 @@
+#!/bin/sh
+# Checks that deeply nested expressions compile at -O0 without running out of
+# native stack, and that the programs built from them return the right value.
+# Each sample nests depth levels: calls of calls, calls in the first or last
+# argument of another, and parentheses nested to the left and to the right.
+#   tools/deep_nesting.sh [compiler] [depth]
+# The compiler defaults to ./razancompiler and depth to 100000. The samples
+# are compiled together, which leaves out the AST dump of single-file runs,
+# then linked with gcc and run. -O1 is not covered: the optimizer's passes
+# still recurse once per level. Prints each failure and exits 1 if there was
+# any.
+rc=${1:-./razancompiler}
+depth=${2:-100000}
+
+if [ ! -x "$rc" ]; then
+    echo "Error: compiler '$rc' not found; build it first (see README)." >&2
+    exit 2
+fi
+case "$rc" in
+    /*) ;;
+    *) rc="$PWD/$rc" ;;
+esac
+
+work=$(mktemp -d) || exit 2
+trap 'rm -rf "$work"' EXIT
+
+# g(g(...g(0)...))
+awk -v n="$depth" 'BEGIN {
+    print "int g(int x) {\n    return x + 1;\n}\n";
+    printf "int main() {\n    return ";
+    for (i = 0; i < n; ++i) printf "g(";
+    printf "0";
+    for (i = 0; i < n; ++i) printf ")";
+    print ";\n}";
+}' > "$work/calls.c"
+
+# h(h(1, ...), 1) and h(1, h(...)) by turns
+awk -v n="$depth" 'BEGIN {
+    print "int h(int a, int b) {\n    return a + b;\n}\n";
+    printf "int main() {\n    return ";
+    for (i = 0; i < n; ++i) printf (i % 2 ? "h(1, " : "h(");
+    printf "0";
+    for (i = n - 1; i >= 0; --i) printf (i % 2 ? ")" : ", 1)");
+    print ";\n}";
+}' > "$work/arguments.c"
+
+# ((0 + 1) + 1) ... + (1 + (1 + 0)) ... - depth
+awk -v n="$depth" 'BEGIN {
+    printf "int main() {\n    return ";
+    for (i = 0; i < n; ++i) printf "(";
+    printf "0";
+    for (i = 0; i < n; ++i) printf " + 1)";
+    printf " + ";
+    for (i = 0; i < n; ++i) printf "(1 + ";
+    printf "0";
+    for (i = 0; i < n; ++i) printf ")";
+    printf " - %d;\n}\n", n;
+}' > "$work/parens.c"
+
+cd "$work" || exit 2
+if ! "$rc" -O0 calls.c arguments.c parens.c >/dev/null 2>err; then
+    echo "compile failed"
+    sed 's/^/    /' err
+    exit 1
+fi
+
+expected=$((depth % 256))
+failed=0
+for name in calls arguments parens; do
+    if ! gcc -o "$name" "$name.s" 2>err; then
+        echo "$name: gcc rejected the assembly"
+        sed 's/^/    /' err
+        failed=$((failed + 1))
+        continue
+    fi
+    ./"$name"
+    status=$?
+    if [ "$status" -ne "$expected" ]; then
+        echo "$name: returned $status, expected $expected"
+        failed=$((failed + 1))
+    fi
+done
+
+echo "$((3 - failed)) of 3 samples nested $depth deep compile and run correctly"
+[ "$failed" -eq 0 ]
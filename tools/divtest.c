@@ -0,0 +1,330 @@
+// Division by a constant: compiles `x / d` for edge divisors through the whole
+// pipeline into machine code, runs it in process and checks every quotient
+// against C's, then times the shift and multiply-high sequences against idiv.
+//   gcc -O2 -o divtest tools/divtest.c intern.c scan.c lexer.c parser.c ast.c
+//       optimize.c emit.c encode.c peephole.c ir.c lower.c scope.c codegen.c threadpool.c -lpthread
+//   ./divtest [--full] [--bench] [--seed N]
+// Each divisor gets the edge dividends (0, +-1, the int limits, multiples of
+// the divisor and their neighbours) and a random sample; --full also tries all
+// 2^32 dividends on the edge divisors (a few minutes). Every divisor is also
+// tried as a parameter, in a register and on the stack. The upper half of
+// every argument is filled with garbage, since only the low 32 bits of an int
+// are defined. --bench skips the check and reports ns per division.
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "../source.h"
+#include "../intern.h"
+#include "../ast.h"
+#include "../lexer.h"
+#include "../parser.h"
+#include "../optimize.h"
+#include "../codegen.h"
+#include "../emit.h"
+#include "../scan.h"
+
+// The arguments are full 64-bit registers or stack slots; the function reads
+// them as ints
+typedef int (*DivideFunction)(long long x);
+typedef int (*VariableFunction)(long long a, long long b, long long c, long long d,
+                                long long e, long long f, long long g, long long h);
+typedef int (*SumFunction)(int a, int b, int c, int d, int e, int f);
+
+static double now_seconds() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift64*, so a seed gives the same dividends everywhere
+static uint64_t random_state = 0x9E3779B97F4A7C15ull;
+static uint64_t next_random() {
+    random_state ^= random_state >> 12;
+    random_state ^= random_state << 25;
+    random_state ^= random_state >> 27;
+    return random_state * 0x2545F4914F6CDD1Dull;
+}
+
+// The language has no unary minus or literals past INT_MAX; -O1 folds these
+static void emit_int(Emitter* out, int value) {
+    if (value == INT_MIN) emit_fmt(out, "(0 - %d - 1)", INT_MAX);
+    else if (value < 0) emit_fmt(out, "(0 - %d)", -value);
+    else emit_fmt(out, "%d", value);
+}
+
+// INT_MIN / -1 wraps to INT_MIN, as fold_binary does
+static int reference_quotient(int x, int d) {
+    if (d == -1) return (int)(0u - (uint32_t)x);
+    return x / d;
+}
+
+typedef struct Program {
+    Emitter code;
+    unsigned char* base;
+    size_t size;
+} Program;
+
+// Compiles text at -O1, with or without strength reduction, and maps it
+// executable. The symbol names point into text, so it must outlive program.
+static void compile_program(Emitter* text, int strength_reduce, Program* program) {
+    static const char padding[SOURCE_PADDING] = {0};
+    size_t length = text->length;
+    emit_text(text, padding, sizeof(padding)); // the lexer's end-of-input sentinel
+
+    Interner names;
+    AST ast;
+    Lexer lexer;
+    Parser parser;
+    interner_init(&names);
+    ast_init(&ast);
+    emitter_init_machine_code(&program->code);
+    OptimizeOptions optimize;
+    optimize_options_for_level(&optimize, 1);
+    optimize.strength_reduce = strength_reduce;
+    optimize.eliminate_dead_code = 0; // keep every function, not only those main calls
+    program->code.peephole = optimize.peephole;
+    lexer_init(&lexer, text->data, &names);
+    parser_init(&parser, &lexer, &ast);
+    NodeId root = parse_program(&parser);
+    OptimizeReport report;
+    optimize_program(&ast, root, &names, &optimize, &report);
+    generate_code(&ast, root, &names, &optimize, &program->code);
+    ast_release(&ast);
+    interner_free(&names);
+    text->length = length;
+
+    if (program->code.relocation_count != 0) {
+        fprintf(stderr, "divtest: the generated functions should not call anything\n");
+        exit(1);
+    }
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+    program->size = (program->code.length + (size_t)page - 1) / (size_t)page * (size_t)page;
+    program->base = (unsigned char*)mmap(NULL, program->size, PROT_READ | PROT_WRITE,
+                                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (program->base == MAP_FAILED) {
+        perror("divtest: mmap");
+        exit(1);
+    }
+    memcpy(program->base, program->code.data, program->code.length);
+    if (mprotect(program->base, program->size, PROT_READ | PROT_EXEC) != 0) {
+        perror("divtest: mprotect");
+        exit(1);
+    }
+}
+
+static void release_program(Program* program) {
+    munmap(program->base, program->size);
+    emitter_free(&program->code);
+}
+
+static void* find_function(Program* program, const char* name) {
+    SymbolId id = intern(&program->code.symbol_names, name, strlen(name));
+    if (id >= program->code.symbol_capacity || !program->code.symbols[id].defined) {
+        fprintf(stderr, "divtest: no function '%s' in the generated code\n", name);
+        exit(1);
+    }
+    return program->base + program->code.symbols[id].offset;
+}
+
+// ---- Check ----
+
+// Divisors whose sequences differ: +-1, powers of two and their neighbours,
+// the int limits, and multipliers that need the add or subtract fixup
+static const int edge_divisors[] = {
+    1, -1, 2, -2, 3, -3, 5, -5, 6, 7, -7, 9, 10, -10, 11, 12, 13, 25, 100, 125, 641, -641, 1000,
+    1 << 16, (1 << 16) + 1, -((1 << 16) + 1), 6700417, 1000000007, 1 << 30, -(1 << 30),
+    (1 << 30) + 1, INT_MAX, -INT_MAX, INT_MIN, INT_MIN + 1, INT_MAX - 1, 0x55555555, -0x55555555,
+};
+#define EDGE_DIVISOR_COUNT (sizeof(edge_divisors) / sizeof(edge_divisors[0]))
+#define SMALL_DIVISOR_LIMIT 1000 // and every divisor from -1000 to 1000
+#define RANDOM_DIVISORS 1000
+#define RANDOM_DIVIDENDS 20000
+
+static size_t failures = 0;
+static size_t checked = 0;
+
+// x with garbage in the upper half
+static long long garbage_above(int x) {
+    return (long long)(((uint64_t)next_random() << 32) | (uint32_t)x);
+}
+
+static void check_one(DivideFunction divide, int d, int x) {
+    int got = divide(garbage_above(x));
+    int expected = reference_quotient(x, d);
+    checked++;
+    if (got != expected && failures++ < 20) {
+        fprintf(stderr, "FAIL: %d / %d = %d, expected %d\n", x, d, got, expected);
+    }
+}
+
+static void check_divisor(DivideFunction divide, int d, int full) {
+    static const int fixed[] = {0, 1, -1, 2, -2, INT_MAX, INT_MAX - 1, INT_MIN, INT_MIN + 1, INT_MIN + 2};
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); ++i) check_one(divide, d, fixed[i]);
+    // Multiples of d near zero and near the limits, and their neighbours
+    long long ad = d < 0 ? -(long long)d : d;
+    long long largest = (long long)INT_MAX / ad;
+    long long counts[] = {1, 2, 3, largest - 1, largest, largest + 1};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        for (int sign = -1; sign <= 1; sign += 2) {
+            long long multiple = sign * counts[i] * ad;
+            for (int delta = -1; delta <= 1; ++delta) {
+                long long x = multiple + delta;
+                if (x >= INT_MIN && x <= INT_MAX) check_one(divide, d, (int)x);
+            }
+        }
+    }
+    for (int i = 0; i < RANDOM_DIVIDENDS; ++i) check_one(divide, d, (int)(uint32_t)next_random());
+    if (full) {
+        uint32_t x = 0;
+        do {
+            check_one(divide, d, (int)x);
+        } while (++x != 0);
+    }
+}
+
+static int run_check(int full) {
+    int divisors[EDGE_DIVISOR_COUNT + 2 * SMALL_DIVISOR_LIMIT + RANDOM_DIVISORS];
+    size_t count = 0;
+    for (size_t i = 0; i < EDGE_DIVISOR_COUNT; ++i) divisors[count++] = edge_divisors[i];
+    for (int d = -SMALL_DIVISOR_LIMIT; d <= SMALL_DIVISOR_LIMIT; ++d) {
+        if (d != 0) divisors[count++] = d;
+    }
+    while (count < sizeof(divisors) / sizeof(divisors[0])) {
+        int d = (int)(uint32_t)next_random() >> (next_random() % 31); // all magnitudes
+        if (d != 0) divisors[count++] = d;
+    }
+
+    Emitter text;
+    emitter_init(&text);
+    for (size_t i = 0; i < count; ++i) {
+        emit_fmt(&text, "int d%zu(int x) {\n    return x / ", i);
+        emit_int(&text, divisors[i]);
+        emit_fmt(&text, ";\n}\n");
+    }
+    // Divisors that are not constants take idiv, from registers and from the stack
+    emit_fmt(&text, "int variable(int a, int b, int c, int d, int e, int f, int g, int h) {\n"
+                    "    return a / b - g / h;\n}\n");
+    emit_fmt(&text, "int main() {\n    return 0;\n}\n");
+    Program program;
+    compile_program(&text, 1, &program);
+
+    for (size_t i = 0; i < count; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "d%zu", i);
+        DivideFunction divide;
+        void* address = find_function(&program, name);
+        memcpy(&divide, &address, sizeof(divide));
+        check_divisor(divide, divisors[i], full && i < EDGE_DIVISOR_COUNT);
+    }
+    VariableFunction variable;
+    void* address = find_function(&program, "variable");
+    memcpy(&variable, &address, sizeof(variable));
+    for (size_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 100; ++k) {
+            int x = (int)(uint32_t)next_random(), y = (int)(uint32_t)next_random();
+            if (k < 4) x = k & 1 ? INT_MIN : INT_MAX;
+            int d = divisors[i];
+            int got = variable(garbage_above(x), garbage_above(d), 0, 0, 0, 0, garbage_above(y), garbage_above(d));
+            int expected = (int)((uint32_t)reference_quotient(x, d) - (uint32_t)reference_quotient(y, d));
+            checked++;
+            if (got != expected && failures++ < 20) {
+                fprintf(stderr, "FAIL: %d / %d - %d / %d = %d, expected %d\n", x, d, y, d, got, expected);
+            }
+        }
+    }
+    release_program(&program);
+    emitter_free(&text);
+
+    printf("--- %zu quotients over %zu divisors: %zu wrong ---\n", checked, count, failures);
+    return failures != 0;
+}
+
+// ---- Benchmark ----
+
+static const int bench_divisors[] = {3, 7, -7, 10, 16, -16, 641, 1000000007};
+#define BENCH_DIVISOR_COUNT (sizeof(bench_divisors) / sizeof(bench_divisors[0]))
+#define BENCH_CALLS 20000000
+#define BENCH_DIVISIONS 6 // per call
+
+// Best of three, in ns per division
+static double time_sum(SumFunction sum, int* checksum) {
+    double best = 0;
+    for (int run = 0; run < 3; ++run) {
+        uint32_t total = 0;
+        double start = now_seconds();
+        for (uint32_t i = 0; i < BENCH_CALLS; ++i) {
+            total += sum((int)i, (int)(i * 3), (int)(0u - i), (int)(i ^ 0x5A5A5A5A), (int)(i * 2654435761u), (int)i >> 1);
+        }
+        double elapsed = now_seconds() - start;
+        if (run == 0 || elapsed < best) best = elapsed;
+        *checksum = (int)total;
+    }
+    return best * 1e9 / ((double)BENCH_CALLS * BENCH_DIVISIONS);
+}
+
+static int run_bench() {
+    Emitter text;
+    emitter_init(&text);
+    for (size_t i = 0; i < BENCH_DIVISOR_COUNT; ++i) {
+        emit_fmt(&text, "int s%zu(int a, int b, int c, int d, int e, int f) {\n    return ", i);
+        for (int k = 0; k < BENCH_DIVISIONS; ++k) {
+            emit_fmt(&text, "%s%c / ", k ? " + " : "", 'a' + k);
+            emit_int(&text, bench_divisors[i]);
+        }
+        emit_fmt(&text, ";\n}\n");
+    }
+    emit_fmt(&text, "int main() {\n    return 0;\n}\n");
+    Program reduced, plain;
+    compile_program(&text, 1, &reduced);
+    compile_program(&text, 0, &plain);
+
+    int status = 0;
+    printf("--- Division by a constant: ns per division, best of 3 runs of %d calls ---\n", BENCH_CALLS);
+    printf("%12s %10s %10s %8s\n", "divisor", "idiv", "reduced", "speedup");
+    for (size_t i = 0; i < BENCH_DIVISOR_COUNT; ++i) {
+        char name[32];
+        snprintf(name, sizeof(name), "s%zu", i);
+        SumFunction reduced_sum, plain_sum;
+        void* address = find_function(&reduced, name);
+        memcpy(&reduced_sum, &address, sizeof(reduced_sum));
+        address = find_function(&plain, name);
+        memcpy(&plain_sum, &address, sizeof(plain_sum));
+        int reduced_checksum, plain_checksum;
+        double plain_ns = time_sum(plain_sum, &plain_checksum);
+        double reduced_ns = time_sum(reduced_sum, &reduced_checksum);
+        printf("%12d %10.3f %10.3f %7.2fx\n", bench_divisors[i], plain_ns, reduced_ns, plain_ns / reduced_ns);
+        if (reduced_checksum != plain_checksum) {
+            fprintf(stderr, "FAIL: the two versions disagree for divisor %d\n", bench_divisors[i]);
+            status = 1;
+        }
+    }
+    release_program(&reduced);
+    release_program(&plain);
+    emitter_free(&text);
+    return status;
+}
+
+int main(int argc, char* argv[]) {
+    int full = 0;
+    int bench = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--full") == 0) {
+            full = 1;
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            bench = 1;
+        } else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc && strtoull(argv[i + 1], NULL, 0) != 0) {
+            random_state = strtoull(argv[++i], NULL, 0);
+        } else {
+            fprintf(stderr, "Usage: %s [--full] [--bench] [--seed N]\n", argv[0]);
+            return 1;
+        }
+    }
+    scan_init();
+    return bench ? run_bench() : run_check(full);
+}
@@ -0,0 +1,73 @@
+// Generates keywords.inc: a collision-free (perfect) hash table for the
+// keywords listed in keywords.def.
+//   gcc -o gen_keywords tools/gen_keywords.c && ./gen_keywords > keywords.inc
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../keywords.h"
+
+typedef struct {
+    const char* token;
+    const char* text;
+} Keyword;
+
+static const Keyword keywords[] = {
+#define KEYWORD(token, text) { #token, text },
+#include "../keywords.def"
+#undef KEYWORD
+};
+#define KEYWORD_COUNT (sizeof(keywords) / sizeof(keywords[0]))
+
+#define MAX_TABLE_BITS 10
+#define SEED_ATTEMPTS 1000000
+
+int main() {
+    size_t min_length = 255, max_length = 0;
+    for (size_t i = 0; i < KEYWORD_COUNT; ++i) {
+        size_t length = strlen(keywords[i].text);
+        if (length < 2 || length > 255) {
+            fprintf(stderr, "gen_keywords: keyword '%s' must be 2..255 bytes long\n", keywords[i].text);
+            return 1;
+        }
+        if (length < min_length) min_length = length;
+        if (length > max_length) max_length = length;
+    }
+
+    // Smallest power-of-two table first; within a size, try odd multipliers
+    // from a fixed LCG sequence so the output is reproducible.
+    int slot_of[KEYWORD_COUNT];
+    for (unsigned bits = 1; bits <= MAX_TABLE_BITS; ++bits) {
+        if ((1u << bits) < KEYWORD_COUNT) continue;
+        unsigned shift = 32 - bits;
+        uint32_t state = 12345;
+        for (int attempt = 0; attempt < SEED_ATTEMPTS; ++attempt) {
+            state = state * 1664525u + 1013904223u;
+            uint32_t seed = state | 1;
+            unsigned char used[1u << MAX_TABLE_BITS] = {0};
+            size_t i;
+            for (i = 0; i < KEYWORD_COUNT; ++i) {
+                const char* text = keywords[i].text;
+                uint32_t slot = keyword_slot(keyword_key(text, strlen(text)), seed, shift);
+                if (used[slot]) break;
+                used[slot] = 1;
+                slot_of[i] = (int)slot;
+            }
+            if (i < KEYWORD_COUNT) continue;
+
+            printf("// Generated by tools/gen_keywords.c from keywords.def -- do not edit.\n");
+            printf("#define KEYWORD_HASH_SEED 0x%08xu\n", seed);
+            printf("#define KEYWORD_HASH_SHIFT %u\n", shift);
+            printf("#define KEYWORD_MIN_LENGTH %zu\n", min_length);
+            printf("#define KEYWORD_MAX_LENGTH %zu\n", max_length);
+            printf("static const KeywordEntry keyword_table[%u] = {\n", 1u << bits);
+            for (size_t k = 0; k < KEYWORD_COUNT; ++k) {
+                printf("    [%d] = { \"%s\", %zu, %s },\n", slot_of[k], keywords[k].text,
+                       strlen(keywords[k].text), keywords[k].token);
+            }
+            printf("};\n");
+            return 0;
+        }
+    }
+    fprintf(stderr, "gen_keywords: no perfect hash found, widen keyword_key\n");
+    return 1;
+}